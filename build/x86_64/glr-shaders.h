@@ -0,0 +1,2521 @@
+
+const char *INSTANCED_FRAGMENT_SHADER_SOLID_SRC =
+"#version 300 es \n"
+"#define GLR_CLASS_SOLID \n"
+" \n"
+"// this shader is built into one program per instance class (see the \n"
+"// Makefile), each defining one of GLR_CLASS_SOLID, GLR_CLASS_ROUNDED, \n"
+"// GLR_CLASS_GRADIENT or GLR_CLASS_GLYPH. A variant only carries the code \n"
+"// its class needs, so instances of different kinds do not share a program \n"
+"#if defined (GLR_CLASS_GLYPH) \n"
+"#  define WITH_GLYPHS \n"
+"#else \n"
+"#  define WITH_RECTS \n"
+"#  if defined (GLR_CLASS_ROUNDED) || defined (GLR_CLASS_GRADIENT) \n"
+"#    define WITH_ROUND_CORNERS \n"
+"#  endif \n"
+"#  if defined (GLR_CLASS_GRADIENT) \n"
+"#    define WITH_GRADIENTS \n"
+"#  endif \n"
+"#endif \n"
+" \n"
+"precision highp float; \n"
+" \n"
+"const float PI = 3.14159265359; \n"
+" \n"
+"const uint INSTANCE_RECT_BG             = uint (0); \n"
+"const uint INSTANCE_BORDER_TOP          = uint (1); \n"
+"const uint INSTANCE_BORDER_RIGHT        = uint (2); \n"
+"const uint INSTANCE_BORDER_BOTTOM       = uint (3); \n"
+"const uint INSTANCE_BORDER_LEFT         = uint (4); \n"
+"const uint INSTANCE_BORDER_TOP_LEFT     = uint (5); \n"
+"const uint INSTANCE_BORDER_TOP_RIGHT    = uint (6); \n"
+"const uint INSTANCE_BORDER_BOTTOM_LEFT  = uint (7); \n"
+"const uint INSTANCE_BORDER_BOTTOM_RIGHT = uint (8); \n"
+"const uint INSTANCE_CHAR_GLYPH          = uint (9); \n"
+"const uint INSTANCE_BOX                 = uint (10); \n"
+"const uint INSTANCE_RECT_ALIGNED        = uint (11); \n"
+" \n"
+"const int BACKGROUND_TYPE_NONE         = 0; \n"
+"const int BACKGROUND_TYPE_SOLID_COLOR  = 1; \n"
+"const int BACKGROUND_TYPE_IMAGE        = 2; \n"
+"const int BACKGROUND_TYPE_LINEAR_GRAD  = 3; \n"
+"const int BACKGROUND_TYPE_RADIAL_GRAD  = 4; \n"
+" \n"
+"     out vec4  my_FragColor; \n"
+" \n"
+"     in  vec4  color; \n"
+"     in  vec2  tex_coords; \n"
+" \n"
+"flat in  vec2  norm; \n"
+"flat in  vec2  aa_size; \n"
+" \n"
+"flat in  uint  instance_type; \n"
+" \n"
+"flat in  vec4  area_in_tex; \n"
+"flat in  int   tex_id; \n"
+" \n"
+"flat in  ivec4 border_style; \n"
+"flat in  vec4  border_width; \n"
+"flat in  vec2  border_radius[4]; \n"
+"flat in  uvec4 border_color; \n"
+" \n"
+"flat in  int   background_type; \n"
+" \n"
+"     in  vec2  box_pos; \n"
+"flat in  vec2  box_half_size; \n"
+"flat in  vec4  box_border_width; \n"
+"flat in  vec4  box_radii; \n"
+"flat in  vec4  box_border_color; \n"
+" \n"
+"     in  vec2  clip_pos; \n"
+"flat in  vec2  clip_half_size; \n"
+"flat in  vec4  clip_radii; \n"
+" \n"
+"flat in  float instance_opacity; \n"
+" \n"
+"uniform float aa_offset; \n"
+" \n"
+"flat in  vec4  linear_grad_colors[2]; \n"
+"flat in  float linear_grad_steps[4]; \n"
+"flat in  float linear_grad_angle; \n"
+"flat in  float linear_grad_gamma; \n"
+"flat in  float linear_grad_length; \n"
+" \n"
+"uniform sampler2D glyph_cache[8]; \n"
+" \n"
+"vec4 \n"
+"sample_glyph_cache (int tex_id, mediump vec2 tex_coord) \n"
+"{ \n"
+"  switch (tex_id) \n"
+"    { \n"
+"    case 0: return texture (glyph_cache[0], tex_coord); \n"
+"    case 1: return texture (glyph_cache[1], tex_coord); \n"
+"    case 2: return texture (glyph_cache[2], tex_coord); \n"
+"    case 3: return texture (glyph_cache[3], tex_coord); \n"
+"    case 4: return texture (glyph_cache[4], tex_coord); \n"
+"    case 5: return texture (glyph_cache[5], tex_coord); \n"
+"    case 6: return texture (glyph_cache[6], tex_coord); \n"
+"    case 7: return texture (glyph_cache[7], tex_coord); \n"
+"    } \n"
+"} \n"
+" \n"
+"bool \n"
+"draw_round_corner (vec4 col, float x, float y, float rx, float ry) \n"
+"{ \n"
+"  if (x >= rx || y >= ry || x < 0.0 || y < 0.0) \n"
+"    return false; \n"
+" \n"
+"  float ar = ry/rx; \n"
+"  float o = (atan (y, x*ar)) + PI/2.0; \n"
+" \n"
+"  float x1 = cos (o) * rx * ar; \n"
+"  float y1 = sin (o) * ry; \n"
+"  float h1 = length (vec2 (x1, y1)); \n"
+" \n"
+"  float kx = cos (o) * aa_size.x * ar; \n"
+"  float ky = sin (o) * aa_size.y; \n"
+"  float k = length (vec2 (kx, ky)); \n"
+" \n"
+"  float h = length (vec2 ((rx - x)*ar, ry - y)); \n"
+" \n"
+"  if (h > h1) \n"
+"    discard; \n"
+"  else if (h > h1 - k) \n"
+"    col.a *= (1.0/k) * (h1 - h); \n"
+" \n"
+"  my_FragColor = col; \n"
+" \n"
+"  return true; \n"
+"} \n"
+" \n"
+"bool \n"
+"draw_border_corner (vec4 col, \n"
+"                    float x, float y, \n"
+"                    float ar, \n"
+"                    vec2 outer_radi, \n"
+"                    vec2 inner_radi) \n"
+"{ \n"
+"  if (x > outer_radi.x + aa_size.x || y > outer_radi.y + aa_size.y) \n"
+"    return false; \n"
+" \n"
+"  float o = (atan (y, x*ar)) + PI/2.0; \n"
+" \n"
+"  float x1 = cos (o) * outer_radi.x * ar; \n"
+"  float y1 = sin (o) * outer_radi.y; \n"
+"  float h1 = length (vec2 (x1, y1)); \n"
+" \n"
+"  float x2 = cos (o) * inner_radi.x * ar; \n"
+"  float y2 = sin (o) * inner_radi.y; \n"
+"  float h2 = length (vec2 (x2, y2)); \n"
+" \n"
+"  float kx = cos (o) * aa_size.x * ar; \n"
+"  float ky = sin (o) * aa_size.y; \n"
+"  float k = length (vec2 (kx, ky)); \n"
+" \n"
+"  float h = length (vec2 ((outer_radi.x - x)*ar, outer_radi.y - y)); \n"
+" \n"
+"  if (h > h1 || h <= h2 - k) \n"
+"    discard; \n"
+"  else if (h > h1 - k) \n"
+"    col.a *= (1.0/k) * (h1 - h); \n"
+"  else if (h <= h2) \n"
+"    col.a *= (1.0/k) * (h - (h2 - k)); \n"
+" \n"
+"  my_FragColor = col; \n"
+" \n"
+"  return true; \n"
+"} \n"
+" \n"
+"// signed distance from 'p' to the edge of a box centered at the origin, \n"
+"// negative inside. 'radii' round its top-left, top-right, bottom-left and \n"
+"// bottom-right corners \n"
+"float \n"
+"rounded_box_distance (vec2 p, vec2 half_size, vec4 radii) \n"
+"{ \n"
+"  float r; \n"
+" \n"
+"  if (p.y < 0.0) \n"
+"    r = p.x < 0.0 ? radii.x : radii.y; \n"
+"  else \n"
+"    r = p.x < 0.0 ? radii.z : radii.w; \n"
+" \n"
+"  vec2 q = abs (p) - half_size + r; \n"
+" \n"
+"  return min (max (q.x, q.y), 0.0) + length (max (q, 0.0)) - r; \n"
+"} \n"
+" \n"
+"// how much of the fragment is inside the instance's clip, if any \n"
+"float \n"
+"clip_coverage () \n"
+"{ \n"
+"  if (clip_half_size.x < 0.0) \n"
+"    return 1.0; \n"
+" \n"
+"  float d = rounded_box_distance (clip_pos, clip_half_size, clip_radii); \n"
+" \n"
+"  return clamp (0.5 - d / max (aa_offset, 0.001), 0.0, 1.0); \n"
+"} \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"vec4 \n"
+"draw_box (vec4 bg) \n"
+"{ \n"
+"  vec4 bw = box_border_width; \n"
+"  float aa = max (aa_offset, 0.001); \n"
+" \n"
+"  // the area inside the border, and its corners \n"
+"  vec2 inner_half_size = max (box_half_size - (bw.xy + bw.zw) / 2.0, 0.0); \n"
+"  vec2 inner_center = (bw.xy - bw.zw) / 2.0; \n"
+"  vec4 inner_radii = max (box_radii - vec4 (max (bw.x, bw.y), \n"
+"                                            max (bw.y, bw.z), \n"
+"                                            max (bw.w, bw.x), \n"
+"                                            max (bw.z, bw.w)), \n"
+"                          0.0); \n"
+" \n"
+"  // away from the border and the inner corners there is only background \n"
+"  vec2 d = inner_half_size - abs (box_pos - inner_center); \n"
+"  float max_inner_radius = max (max (inner_radii.x, inner_radii.y), \n"
+"                                max (inner_radii.z, inner_radii.w)); \n"
+"  if (min (d.x, d.y) > aa && max (d.x, d.y) > max_inner_radius + aa) \n"
+"    return bg; \n"
+" \n"
+"  float outer = rounded_box_distance (box_pos, box_half_size, box_radii); \n"
+"  float coverage = clamp (0.5 - outer / aa, 0.0, 1.0); \n"
+"  if (coverage == 0.0) \n"
+"    discard; \n"
+" \n"
+"  float border = 0.0; \n"
+"  if (any (greaterThan (bw, vec4 (0.0)))) { \n"
+"    float inner = rounded_box_distance (box_pos - inner_center, \n"
+"                                        inner_half_size, \n"
+"                                        inner_radii); \n"
+"    border = clamp (0.5 + inner / aa, 0.0, 1.0); \n"
+"  } \n"
+" \n"
+"  // mix with premultiplied alpha, the background may be transparent \n"
+"  vec4 col = mix (vec4 (bg.rgb * bg.a, bg.a), \n"
+"                  vec4 (box_border_color.rgb * box_border_color.a, \n"
+"                        box_border_color.a), \n"
+"                  border); \n"
+"  if (col.a > 0.0) \n"
+"    col.rgb /= col.a; \n"
+" \n"
+"  col.a *= coverage; \n"
+" \n"
+"  return col; \n"
+"} \n"
+"#endif \n"
+" \n"
+"vec4 \n"
+"apply_vertical_aa (float s, vec4 col) \n"
+"{ \n"
+"  if (s < aa_size.s) \n"
+"    col.a *= (1.0/aa_size.s) * s; \n"
+"  else if (s > 1.0 - aa_size.s) \n"
+"    col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+" \n"
+"  return col; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"apply_horiz_aa (float t, vec4 col) \n"
+"{ \n"
+"  if (t < aa_size.t) \n"
+"    col.a *= (1.0/aa_size.t) * t; \n"
+"  else if (t > 1.0 - aa_size.t) \n"
+"    col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+" \n"
+"  return col; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"apply_linear_gradient (vec4 color, float s, float t) \n"
+"{ \n"
+"  float x, y, k; \n"
+" \n"
+"  if (linear_grad_angle < PI/2.0) \n"
+"    { \n"
+"      x = s; \n"
+"      y = t; \n"
+"      k = y; \n"
+"    } \n"
+"  else if (linear_grad_angle < PI) \n"
+"    { \n"
+"      x = 1.0 - s; \n"
+"      k = x; \n"
+"      y = t; \n"
+"    } \n"
+"  else if (linear_grad_angle < PI/2.0*3.0) \n"
+"    { \n"
+"      x = 1.0 - s; \n"
+"      y = 1.0 - t; \n"
+"      k = y; \n"
+"    } \n"
+"  else \n"
+"    { \n"
+"      x = s; \n"
+"      y = 1.0 - t; \n"
+"      k = x; \n"
+"    } \n"
+" \n"
+"  float st = length (vec2 (x, y)); \n"
+"  float teta = asin (k / st); \n"
+"  float d = st * sin (linear_grad_gamma + teta); \n"
+" \n"
+"  color = mix (linear_grad_colors[0], \n"
+"               linear_grad_colors[1], \n"
+"               d / linear_grad_length); \n"
+" \n"
+"  return color; \n"
+"} \n"
+" \n"
+"void \n"
+"draw_instance () \n"
+"{ \n"
+"  vec4 col = color; \n"
+" \n"
+"  float s = tex_coords.s; \n"
+"  float t = tex_coords.t; \n"
+" \n"
+"  vec2 br[4] = border_radius; \n"
+"  vec4 bw = border_width; \n"
+" \n"
+"#if defined (WITH_GLYPHS) \n"
+"  // character glyph \n"
+"  // --------------------------------------------------------------------------- \n"
+"  { \n"
+"    float f = 0.0; \n"
+"    vec4 a; \n"
+" \n"
+"    a = sample_glyph_cache (tex_id, vec2 (area_in_tex.x + s * area_in_tex.z, \n"
+"                                          area_in_tex.y + t * area_in_tex.w)); \n"
+" \n"
+"    f = a.r; \n"
+"    if (f == 0.0) \n"
+"      discard; \n"
+" \n"
+"    col.a *= f; \n"
+"  } \n"
+"#endif \n"
+" \n"
+"#if defined (WITH_RECTS) \n"
+"  // pixel-aligned rects need no anti-aliasing \n"
+"  if (instance_type == INSTANCE_RECT_ALIGNED) { \n"
+"    my_FragColor = col; \n"
+"    return; \n"
+"  } \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"  // background, border and corners of a rect in a single instance \n"
+"  // --------------------------------------------------------------------------- \n"
+"  if (instance_type == INSTANCE_BOX) { \n"
+"#if defined (WITH_GRADIENTS) \n"
+"    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD) \n"
+"      col = apply_linear_gradient (col, s, t); \n"
+"#endif \n"
+" \n"
+"    col = draw_box (col); \n"
+"  } \n"
+"  else \n"
+"#endif \n"
+" \n"
+"  // rectangle background \n"
+"  // --------------------------------------------------------------------------- \n"
+"  if (instance_type == INSTANCE_RECT_BG) { \n"
+"    float rx, ry; \n"
+" \n"
+"    // consider type of background \n"
+" \n"
+"#if defined (WITH_GRADIENTS) \n"
+"    // linear gradient \n"
+"    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD) \n"
+"      col = apply_linear_gradient (col, s, t); \n"
+"#endif \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    // top-left round corner \n"
+"    if (br[0].x * br[0].y > 0.0) { \n"
+"        rx = br[0].x * norm.x; \n"
+"        ry = br[0].y * norm.y; \n"
+"        if (draw_round_corner (col, s, t, rx, ry)) \n"
+"          return; \n"
+"      } \n"
+" \n"
+"    // top-right round corner \n"
+"    if (br[1].x * br[1].y > 0.0) { \n"
+"        rx = br[1].x * norm.x; \n"
+"        ry = br[1].y * norm.y; \n"
+"        if (draw_round_corner (col, 1.0 - s, t, rx, ry)) \n"
+"          return; \n"
+"    } \n"
+" \n"
+"    // bottom-left round corner \n"
+"    if (br[2].x * br[2].y > 0.0) { \n"
+"        rx = br[2].x * norm.x; \n"
+"        ry = br[2].y * norm.y; \n"
+"        if (draw_round_corner (col, s, 1.0 - t, rx, ry)) \n"
+"          return; \n"
+"      } \n"
+" \n"
+"    // bottom-right round corner \n"
+"    if (br[3].x * br[3].y > 0.0) { \n"
+"        rx = br[3].x * norm.x; \n"
+"        ry = br[3].y * norm.y; \n"
+"        if (draw_round_corner (col, 1.0 - s, 1.0 - t, rx, ry)) \n"
+"          return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    col = apply_vertical_aa (s, col); \n"
+"    col = apply_horiz_aa (t, col); \n"
+"  } \n"
+" \n"
+"  // solid border left or right \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_LEFT || instance_type == INSTANCE_BORDER_RIGHT) { \n"
+"    col = apply_vertical_aa (s, col); \n"
+"  } \n"
+" \n"
+"  // solid border top or bottom \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP || instance_type == INSTANCE_BORDER_BOTTOM) { \n"
+"    col = apply_horiz_aa (t, col); \n"
+"  } \n"
+" \n"
+"  // top-left solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP_LEFT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[0].x > 0.0 && br[0].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[0].x * norm.x, br[0].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[0] - br[0].x) * norm.x, 0.0), \n"
+"                              min ((bw[1] - br[0].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[0].y, bw[1]) / max (br[0].x, bw[0]); \n"
+"      if (draw_border_corner (col, s, t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s < aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * s; \n"
+"    if (t < aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * t; \n"
+"  } \n"
+" \n"
+"  // top-right solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP_RIGHT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[1].x > 0.0 && br[1].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[1].x * norm.x, br[1].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[2] - br[1].x) * norm.x, 0.0), \n"
+"                              min ((bw[1] - br[1].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[1].y, bw[1]) / max (br[1].x, bw[2]); \n"
+"      if (draw_border_corner (col, 1.0 - s, t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s > 1.0 - aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+"    if (t < aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * t; \n"
+"  } \n"
+" \n"
+"  // bottom-right solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_BOTTOM_RIGHT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[2].x > 0.0 && br[2].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[2].x * norm.x, br[2].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[2] - br[2].x) * norm.x, 0.0), \n"
+"                              min ((bw[3] - br[2].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[2].y, bw[2]) / max (br[2].x, bw[3]); \n"
+"      if (draw_border_corner (col, 1.0 - s, 1.0 - t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s > 1.0 - aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+"    if (t > 1.0 - aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+"  } \n"
+" \n"
+"  // bottom-left solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_BOTTOM_LEFT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[3].x > 0.0 && br[3].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[3].x * norm.x, br[3].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[0] - br[3].x) * norm.x, 0.0), \n"
+"                              min ((bw[3] - br[3].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[3].y, bw[0]) / max (br[3].x, bw[3]); \n"
+"      if (draw_border_corner (col, s, 1.0 - t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s < aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * s; \n"
+"    if (t > 1.0 - aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+"  } \n"
+"#endif \n"
+" \n"
+"  my_FragColor = col; \n"
+"} \n"
+" \n"
+"void \n"
+"main () \n"
+"{ \n"
+"  float clip = clip_coverage (); \n"
+" \n"
+"  if (clip == 0.0) \n"
+"    discard; \n"
+" \n"
+"  draw_instance (); \n"
+" \n"
+"  my_FragColor.a *= clip * instance_opacity; \n"
+"} \n"
+;
+
+const char *INSTANCED_FRAGMENT_SHADER_ROUNDED_SRC =
+"#version 300 es \n"
+"#define GLR_CLASS_ROUNDED \n"
+" \n"
+"// this shader is built into one program per instance class (see the \n"
+"// Makefile), each defining one of GLR_CLASS_SOLID, GLR_CLASS_ROUNDED, \n"
+"// GLR_CLASS_GRADIENT or GLR_CLASS_GLYPH. A variant only carries the code \n"
+"// its class needs, so instances of different kinds do not share a program \n"
+"#if defined (GLR_CLASS_GLYPH) \n"
+"#  define WITH_GLYPHS \n"
+"#else \n"
+"#  define WITH_RECTS \n"
+"#  if defined (GLR_CLASS_ROUNDED) || defined (GLR_CLASS_GRADIENT) \n"
+"#    define WITH_ROUND_CORNERS \n"
+"#  endif \n"
+"#  if defined (GLR_CLASS_GRADIENT) \n"
+"#    define WITH_GRADIENTS \n"
+"#  endif \n"
+"#endif \n"
+" \n"
+"precision highp float; \n"
+" \n"
+"const float PI = 3.14159265359; \n"
+" \n"
+"const uint INSTANCE_RECT_BG             = uint (0); \n"
+"const uint INSTANCE_BORDER_TOP          = uint (1); \n"
+"const uint INSTANCE_BORDER_RIGHT        = uint (2); \n"
+"const uint INSTANCE_BORDER_BOTTOM       = uint (3); \n"
+"const uint INSTANCE_BORDER_LEFT         = uint (4); \n"
+"const uint INSTANCE_BORDER_TOP_LEFT     = uint (5); \n"
+"const uint INSTANCE_BORDER_TOP_RIGHT    = uint (6); \n"
+"const uint INSTANCE_BORDER_BOTTOM_LEFT  = uint (7); \n"
+"const uint INSTANCE_BORDER_BOTTOM_RIGHT = uint (8); \n"
+"const uint INSTANCE_CHAR_GLYPH          = uint (9); \n"
+"const uint INSTANCE_BOX                 = uint (10); \n"
+"const uint INSTANCE_RECT_ALIGNED        = uint (11); \n"
+" \n"
+"const int BACKGROUND_TYPE_NONE         = 0; \n"
+"const int BACKGROUND_TYPE_SOLID_COLOR  = 1; \n"
+"const int BACKGROUND_TYPE_IMAGE        = 2; \n"
+"const int BACKGROUND_TYPE_LINEAR_GRAD  = 3; \n"
+"const int BACKGROUND_TYPE_RADIAL_GRAD  = 4; \n"
+" \n"
+"     out vec4  my_FragColor; \n"
+" \n"
+"     in  vec4  color; \n"
+"     in  vec2  tex_coords; \n"
+" \n"
+"flat in  vec2  norm; \n"
+"flat in  vec2  aa_size; \n"
+" \n"
+"flat in  uint  instance_type; \n"
+" \n"
+"flat in  vec4  area_in_tex; \n"
+"flat in  int   tex_id; \n"
+" \n"
+"flat in  ivec4 border_style; \n"
+"flat in  vec4  border_width; \n"
+"flat in  vec2  border_radius[4]; \n"
+"flat in  uvec4 border_color; \n"
+" \n"
+"flat in  int   background_type; \n"
+" \n"
+"     in  vec2  box_pos; \n"
+"flat in  vec2  box_half_size; \n"
+"flat in  vec4  box_border_width; \n"
+"flat in  vec4  box_radii; \n"
+"flat in  vec4  box_border_color; \n"
+" \n"
+"     in  vec2  clip_pos; \n"
+"flat in  vec2  clip_half_size; \n"
+"flat in  vec4  clip_radii; \n"
+" \n"
+"flat in  float instance_opacity; \n"
+" \n"
+"uniform float aa_offset; \n"
+" \n"
+"flat in  vec4  linear_grad_colors[2]; \n"
+"flat in  float linear_grad_steps[4]; \n"
+"flat in  float linear_grad_angle; \n"
+"flat in  float linear_grad_gamma; \n"
+"flat in  float linear_grad_length; \n"
+" \n"
+"uniform sampler2D glyph_cache[8]; \n"
+" \n"
+"vec4 \n"
+"sample_glyph_cache (int tex_id, mediump vec2 tex_coord) \n"
+"{ \n"
+"  switch (tex_id) \n"
+"    { \n"
+"    case 0: return texture (glyph_cache[0], tex_coord); \n"
+"    case 1: return texture (glyph_cache[1], tex_coord); \n"
+"    case 2: return texture (glyph_cache[2], tex_coord); \n"
+"    case 3: return texture (glyph_cache[3], tex_coord); \n"
+"    case 4: return texture (glyph_cache[4], tex_coord); \n"
+"    case 5: return texture (glyph_cache[5], tex_coord); \n"
+"    case 6: return texture (glyph_cache[6], tex_coord); \n"
+"    case 7: return texture (glyph_cache[7], tex_coord); \n"
+"    } \n"
+"} \n"
+" \n"
+"bool \n"
+"draw_round_corner (vec4 col, float x, float y, float rx, float ry) \n"
+"{ \n"
+"  if (x >= rx || y >= ry || x < 0.0 || y < 0.0) \n"
+"    return false; \n"
+" \n"
+"  float ar = ry/rx; \n"
+"  float o = (atan (y, x*ar)) + PI/2.0; \n"
+" \n"
+"  float x1 = cos (o) * rx * ar; \n"
+"  float y1 = sin (o) * ry; \n"
+"  float h1 = length (vec2 (x1, y1)); \n"
+" \n"
+"  float kx = cos (o) * aa_size.x * ar; \n"
+"  float ky = sin (o) * aa_size.y; \n"
+"  float k = length (vec2 (kx, ky)); \n"
+" \n"
+"  float h = length (vec2 ((rx - x)*ar, ry - y)); \n"
+" \n"
+"  if (h > h1) \n"
+"    discard; \n"
+"  else if (h > h1 - k) \n"
+"    col.a *= (1.0/k) * (h1 - h); \n"
+" \n"
+"  my_FragColor = col; \n"
+" \n"
+"  return true; \n"
+"} \n"
+" \n"
+"bool \n"
+"draw_border_corner (vec4 col, \n"
+"                    float x, float y, \n"
+"                    float ar, \n"
+"                    vec2 outer_radi, \n"
+"                    vec2 inner_radi) \n"
+"{ \n"
+"  if (x > outer_radi.x + aa_size.x || y > outer_radi.y + aa_size.y) \n"
+"    return false; \n"
+" \n"
+"  float o = (atan (y, x*ar)) + PI/2.0; \n"
+" \n"
+"  float x1 = cos (o) * outer_radi.x * ar; \n"
+"  float y1 = sin (o) * outer_radi.y; \n"
+"  float h1 = length (vec2 (x1, y1)); \n"
+" \n"
+"  float x2 = cos (o) * inner_radi.x * ar; \n"
+"  float y2 = sin (o) * inner_radi.y; \n"
+"  float h2 = length (vec2 (x2, y2)); \n"
+" \n"
+"  float kx = cos (o) * aa_size.x * ar; \n"
+"  float ky = sin (o) * aa_size.y; \n"
+"  float k = length (vec2 (kx, ky)); \n"
+" \n"
+"  float h = length (vec2 ((outer_radi.x - x)*ar, outer_radi.y - y)); \n"
+" \n"
+"  if (h > h1 || h <= h2 - k) \n"
+"    discard; \n"
+"  else if (h > h1 - k) \n"
+"    col.a *= (1.0/k) * (h1 - h); \n"
+"  else if (h <= h2) \n"
+"    col.a *= (1.0/k) * (h - (h2 - k)); \n"
+" \n"
+"  my_FragColor = col; \n"
+" \n"
+"  return true; \n"
+"} \n"
+" \n"
+"// signed distance from 'p' to the edge of a box centered at the origin, \n"
+"// negative inside. 'radii' round its top-left, top-right, bottom-left and \n"
+"// bottom-right corners \n"
+"float \n"
+"rounded_box_distance (vec2 p, vec2 half_size, vec4 radii) \n"
+"{ \n"
+"  float r; \n"
+" \n"
+"  if (p.y < 0.0) \n"
+"    r = p.x < 0.0 ? radii.x : radii.y; \n"
+"  else \n"
+"    r = p.x < 0.0 ? radii.z : radii.w; \n"
+" \n"
+"  vec2 q = abs (p) - half_size + r; \n"
+" \n"
+"  return min (max (q.x, q.y), 0.0) + length (max (q, 0.0)) - r; \n"
+"} \n"
+" \n"
+"// how much of the fragment is inside the instance's clip, if any \n"
+"float \n"
+"clip_coverage () \n"
+"{ \n"
+"  if (clip_half_size.x < 0.0) \n"
+"    return 1.0; \n"
+" \n"
+"  float d = rounded_box_distance (clip_pos, clip_half_size, clip_radii); \n"
+" \n"
+"  return clamp (0.5 - d / max (aa_offset, 0.001), 0.0, 1.0); \n"
+"} \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"vec4 \n"
+"draw_box (vec4 bg) \n"
+"{ \n"
+"  vec4 bw = box_border_width; \n"
+"  float aa = max (aa_offset, 0.001); \n"
+" \n"
+"  // the area inside the border, and its corners \n"
+"  vec2 inner_half_size = max (box_half_size - (bw.xy + bw.zw) / 2.0, 0.0); \n"
+"  vec2 inner_center = (bw.xy - bw.zw) / 2.0; \n"
+"  vec4 inner_radii = max (box_radii - vec4 (max (bw.x, bw.y), \n"
+"                                            max (bw.y, bw.z), \n"
+"                                            max (bw.w, bw.x), \n"
+"                                            max (bw.z, bw.w)), \n"
+"                          0.0); \n"
+" \n"
+"  // away from the border and the inner corners there is only background \n"
+"  vec2 d = inner_half_size - abs (box_pos - inner_center); \n"
+"  float max_inner_radius = max (max (inner_radii.x, inner_radii.y), \n"
+"                                max (inner_radii.z, inner_radii.w)); \n"
+"  if (min (d.x, d.y) > aa && max (d.x, d.y) > max_inner_radius + aa) \n"
+"    return bg; \n"
+" \n"
+"  float outer = rounded_box_distance (box_pos, box_half_size, box_radii); \n"
+"  float coverage = clamp (0.5 - outer / aa, 0.0, 1.0); \n"
+"  if (coverage == 0.0) \n"
+"    discard; \n"
+" \n"
+"  float border = 0.0; \n"
+"  if (any (greaterThan (bw, vec4 (0.0)))) { \n"
+"    float inner = rounded_box_distance (box_pos - inner_center, \n"
+"                                        inner_half_size, \n"
+"                                        inner_radii); \n"
+"    border = clamp (0.5 + inner / aa, 0.0, 1.0); \n"
+"  } \n"
+" \n"
+"  // mix with premultiplied alpha, the background may be transparent \n"
+"  vec4 col = mix (vec4 (bg.rgb * bg.a, bg.a), \n"
+"                  vec4 (box_border_color.rgb * box_border_color.a, \n"
+"                        box_border_color.a), \n"
+"                  border); \n"
+"  if (col.a > 0.0) \n"
+"    col.rgb /= col.a; \n"
+" \n"
+"  col.a *= coverage; \n"
+" \n"
+"  return col; \n"
+"} \n"
+"#endif \n"
+" \n"
+"vec4 \n"
+"apply_vertical_aa (float s, vec4 col) \n"
+"{ \n"
+"  if (s < aa_size.s) \n"
+"    col.a *= (1.0/aa_size.s) * s; \n"
+"  else if (s > 1.0 - aa_size.s) \n"
+"    col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+" \n"
+"  return col; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"apply_horiz_aa (float t, vec4 col) \n"
+"{ \n"
+"  if (t < aa_size.t) \n"
+"    col.a *= (1.0/aa_size.t) * t; \n"
+"  else if (t > 1.0 - aa_size.t) \n"
+"    col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+" \n"
+"  return col; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"apply_linear_gradient (vec4 color, float s, float t) \n"
+"{ \n"
+"  float x, y, k; \n"
+" \n"
+"  if (linear_grad_angle < PI/2.0) \n"
+"    { \n"
+"      x = s; \n"
+"      y = t; \n"
+"      k = y; \n"
+"    } \n"
+"  else if (linear_grad_angle < PI) \n"
+"    { \n"
+"      x = 1.0 - s; \n"
+"      k = x; \n"
+"      y = t; \n"
+"    } \n"
+"  else if (linear_grad_angle < PI/2.0*3.0) \n"
+"    { \n"
+"      x = 1.0 - s; \n"
+"      y = 1.0 - t; \n"
+"      k = y; \n"
+"    } \n"
+"  else \n"
+"    { \n"
+"      x = s; \n"
+"      y = 1.0 - t; \n"
+"      k = x; \n"
+"    } \n"
+" \n"
+"  float st = length (vec2 (x, y)); \n"
+"  float teta = asin (k / st); \n"
+"  float d = st * sin (linear_grad_gamma + teta); \n"
+" \n"
+"  color = mix (linear_grad_colors[0], \n"
+"               linear_grad_colors[1], \n"
+"               d / linear_grad_length); \n"
+" \n"
+"  return color; \n"
+"} \n"
+" \n"
+"void \n"
+"draw_instance () \n"
+"{ \n"
+"  vec4 col = color; \n"
+" \n"
+"  float s = tex_coords.s; \n"
+"  float t = tex_coords.t; \n"
+" \n"
+"  vec2 br[4] = border_radius; \n"
+"  vec4 bw = border_width; \n"
+" \n"
+"#if defined (WITH_GLYPHS) \n"
+"  // character glyph \n"
+"  // --------------------------------------------------------------------------- \n"
+"  { \n"
+"    float f = 0.0; \n"
+"    vec4 a; \n"
+" \n"
+"    a = sample_glyph_cache (tex_id, vec2 (area_in_tex.x + s * area_in_tex.z, \n"
+"                                          area_in_tex.y + t * area_in_tex.w)); \n"
+" \n"
+"    f = a.r; \n"
+"    if (f == 0.0) \n"
+"      discard; \n"
+" \n"
+"    col.a *= f; \n"
+"  } \n"
+"#endif \n"
+" \n"
+"#if defined (WITH_RECTS) \n"
+"  // pixel-aligned rects need no anti-aliasing \n"
+"  if (instance_type == INSTANCE_RECT_ALIGNED) { \n"
+"    my_FragColor = col; \n"
+"    return; \n"
+"  } \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"  // background, border and corners of a rect in a single instance \n"
+"  // --------------------------------------------------------------------------- \n"
+"  if (instance_type == INSTANCE_BOX) { \n"
+"#if defined (WITH_GRADIENTS) \n"
+"    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD) \n"
+"      col = apply_linear_gradient (col, s, t); \n"
+"#endif \n"
+" \n"
+"    col = draw_box (col); \n"
+"  } \n"
+"  else \n"
+"#endif \n"
+" \n"
+"  // rectangle background \n"
+"  // --------------------------------------------------------------------------- \n"
+"  if (instance_type == INSTANCE_RECT_BG) { \n"
+"    float rx, ry; \n"
+" \n"
+"    // consider type of background \n"
+" \n"
+"#if defined (WITH_GRADIENTS) \n"
+"    // linear gradient \n"
+"    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD) \n"
+"      col = apply_linear_gradient (col, s, t); \n"
+"#endif \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    // top-left round corner \n"
+"    if (br[0].x * br[0].y > 0.0) { \n"
+"        rx = br[0].x * norm.x; \n"
+"        ry = br[0].y * norm.y; \n"
+"        if (draw_round_corner (col, s, t, rx, ry)) \n"
+"          return; \n"
+"      } \n"
+" \n"
+"    // top-right round corner \n"
+"    if (br[1].x * br[1].y > 0.0) { \n"
+"        rx = br[1].x * norm.x; \n"
+"        ry = br[1].y * norm.y; \n"
+"        if (draw_round_corner (col, 1.0 - s, t, rx, ry)) \n"
+"          return; \n"
+"    } \n"
+" \n"
+"    // bottom-left round corner \n"
+"    if (br[2].x * br[2].y > 0.0) { \n"
+"        rx = br[2].x * norm.x; \n"
+"        ry = br[2].y * norm.y; \n"
+"        if (draw_round_corner (col, s, 1.0 - t, rx, ry)) \n"
+"          return; \n"
+"      } \n"
+" \n"
+"    // bottom-right round corner \n"
+"    if (br[3].x * br[3].y > 0.0) { \n"
+"        rx = br[3].x * norm.x; \n"
+"        ry = br[3].y * norm.y; \n"
+"        if (draw_round_corner (col, 1.0 - s, 1.0 - t, rx, ry)) \n"
+"          return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    col = apply_vertical_aa (s, col); \n"
+"    col = apply_horiz_aa (t, col); \n"
+"  } \n"
+" \n"
+"  // solid border left or right \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_LEFT || instance_type == INSTANCE_BORDER_RIGHT) { \n"
+"    col = apply_vertical_aa (s, col); \n"
+"  } \n"
+" \n"
+"  // solid border top or bottom \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP || instance_type == INSTANCE_BORDER_BOTTOM) { \n"
+"    col = apply_horiz_aa (t, col); \n"
+"  } \n"
+" \n"
+"  // top-left solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP_LEFT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[0].x > 0.0 && br[0].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[0].x * norm.x, br[0].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[0] - br[0].x) * norm.x, 0.0), \n"
+"                              min ((bw[1] - br[0].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[0].y, bw[1]) / max (br[0].x, bw[0]); \n"
+"      if (draw_border_corner (col, s, t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s < aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * s; \n"
+"    if (t < aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * t; \n"
+"  } \n"
+" \n"
+"  // top-right solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP_RIGHT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[1].x > 0.0 && br[1].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[1].x * norm.x, br[1].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[2] - br[1].x) * norm.x, 0.0), \n"
+"                              min ((bw[1] - br[1].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[1].y, bw[1]) / max (br[1].x, bw[2]); \n"
+"      if (draw_border_corner (col, 1.0 - s, t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s > 1.0 - aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+"    if (t < aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * t; \n"
+"  } \n"
+" \n"
+"  // bottom-right solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_BOTTOM_RIGHT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[2].x > 0.0 && br[2].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[2].x * norm.x, br[2].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[2] - br[2].x) * norm.x, 0.0), \n"
+"                              min ((bw[3] - br[2].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[2].y, bw[2]) / max (br[2].x, bw[3]); \n"
+"      if (draw_border_corner (col, 1.0 - s, 1.0 - t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s > 1.0 - aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+"    if (t > 1.0 - aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+"  } \n"
+" \n"
+"  // bottom-left solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_BOTTOM_LEFT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[3].x > 0.0 && br[3].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[3].x * norm.x, br[3].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[0] - br[3].x) * norm.x, 0.0), \n"
+"                              min ((bw[3] - br[3].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[3].y, bw[0]) / max (br[3].x, bw[3]); \n"
+"      if (draw_border_corner (col, s, 1.0 - t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s < aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * s; \n"
+"    if (t > 1.0 - aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+"  } \n"
+"#endif \n"
+" \n"
+"  my_FragColor = col; \n"
+"} \n"
+" \n"
+"void \n"
+"main () \n"
+"{ \n"
+"  float clip = clip_coverage (); \n"
+" \n"
+"  if (clip == 0.0) \n"
+"    discard; \n"
+" \n"
+"  draw_instance (); \n"
+" \n"
+"  my_FragColor.a *= clip * instance_opacity; \n"
+"} \n"
+;
+
+const char *INSTANCED_FRAGMENT_SHADER_GRADIENT_SRC =
+"#version 300 es \n"
+"#define GLR_CLASS_GRADIENT \n"
+" \n"
+"// this shader is built into one program per instance class (see the \n"
+"// Makefile), each defining one of GLR_CLASS_SOLID, GLR_CLASS_ROUNDED, \n"
+"// GLR_CLASS_GRADIENT or GLR_CLASS_GLYPH. A variant only carries the code \n"
+"// its class needs, so instances of different kinds do not share a program \n"
+"#if defined (GLR_CLASS_GLYPH) \n"
+"#  define WITH_GLYPHS \n"
+"#else \n"
+"#  define WITH_RECTS \n"
+"#  if defined (GLR_CLASS_ROUNDED) || defined (GLR_CLASS_GRADIENT) \n"
+"#    define WITH_ROUND_CORNERS \n"
+"#  endif \n"
+"#  if defined (GLR_CLASS_GRADIENT) \n"
+"#    define WITH_GRADIENTS \n"
+"#  endif \n"
+"#endif \n"
+" \n"
+"precision highp float; \n"
+" \n"
+"const float PI = 3.14159265359; \n"
+" \n"
+"const uint INSTANCE_RECT_BG             = uint (0); \n"
+"const uint INSTANCE_BORDER_TOP          = uint (1); \n"
+"const uint INSTANCE_BORDER_RIGHT        = uint (2); \n"
+"const uint INSTANCE_BORDER_BOTTOM       = uint (3); \n"
+"const uint INSTANCE_BORDER_LEFT         = uint (4); \n"
+"const uint INSTANCE_BORDER_TOP_LEFT     = uint (5); \n"
+"const uint INSTANCE_BORDER_TOP_RIGHT    = uint (6); \n"
+"const uint INSTANCE_BORDER_BOTTOM_LEFT  = uint (7); \n"
+"const uint INSTANCE_BORDER_BOTTOM_RIGHT = uint (8); \n"
+"const uint INSTANCE_CHAR_GLYPH          = uint (9); \n"
+"const uint INSTANCE_BOX                 = uint (10); \n"
+"const uint INSTANCE_RECT_ALIGNED        = uint (11); \n"
+" \n"
+"const int BACKGROUND_TYPE_NONE         = 0; \n"
+"const int BACKGROUND_TYPE_SOLID_COLOR  = 1; \n"
+"const int BACKGROUND_TYPE_IMAGE        = 2; \n"
+"const int BACKGROUND_TYPE_LINEAR_GRAD  = 3; \n"
+"const int BACKGROUND_TYPE_RADIAL_GRAD  = 4; \n"
+" \n"
+"     out vec4  my_FragColor; \n"
+" \n"
+"     in  vec4  color; \n"
+"     in  vec2  tex_coords; \n"
+" \n"
+"flat in  vec2  norm; \n"
+"flat in  vec2  aa_size; \n"
+" \n"
+"flat in  uint  instance_type; \n"
+" \n"
+"flat in  vec4  area_in_tex; \n"
+"flat in  int   tex_id; \n"
+" \n"
+"flat in  ivec4 border_style; \n"
+"flat in  vec4  border_width; \n"
+"flat in  vec2  border_radius[4]; \n"
+"flat in  uvec4 border_color; \n"
+" \n"
+"flat in  int   background_type; \n"
+" \n"
+"     in  vec2  box_pos; \n"
+"flat in  vec2  box_half_size; \n"
+"flat in  vec4  box_border_width; \n"
+"flat in  vec4  box_radii; \n"
+"flat in  vec4  box_border_color; \n"
+" \n"
+"     in  vec2  clip_pos; \n"
+"flat in  vec2  clip_half_size; \n"
+"flat in  vec4  clip_radii; \n"
+" \n"
+"flat in  float instance_opacity; \n"
+" \n"
+"uniform float aa_offset; \n"
+" \n"
+"flat in  vec4  linear_grad_colors[2]; \n"
+"flat in  float linear_grad_steps[4]; \n"
+"flat in  float linear_grad_angle; \n"
+"flat in  float linear_grad_gamma; \n"
+"flat in  float linear_grad_length; \n"
+" \n"
+"uniform sampler2D glyph_cache[8]; \n"
+" \n"
+"vec4 \n"
+"sample_glyph_cache (int tex_id, mediump vec2 tex_coord) \n"
+"{ \n"
+"  switch (tex_id) \n"
+"    { \n"
+"    case 0: return texture (glyph_cache[0], tex_coord); \n"
+"    case 1: return texture (glyph_cache[1], tex_coord); \n"
+"    case 2: return texture (glyph_cache[2], tex_coord); \n"
+"    case 3: return texture (glyph_cache[3], tex_coord); \n"
+"    case 4: return texture (glyph_cache[4], tex_coord); \n"
+"    case 5: return texture (glyph_cache[5], tex_coord); \n"
+"    case 6: return texture (glyph_cache[6], tex_coord); \n"
+"    case 7: return texture (glyph_cache[7], tex_coord); \n"
+"    } \n"
+"} \n"
+" \n"
+"bool \n"
+"draw_round_corner (vec4 col, float x, float y, float rx, float ry) \n"
+"{ \n"
+"  if (x >= rx || y >= ry || x < 0.0 || y < 0.0) \n"
+"    return false; \n"
+" \n"
+"  float ar = ry/rx; \n"
+"  float o = (atan (y, x*ar)) + PI/2.0; \n"
+" \n"
+"  float x1 = cos (o) * rx * ar; \n"
+"  float y1 = sin (o) * ry; \n"
+"  float h1 = length (vec2 (x1, y1)); \n"
+" \n"
+"  float kx = cos (o) * aa_size.x * ar; \n"
+"  float ky = sin (o) * aa_size.y; \n"
+"  float k = length (vec2 (kx, ky)); \n"
+" \n"
+"  float h = length (vec2 ((rx - x)*ar, ry - y)); \n"
+" \n"
+"  if (h > h1) \n"
+"    discard; \n"
+"  else if (h > h1 - k) \n"
+"    col.a *= (1.0/k) * (h1 - h); \n"
+" \n"
+"  my_FragColor = col; \n"
+" \n"
+"  return true; \n"
+"} \n"
+" \n"
+"bool \n"
+"draw_border_corner (vec4 col, \n"
+"                    float x, float y, \n"
+"                    float ar, \n"
+"                    vec2 outer_radi, \n"
+"                    vec2 inner_radi) \n"
+"{ \n"
+"  if (x > outer_radi.x + aa_size.x || y > outer_radi.y + aa_size.y) \n"
+"    return false; \n"
+" \n"
+"  float o = (atan (y, x*ar)) + PI/2.0; \n"
+" \n"
+"  float x1 = cos (o) * outer_radi.x * ar; \n"
+"  float y1 = sin (o) * outer_radi.y; \n"
+"  float h1 = length (vec2 (x1, y1)); \n"
+" \n"
+"  float x2 = cos (o) * inner_radi.x * ar; \n"
+"  float y2 = sin (o) * inner_radi.y; \n"
+"  float h2 = length (vec2 (x2, y2)); \n"
+" \n"
+"  float kx = cos (o) * aa_size.x * ar; \n"
+"  float ky = sin (o) * aa_size.y; \n"
+"  float k = length (vec2 (kx, ky)); \n"
+" \n"
+"  float h = length (vec2 ((outer_radi.x - x)*ar, outer_radi.y - y)); \n"
+" \n"
+"  if (h > h1 || h <= h2 - k) \n"
+"    discard; \n"
+"  else if (h > h1 - k) \n"
+"    col.a *= (1.0/k) * (h1 - h); \n"
+"  else if (h <= h2) \n"
+"    col.a *= (1.0/k) * (h - (h2 - k)); \n"
+" \n"
+"  my_FragColor = col; \n"
+" \n"
+"  return true; \n"
+"} \n"
+" \n"
+"// signed distance from 'p' to the edge of a box centered at the origin, \n"
+"// negative inside. 'radii' round its top-left, top-right, bottom-left and \n"
+"// bottom-right corners \n"
+"float \n"
+"rounded_box_distance (vec2 p, vec2 half_size, vec4 radii) \n"
+"{ \n"
+"  float r; \n"
+" \n"
+"  if (p.y < 0.0) \n"
+"    r = p.x < 0.0 ? radii.x : radii.y; \n"
+"  else \n"
+"    r = p.x < 0.0 ? radii.z : radii.w; \n"
+" \n"
+"  vec2 q = abs (p) - half_size + r; \n"
+" \n"
+"  return min (max (q.x, q.y), 0.0) + length (max (q, 0.0)) - r; \n"
+"} \n"
+" \n"
+"// how much of the fragment is inside the instance's clip, if any \n"
+"float \n"
+"clip_coverage () \n"
+"{ \n"
+"  if (clip_half_size.x < 0.0) \n"
+"    return 1.0; \n"
+" \n"
+"  float d = rounded_box_distance (clip_pos, clip_half_size, clip_radii); \n"
+" \n"
+"  return clamp (0.5 - d / max (aa_offset, 0.001), 0.0, 1.0); \n"
+"} \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"vec4 \n"
+"draw_box (vec4 bg) \n"
+"{ \n"
+"  vec4 bw = box_border_width; \n"
+"  float aa = max (aa_offset, 0.001); \n"
+" \n"
+"  // the area inside the border, and its corners \n"
+"  vec2 inner_half_size = max (box_half_size - (bw.xy + bw.zw) / 2.0, 0.0); \n"
+"  vec2 inner_center = (bw.xy - bw.zw) / 2.0; \n"
+"  vec4 inner_radii = max (box_radii - vec4 (max (bw.x, bw.y), \n"
+"                                            max (bw.y, bw.z), \n"
+"                                            max (bw.w, bw.x), \n"
+"                                            max (bw.z, bw.w)), \n"
+"                          0.0); \n"
+" \n"
+"  // away from the border and the inner corners there is only background \n"
+"  vec2 d = inner_half_size - abs (box_pos - inner_center); \n"
+"  float max_inner_radius = max (max (inner_radii.x, inner_radii.y), \n"
+"                                max (inner_radii.z, inner_radii.w)); \n"
+"  if (min (d.x, d.y) > aa && max (d.x, d.y) > max_inner_radius + aa) \n"
+"    return bg; \n"
+" \n"
+"  float outer = rounded_box_distance (box_pos, box_half_size, box_radii); \n"
+"  float coverage = clamp (0.5 - outer / aa, 0.0, 1.0); \n"
+"  if (coverage == 0.0) \n"
+"    discard; \n"
+" \n"
+"  float border = 0.0; \n"
+"  if (any (greaterThan (bw, vec4 (0.0)))) { \n"
+"    float inner = rounded_box_distance (box_pos - inner_center, \n"
+"                                        inner_half_size, \n"
+"                                        inner_radii); \n"
+"    border = clamp (0.5 + inner / aa, 0.0, 1.0); \n"
+"  } \n"
+" \n"
+"  // mix with premultiplied alpha, the background may be transparent \n"
+"  vec4 col = mix (vec4 (bg.rgb * bg.a, bg.a), \n"
+"                  vec4 (box_border_color.rgb * box_border_color.a, \n"
+"                        box_border_color.a), \n"
+"                  border); \n"
+"  if (col.a > 0.0) \n"
+"    col.rgb /= col.a; \n"
+" \n"
+"  col.a *= coverage; \n"
+" \n"
+"  return col; \n"
+"} \n"
+"#endif \n"
+" \n"
+"vec4 \n"
+"apply_vertical_aa (float s, vec4 col) \n"
+"{ \n"
+"  if (s < aa_size.s) \n"
+"    col.a *= (1.0/aa_size.s) * s; \n"
+"  else if (s > 1.0 - aa_size.s) \n"
+"    col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+" \n"
+"  return col; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"apply_horiz_aa (float t, vec4 col) \n"
+"{ \n"
+"  if (t < aa_size.t) \n"
+"    col.a *= (1.0/aa_size.t) * t; \n"
+"  else if (t > 1.0 - aa_size.t) \n"
+"    col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+" \n"
+"  return col; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"apply_linear_gradient (vec4 color, float s, float t) \n"
+"{ \n"
+"  float x, y, k; \n"
+" \n"
+"  if (linear_grad_angle < PI/2.0) \n"
+"    { \n"
+"      x = s; \n"
+"      y = t; \n"
+"      k = y; \n"
+"    } \n"
+"  else if (linear_grad_angle < PI) \n"
+"    { \n"
+"      x = 1.0 - s; \n"
+"      k = x; \n"
+"      y = t; \n"
+"    } \n"
+"  else if (linear_grad_angle < PI/2.0*3.0) \n"
+"    { \n"
+"      x = 1.0 - s; \n"
+"      y = 1.0 - t; \n"
+"      k = y; \n"
+"    } \n"
+"  else \n"
+"    { \n"
+"      x = s; \n"
+"      y = 1.0 - t; \n"
+"      k = x; \n"
+"    } \n"
+" \n"
+"  float st = length (vec2 (x, y)); \n"
+"  float teta = asin (k / st); \n"
+"  float d = st * sin (linear_grad_gamma + teta); \n"
+" \n"
+"  color = mix (linear_grad_colors[0], \n"
+"               linear_grad_colors[1], \n"
+"               d / linear_grad_length); \n"
+" \n"
+"  return color; \n"
+"} \n"
+" \n"
+"void \n"
+"draw_instance () \n"
+"{ \n"
+"  vec4 col = color; \n"
+" \n"
+"  float s = tex_coords.s; \n"
+"  float t = tex_coords.t; \n"
+" \n"
+"  vec2 br[4] = border_radius; \n"
+"  vec4 bw = border_width; \n"
+" \n"
+"#if defined (WITH_GLYPHS) \n"
+"  // character glyph \n"
+"  // --------------------------------------------------------------------------- \n"
+"  { \n"
+"    float f = 0.0; \n"
+"    vec4 a; \n"
+" \n"
+"    a = sample_glyph_cache (tex_id, vec2 (area_in_tex.x + s * area_in_tex.z, \n"
+"                                          area_in_tex.y + t * area_in_tex.w)); \n"
+" \n"
+"    f = a.r; \n"
+"    if (f == 0.0) \n"
+"      discard; \n"
+" \n"
+"    col.a *= f; \n"
+"  } \n"
+"#endif \n"
+" \n"
+"#if defined (WITH_RECTS) \n"
+"  // pixel-aligned rects need no anti-aliasing \n"
+"  if (instance_type == INSTANCE_RECT_ALIGNED) { \n"
+"    my_FragColor = col; \n"
+"    return; \n"
+"  } \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"  // background, border and corners of a rect in a single instance \n"
+"  // --------------------------------------------------------------------------- \n"
+"  if (instance_type == INSTANCE_BOX) { \n"
+"#if defined (WITH_GRADIENTS) \n"
+"    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD) \n"
+"      col = apply_linear_gradient (col, s, t); \n"
+"#endif \n"
+" \n"
+"    col = draw_box (col); \n"
+"  } \n"
+"  else \n"
+"#endif \n"
+" \n"
+"  // rectangle background \n"
+"  // --------------------------------------------------------------------------- \n"
+"  if (instance_type == INSTANCE_RECT_BG) { \n"
+"    float rx, ry; \n"
+" \n"
+"    // consider type of background \n"
+" \n"
+"#if defined (WITH_GRADIENTS) \n"
+"    // linear gradient \n"
+"    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD) \n"
+"      col = apply_linear_gradient (col, s, t); \n"
+"#endif \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    // top-left round corner \n"
+"    if (br[0].x * br[0].y > 0.0) { \n"
+"        rx = br[0].x * norm.x; \n"
+"        ry = br[0].y * norm.y; \n"
+"        if (draw_round_corner (col, s, t, rx, ry)) \n"
+"          return; \n"
+"      } \n"
+" \n"
+"    // top-right round corner \n"
+"    if (br[1].x * br[1].y > 0.0) { \n"
+"        rx = br[1].x * norm.x; \n"
+"        ry = br[1].y * norm.y; \n"
+"        if (draw_round_corner (col, 1.0 - s, t, rx, ry)) \n"
+"          return; \n"
+"    } \n"
+" \n"
+"    // bottom-left round corner \n"
+"    if (br[2].x * br[2].y > 0.0) { \n"
+"        rx = br[2].x * norm.x; \n"
+"        ry = br[2].y * norm.y; \n"
+"        if (draw_round_corner (col, s, 1.0 - t, rx, ry)) \n"
+"          return; \n"
+"      } \n"
+" \n"
+"    // bottom-right round corner \n"
+"    if (br[3].x * br[3].y > 0.0) { \n"
+"        rx = br[3].x * norm.x; \n"
+"        ry = br[3].y * norm.y; \n"
+"        if (draw_round_corner (col, 1.0 - s, 1.0 - t, rx, ry)) \n"
+"          return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    col = apply_vertical_aa (s, col); \n"
+"    col = apply_horiz_aa (t, col); \n"
+"  } \n"
+" \n"
+"  // solid border left or right \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_LEFT || instance_type == INSTANCE_BORDER_RIGHT) { \n"
+"    col = apply_vertical_aa (s, col); \n"
+"  } \n"
+" \n"
+"  // solid border top or bottom \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP || instance_type == INSTANCE_BORDER_BOTTOM) { \n"
+"    col = apply_horiz_aa (t, col); \n"
+"  } \n"
+" \n"
+"  // top-left solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP_LEFT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[0].x > 0.0 && br[0].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[0].x * norm.x, br[0].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[0] - br[0].x) * norm.x, 0.0), \n"
+"                              min ((bw[1] - br[0].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[0].y, bw[1]) / max (br[0].x, bw[0]); \n"
+"      if (draw_border_corner (col, s, t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s < aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * s; \n"
+"    if (t < aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * t; \n"
+"  } \n"
+" \n"
+"  // top-right solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP_RIGHT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[1].x > 0.0 && br[1].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[1].x * norm.x, br[1].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[2] - br[1].x) * norm.x, 0.0), \n"
+"                              min ((bw[1] - br[1].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[1].y, bw[1]) / max (br[1].x, bw[2]); \n"
+"      if (draw_border_corner (col, 1.0 - s, t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s > 1.0 - aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+"    if (t < aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * t; \n"
+"  } \n"
+" \n"
+"  // bottom-right solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_BOTTOM_RIGHT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[2].x > 0.0 && br[2].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[2].x * norm.x, br[2].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[2] - br[2].x) * norm.x, 0.0), \n"
+"                              min ((bw[3] - br[2].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[2].y, bw[2]) / max (br[2].x, bw[3]); \n"
+"      if (draw_border_corner (col, 1.0 - s, 1.0 - t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s > 1.0 - aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+"    if (t > 1.0 - aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+"  } \n"
+" \n"
+"  // bottom-left solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_BOTTOM_LEFT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[3].x > 0.0 && br[3].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[3].x * norm.x, br[3].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[0] - br[3].x) * norm.x, 0.0), \n"
+"                              min ((bw[3] - br[3].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[3].y, bw[0]) / max (br[3].x, bw[3]); \n"
+"      if (draw_border_corner (col, s, 1.0 - t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s < aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * s; \n"
+"    if (t > 1.0 - aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+"  } \n"
+"#endif \n"
+" \n"
+"  my_FragColor = col; \n"
+"} \n"
+" \n"
+"void \n"
+"main () \n"
+"{ \n"
+"  float clip = clip_coverage (); \n"
+" \n"
+"  if (clip == 0.0) \n"
+"    discard; \n"
+" \n"
+"  draw_instance (); \n"
+" \n"
+"  my_FragColor.a *= clip * instance_opacity; \n"
+"} \n"
+;
+
+const char *INSTANCED_FRAGMENT_SHADER_GLYPH_SRC =
+"#version 300 es \n"
+"#define GLR_CLASS_GLYPH \n"
+" \n"
+"// this shader is built into one program per instance class (see the \n"
+"// Makefile), each defining one of GLR_CLASS_SOLID, GLR_CLASS_ROUNDED, \n"
+"// GLR_CLASS_GRADIENT or GLR_CLASS_GLYPH. A variant only carries the code \n"
+"// its class needs, so instances of different kinds do not share a program \n"
+"#if defined (GLR_CLASS_GLYPH) \n"
+"#  define WITH_GLYPHS \n"
+"#else \n"
+"#  define WITH_RECTS \n"
+"#  if defined (GLR_CLASS_ROUNDED) || defined (GLR_CLASS_GRADIENT) \n"
+"#    define WITH_ROUND_CORNERS \n"
+"#  endif \n"
+"#  if defined (GLR_CLASS_GRADIENT) \n"
+"#    define WITH_GRADIENTS \n"
+"#  endif \n"
+"#endif \n"
+" \n"
+"precision highp float; \n"
+" \n"
+"const float PI = 3.14159265359; \n"
+" \n"
+"const uint INSTANCE_RECT_BG             = uint (0); \n"
+"const uint INSTANCE_BORDER_TOP          = uint (1); \n"
+"const uint INSTANCE_BORDER_RIGHT        = uint (2); \n"
+"const uint INSTANCE_BORDER_BOTTOM       = uint (3); \n"
+"const uint INSTANCE_BORDER_LEFT         = uint (4); \n"
+"const uint INSTANCE_BORDER_TOP_LEFT     = uint (5); \n"
+"const uint INSTANCE_BORDER_TOP_RIGHT    = uint (6); \n"
+"const uint INSTANCE_BORDER_BOTTOM_LEFT  = uint (7); \n"
+"const uint INSTANCE_BORDER_BOTTOM_RIGHT = uint (8); \n"
+"const uint INSTANCE_CHAR_GLYPH          = uint (9); \n"
+"const uint INSTANCE_BOX                 = uint (10); \n"
+"const uint INSTANCE_RECT_ALIGNED        = uint (11); \n"
+" \n"
+"const int BACKGROUND_TYPE_NONE         = 0; \n"
+"const int BACKGROUND_TYPE_SOLID_COLOR  = 1; \n"
+"const int BACKGROUND_TYPE_IMAGE        = 2; \n"
+"const int BACKGROUND_TYPE_LINEAR_GRAD  = 3; \n"
+"const int BACKGROUND_TYPE_RADIAL_GRAD  = 4; \n"
+" \n"
+"     out vec4  my_FragColor; \n"
+" \n"
+"     in  vec4  color; \n"
+"     in  vec2  tex_coords; \n"
+" \n"
+"flat in  vec2  norm; \n"
+"flat in  vec2  aa_size; \n"
+" \n"
+"flat in  uint  instance_type; \n"
+" \n"
+"flat in  vec4  area_in_tex; \n"
+"flat in  int   tex_id; \n"
+" \n"
+"flat in  ivec4 border_style; \n"
+"flat in  vec4  border_width; \n"
+"flat in  vec2  border_radius[4]; \n"
+"flat in  uvec4 border_color; \n"
+" \n"
+"flat in  int   background_type; \n"
+" \n"
+"     in  vec2  box_pos; \n"
+"flat in  vec2  box_half_size; \n"
+"flat in  vec4  box_border_width; \n"
+"flat in  vec4  box_radii; \n"
+"flat in  vec4  box_border_color; \n"
+" \n"
+"     in  vec2  clip_pos; \n"
+"flat in  vec2  clip_half_size; \n"
+"flat in  vec4  clip_radii; \n"
+" \n"
+"flat in  float instance_opacity; \n"
+" \n"
+"uniform float aa_offset; \n"
+" \n"
+"flat in  vec4  linear_grad_colors[2]; \n"
+"flat in  float linear_grad_steps[4]; \n"
+"flat in  float linear_grad_angle; \n"
+"flat in  float linear_grad_gamma; \n"
+"flat in  float linear_grad_length; \n"
+" \n"
+"uniform sampler2D glyph_cache[8]; \n"
+" \n"
+"vec4 \n"
+"sample_glyph_cache (int tex_id, mediump vec2 tex_coord) \n"
+"{ \n"
+"  switch (tex_id) \n"
+"    { \n"
+"    case 0: return texture (glyph_cache[0], tex_coord); \n"
+"    case 1: return texture (glyph_cache[1], tex_coord); \n"
+"    case 2: return texture (glyph_cache[2], tex_coord); \n"
+"    case 3: return texture (glyph_cache[3], tex_coord); \n"
+"    case 4: return texture (glyph_cache[4], tex_coord); \n"
+"    case 5: return texture (glyph_cache[5], tex_coord); \n"
+"    case 6: return texture (glyph_cache[6], tex_coord); \n"
+"    case 7: return texture (glyph_cache[7], tex_coord); \n"
+"    } \n"
+"} \n"
+" \n"
+"bool \n"
+"draw_round_corner (vec4 col, float x, float y, float rx, float ry) \n"
+"{ \n"
+"  if (x >= rx || y >= ry || x < 0.0 || y < 0.0) \n"
+"    return false; \n"
+" \n"
+"  float ar = ry/rx; \n"
+"  float o = (atan (y, x*ar)) + PI/2.0; \n"
+" \n"
+"  float x1 = cos (o) * rx * ar; \n"
+"  float y1 = sin (o) * ry; \n"
+"  float h1 = length (vec2 (x1, y1)); \n"
+" \n"
+"  float kx = cos (o) * aa_size.x * ar; \n"
+"  float ky = sin (o) * aa_size.y; \n"
+"  float k = length (vec2 (kx, ky)); \n"
+" \n"
+"  float h = length (vec2 ((rx - x)*ar, ry - y)); \n"
+" \n"
+"  if (h > h1) \n"
+"    discard; \n"
+"  else if (h > h1 - k) \n"
+"    col.a *= (1.0/k) * (h1 - h); \n"
+" \n"
+"  my_FragColor = col; \n"
+" \n"
+"  return true; \n"
+"} \n"
+" \n"
+"bool \n"
+"draw_border_corner (vec4 col, \n"
+"                    float x, float y, \n"
+"                    float ar, \n"
+"                    vec2 outer_radi, \n"
+"                    vec2 inner_radi) \n"
+"{ \n"
+"  if (x > outer_radi.x + aa_size.x || y > outer_radi.y + aa_size.y) \n"
+"    return false; \n"
+" \n"
+"  float o = (atan (y, x*ar)) + PI/2.0; \n"
+" \n"
+"  float x1 = cos (o) * outer_radi.x * ar; \n"
+"  float y1 = sin (o) * outer_radi.y; \n"
+"  float h1 = length (vec2 (x1, y1)); \n"
+" \n"
+"  float x2 = cos (o) * inner_radi.x * ar; \n"
+"  float y2 = sin (o) * inner_radi.y; \n"
+"  float h2 = length (vec2 (x2, y2)); \n"
+" \n"
+"  float kx = cos (o) * aa_size.x * ar; \n"
+"  float ky = sin (o) * aa_size.y; \n"
+"  float k = length (vec2 (kx, ky)); \n"
+" \n"
+"  float h = length (vec2 ((outer_radi.x - x)*ar, outer_radi.y - y)); \n"
+" \n"
+"  if (h > h1 || h <= h2 - k) \n"
+"    discard; \n"
+"  else if (h > h1 - k) \n"
+"    col.a *= (1.0/k) * (h1 - h); \n"
+"  else if (h <= h2) \n"
+"    col.a *= (1.0/k) * (h - (h2 - k)); \n"
+" \n"
+"  my_FragColor = col; \n"
+" \n"
+"  return true; \n"
+"} \n"
+" \n"
+"// signed distance from 'p' to the edge of a box centered at the origin, \n"
+"// negative inside. 'radii' round its top-left, top-right, bottom-left and \n"
+"// bottom-right corners \n"
+"float \n"
+"rounded_box_distance (vec2 p, vec2 half_size, vec4 radii) \n"
+"{ \n"
+"  float r; \n"
+" \n"
+"  if (p.y < 0.0) \n"
+"    r = p.x < 0.0 ? radii.x : radii.y; \n"
+"  else \n"
+"    r = p.x < 0.0 ? radii.z : radii.w; \n"
+" \n"
+"  vec2 q = abs (p) - half_size + r; \n"
+" \n"
+"  return min (max (q.x, q.y), 0.0) + length (max (q, 0.0)) - r; \n"
+"} \n"
+" \n"
+"// how much of the fragment is inside the instance's clip, if any \n"
+"float \n"
+"clip_coverage () \n"
+"{ \n"
+"  if (clip_half_size.x < 0.0) \n"
+"    return 1.0; \n"
+" \n"
+"  float d = rounded_box_distance (clip_pos, clip_half_size, clip_radii); \n"
+" \n"
+"  return clamp (0.5 - d / max (aa_offset, 0.001), 0.0, 1.0); \n"
+"} \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"vec4 \n"
+"draw_box (vec4 bg) \n"
+"{ \n"
+"  vec4 bw = box_border_width; \n"
+"  float aa = max (aa_offset, 0.001); \n"
+" \n"
+"  // the area inside the border, and its corners \n"
+"  vec2 inner_half_size = max (box_half_size - (bw.xy + bw.zw) / 2.0, 0.0); \n"
+"  vec2 inner_center = (bw.xy - bw.zw) / 2.0; \n"
+"  vec4 inner_radii = max (box_radii - vec4 (max (bw.x, bw.y), \n"
+"                                            max (bw.y, bw.z), \n"
+"                                            max (bw.w, bw.x), \n"
+"                                            max (bw.z, bw.w)), \n"
+"                          0.0); \n"
+" \n"
+"  // away from the border and the inner corners there is only background \n"
+"  vec2 d = inner_half_size - abs (box_pos - inner_center); \n"
+"  float max_inner_radius = max (max (inner_radii.x, inner_radii.y), \n"
+"                                max (inner_radii.z, inner_radii.w)); \n"
+"  if (min (d.x, d.y) > aa && max (d.x, d.y) > max_inner_radius + aa) \n"
+"    return bg; \n"
+" \n"
+"  float outer = rounded_box_distance (box_pos, box_half_size, box_radii); \n"
+"  float coverage = clamp (0.5 - outer / aa, 0.0, 1.0); \n"
+"  if (coverage == 0.0) \n"
+"    discard; \n"
+" \n"
+"  float border = 0.0; \n"
+"  if (any (greaterThan (bw, vec4 (0.0)))) { \n"
+"    float inner = rounded_box_distance (box_pos - inner_center, \n"
+"                                        inner_half_size, \n"
+"                                        inner_radii); \n"
+"    border = clamp (0.5 + inner / aa, 0.0, 1.0); \n"
+"  } \n"
+" \n"
+"  // mix with premultiplied alpha, the background may be transparent \n"
+"  vec4 col = mix (vec4 (bg.rgb * bg.a, bg.a), \n"
+"                  vec4 (box_border_color.rgb * box_border_color.a, \n"
+"                        box_border_color.a), \n"
+"                  border); \n"
+"  if (col.a > 0.0) \n"
+"    col.rgb /= col.a; \n"
+" \n"
+"  col.a *= coverage; \n"
+" \n"
+"  return col; \n"
+"} \n"
+"#endif \n"
+" \n"
+"vec4 \n"
+"apply_vertical_aa (float s, vec4 col) \n"
+"{ \n"
+"  if (s < aa_size.s) \n"
+"    col.a *= (1.0/aa_size.s) * s; \n"
+"  else if (s > 1.0 - aa_size.s) \n"
+"    col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+" \n"
+"  return col; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"apply_horiz_aa (float t, vec4 col) \n"
+"{ \n"
+"  if (t < aa_size.t) \n"
+"    col.a *= (1.0/aa_size.t) * t; \n"
+"  else if (t > 1.0 - aa_size.t) \n"
+"    col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+" \n"
+"  return col; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"apply_linear_gradient (vec4 color, float s, float t) \n"
+"{ \n"
+"  float x, y, k; \n"
+" \n"
+"  if (linear_grad_angle < PI/2.0) \n"
+"    { \n"
+"      x = s; \n"
+"      y = t; \n"
+"      k = y; \n"
+"    } \n"
+"  else if (linear_grad_angle < PI) \n"
+"    { \n"
+"      x = 1.0 - s; \n"
+"      k = x; \n"
+"      y = t; \n"
+"    } \n"
+"  else if (linear_grad_angle < PI/2.0*3.0) \n"
+"    { \n"
+"      x = 1.0 - s; \n"
+"      y = 1.0 - t; \n"
+"      k = y; \n"
+"    } \n"
+"  else \n"
+"    { \n"
+"      x = s; \n"
+"      y = 1.0 - t; \n"
+"      k = x; \n"
+"    } \n"
+" \n"
+"  float st = length (vec2 (x, y)); \n"
+"  float teta = asin (k / st); \n"
+"  float d = st * sin (linear_grad_gamma + teta); \n"
+" \n"
+"  color = mix (linear_grad_colors[0], \n"
+"               linear_grad_colors[1], \n"
+"               d / linear_grad_length); \n"
+" \n"
+"  return color; \n"
+"} \n"
+" \n"
+"void \n"
+"draw_instance () \n"
+"{ \n"
+"  vec4 col = color; \n"
+" \n"
+"  float s = tex_coords.s; \n"
+"  float t = tex_coords.t; \n"
+" \n"
+"  vec2 br[4] = border_radius; \n"
+"  vec4 bw = border_width; \n"
+" \n"
+"#if defined (WITH_GLYPHS) \n"
+"  // character glyph \n"
+"  // --------------------------------------------------------------------------- \n"
+"  { \n"
+"    float f = 0.0; \n"
+"    vec4 a; \n"
+" \n"
+"    a = sample_glyph_cache (tex_id, vec2 (area_in_tex.x + s * area_in_tex.z, \n"
+"                                          area_in_tex.y + t * area_in_tex.w)); \n"
+" \n"
+"    f = a.r; \n"
+"    if (f == 0.0) \n"
+"      discard; \n"
+" \n"
+"    col.a *= f; \n"
+"  } \n"
+"#endif \n"
+" \n"
+"#if defined (WITH_RECTS) \n"
+"  // pixel-aligned rects need no anti-aliasing \n"
+"  if (instance_type == INSTANCE_RECT_ALIGNED) { \n"
+"    my_FragColor = col; \n"
+"    return; \n"
+"  } \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"  // background, border and corners of a rect in a single instance \n"
+"  // --------------------------------------------------------------------------- \n"
+"  if (instance_type == INSTANCE_BOX) { \n"
+"#if defined (WITH_GRADIENTS) \n"
+"    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD) \n"
+"      col = apply_linear_gradient (col, s, t); \n"
+"#endif \n"
+" \n"
+"    col = draw_box (col); \n"
+"  } \n"
+"  else \n"
+"#endif \n"
+" \n"
+"  // rectangle background \n"
+"  // --------------------------------------------------------------------------- \n"
+"  if (instance_type == INSTANCE_RECT_BG) { \n"
+"    float rx, ry; \n"
+" \n"
+"    // consider type of background \n"
+" \n"
+"#if defined (WITH_GRADIENTS) \n"
+"    // linear gradient \n"
+"    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD) \n"
+"      col = apply_linear_gradient (col, s, t); \n"
+"#endif \n"
+" \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    // top-left round corner \n"
+"    if (br[0].x * br[0].y > 0.0) { \n"
+"        rx = br[0].x * norm.x; \n"
+"        ry = br[0].y * norm.y; \n"
+"        if (draw_round_corner (col, s, t, rx, ry)) \n"
+"          return; \n"
+"      } \n"
+" \n"
+"    // top-right round corner \n"
+"    if (br[1].x * br[1].y > 0.0) { \n"
+"        rx = br[1].x * norm.x; \n"
+"        ry = br[1].y * norm.y; \n"
+"        if (draw_round_corner (col, 1.0 - s, t, rx, ry)) \n"
+"          return; \n"
+"    } \n"
+" \n"
+"    // bottom-left round corner \n"
+"    if (br[2].x * br[2].y > 0.0) { \n"
+"        rx = br[2].x * norm.x; \n"
+"        ry = br[2].y * norm.y; \n"
+"        if (draw_round_corner (col, s, 1.0 - t, rx, ry)) \n"
+"          return; \n"
+"      } \n"
+" \n"
+"    // bottom-right round corner \n"
+"    if (br[3].x * br[3].y > 0.0) { \n"
+"        rx = br[3].x * norm.x; \n"
+"        ry = br[3].y * norm.y; \n"
+"        if (draw_round_corner (col, 1.0 - s, 1.0 - t, rx, ry)) \n"
+"          return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    col = apply_vertical_aa (s, col); \n"
+"    col = apply_horiz_aa (t, col); \n"
+"  } \n"
+" \n"
+"  // solid border left or right \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_LEFT || instance_type == INSTANCE_BORDER_RIGHT) { \n"
+"    col = apply_vertical_aa (s, col); \n"
+"  } \n"
+" \n"
+"  // solid border top or bottom \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP || instance_type == INSTANCE_BORDER_BOTTOM) { \n"
+"    col = apply_horiz_aa (t, col); \n"
+"  } \n"
+" \n"
+"  // top-left solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP_LEFT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[0].x > 0.0 && br[0].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[0].x * norm.x, br[0].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[0] - br[0].x) * norm.x, 0.0), \n"
+"                              min ((bw[1] - br[0].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[0].y, bw[1]) / max (br[0].x, bw[0]); \n"
+"      if (draw_border_corner (col, s, t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s < aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * s; \n"
+"    if (t < aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * t; \n"
+"  } \n"
+" \n"
+"  // top-right solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_TOP_RIGHT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[1].x > 0.0 && br[1].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[1].x * norm.x, br[1].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[2] - br[1].x) * norm.x, 0.0), \n"
+"                              min ((bw[1] - br[1].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[1].y, bw[1]) / max (br[1].x, bw[2]); \n"
+"      if (draw_border_corner (col, 1.0 - s, t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s > 1.0 - aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+"    if (t < aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * t; \n"
+"  } \n"
+" \n"
+"  // bottom-right solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_BOTTOM_RIGHT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[2].x > 0.0 && br[2].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[2].x * norm.x, br[2].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[2] - br[2].x) * norm.x, 0.0), \n"
+"                              min ((bw[3] - br[2].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[2].y, bw[2]) / max (br[2].x, bw[3]); \n"
+"      if (draw_border_corner (col, 1.0 - s, 1.0 - t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s > 1.0 - aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * (1.0 - s); \n"
+"    if (t > 1.0 - aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+"  } \n"
+" \n"
+"  // bottom-left solid border corner \n"
+"  // --------------------------------------------------------------------------- \n"
+"  else if (instance_type == INSTANCE_BORDER_BOTTOM_LEFT) { \n"
+"#if defined (WITH_ROUND_CORNERS) \n"
+"    if (br[3].x > 0.0 && br[3].y > 0.0) { \n"
+"      vec2 outer_radi = vec2 (br[3].x * norm.x, br[3].y * norm.y); \n"
+"      vec2 inner_radi = vec2 (min ((bw[0] - br[3].x) * norm.x, 0.0), \n"
+"                              min ((bw[3] - br[3].y) * norm.y, 0.0)); \n"
+"      float ar = max (br[3].y, bw[0]) / max (br[3].x, bw[3]); \n"
+"      if (draw_border_corner (col, s, 1.0 - t, ar, outer_radi, inner_radi)) \n"
+"        return; \n"
+"    } \n"
+"#endif \n"
+" \n"
+"    if (s < aa_size.s) \n"
+"      col.a *= (1.0/aa_size.s) * s; \n"
+"    if (t > 1.0 - aa_size.t) \n"
+"      col.a *= (1.0/aa_size.t) * (1.0 - t); \n"
+"  } \n"
+"#endif \n"
+" \n"
+"  my_FragColor = col; \n"
+"} \n"
+" \n"
+"void \n"
+"main () \n"
+"{ \n"
+"  float clip = clip_coverage (); \n"
+" \n"
+"  if (clip == 0.0) \n"
+"    discard; \n"
+" \n"
+"  draw_instance (); \n"
+" \n"
+"  my_FragColor.a *= clip * instance_opacity; \n"
+"} \n"
+;
+
+const char *INSTANCED_VERTEX_SHADER_SRC =
+"#version 300 es \n"
+" \n"
+"precision highp float; \n"
+" \n"
+"const uint MASK_8_BIT = uint (0x000000FF); \n"
+" \n"
+"const float PI = 3.14159265359; \n"
+" \n"
+"const vec2 RECT_VERTICES[4] = vec2[4] ( \n"
+"  vec2 (0.0, 0.0), \n"
+"  vec2 (1.0, 0.0), \n"
+"  vec2 (1.0, 1.0), \n"
+"  vec2 (0.0, 1.0) \n"
+"); \n"
+" \n"
+"const uint INSTANCE_CHAR_GLYPH   = uint (9); \n"
+"const uint INSTANCE_BOX          = uint (10); \n"
+"const uint INSTANCE_RECT_ALIGNED = uint (11); \n"
+" \n"
+"const uint TRANSFORM_OFFSET_MASK = uint (0x000FFFFF); \n"
+"const uint TRANSFORM_AFFINE_2D   = uint (0x00800000); \n"
+"const uint CLIP                  = uint (0x00400000); \n"
+"const uint CLIP_ONLY             = uint (0x00200000); \n"
+"const uint ANIMATION             = uint (0x00100000); \n"
+" \n"
+"const uint ANIMATION_ALTERNATE   = uint (1); \n"
+"const uint ANIMATION_EASE_IN_OUT = uint (2); \n"
+" \n"
+"const int BACKGROUND_TYPE_NONE         = 0; \n"
+"const int BACKGROUND_TYPE_SOLID_COLOR  = 1; \n"
+"const int BACKGROUND_TYPE_IMAGE        = 2; \n"
+"const int BACKGROUND_TYPE_LINEAR_GRAD  = 3; \n"
+"const int BACKGROUND_TYPE_RADIAL_GRAD  = 4; \n"
+" \n"
+"layout (location = 0) in vec4  lyt_attr; \n"
+"layout (location = 1) in vec4  color_attr; \n"
+"layout (location = 2) in uvec4 config_attr; \n"
+" \n"
+"     out vec4  color; \n"
+"     out vec2  tex_coords; \n"
+"     out float edge; \n"
+"flat out vec2  aa_size; \n"
+"flat out float aspect_ratio; \n"
+"flat out vec2  norm; \n"
+" \n"
+"flat out uint  instance_type; \n"
+" \n"
+"flat out vec4  area_in_tex; \n"
+"flat out int   tex_id; \n"
+" \n"
+"flat out ivec4 border_style; \n"
+"flat out vec4  border_width; \n"
+"flat out vec2  border_radius[4]; \n"
+"flat out uvec4 border_color; \n"
+" \n"
+"flat out int   background_type; \n"
+" \n"
+"     out vec2  box_pos; \n"
+"flat out vec2  box_half_size; \n"
+"flat out vec4  box_border_width; \n"
+"flat out vec4  box_radii; \n"
+"flat out vec4  box_border_color; \n"
+" \n"
+"     out vec2  clip_pos; \n"
+"flat out vec2  clip_half_size; \n"
+"flat out vec4  clip_radii; \n"
+" \n"
+"flat out float instance_opacity; \n"
+" \n"
+"flat out vec4  linear_grad_colors[2]; \n"
+"flat out float linear_grad_steps[4]; \n"
+"flat out float linear_grad_angle; \n"
+"flat out float linear_grad_gamma; \n"
+"flat out float linear_grad_length; \n"
+" \n"
+"// the canvas' global transform, projection and perspective, multiplied \n"
+"uniform mat4  view_matrix; \n"
+"uniform float aa_offset; \n"
+" \n"
+"// the opaque pass draws only the inner area of opaque instances, and \n"
+"// culls everything else \n"
+"uniform bool opaque_pass; \n"
+" \n"
+"// instances take consecutive depth values starting at 'depth_base', nearer \n"
+"// as they are drawn later. Must match GLR_BATCH_DEPTH_SLOTS in glr-batch.h \n"
+"uniform uint depth_base; \n"
+"const float DEPTH_STEP = 1.0 / 4194304.0; \n"
+" \n"
+"// a position outside the clip volume, to skip an instance \n"
+"const vec4 CULLED_POSITION = vec4 (2.0, 2.0, 2.0, 1.0); \n"
+" \n"
+"// what animations are evaluated at, in seconds \n"
+"uniform float time; \n"
+" \n"
+"// the offset of each scroll node, the first one being zero. Must match \n"
+"// GLR_PROGRAM_NUM_SCROLL_NODES in glr-program.h \n"
+"uniform vec2 scroll_offsets[16]; \n"
+" \n"
+"// whether instances come in the compact format \n"
+"uniform bool compact_instances; \n"
+"const float COMPACT_LAYOUT_SUBPIXELS = 8.0; \n"
+" \n"
+"// the dyn attrs texture has a fixed width, but its height grows with \n"
+"// the amount of data stored in it \n"
+"const uint DYN_ATTRS_TEX_WIDTH  = uint (1024); \n"
+"uniform highp sampler2D dyn_attrs_tex; \n"
+" \n"
+"vec4 \n"
+"get_dyn_attrs_sample (uint offset) \n"
+"{ \n"
+"  // 1 is offset 0, 2 is offset 1, and so on \n"
+"  offset = offset - uint (1); \n"
+" \n"
+"  uint column = offset % DYN_ATTRS_TEX_WIDTH; \n"
+"  uint row = offset / DYN_ATTRS_TEX_WIDTH; \n"
+" \n"
+"  return texelFetch (dyn_attrs_tex, ivec2 (column, row), 0); \n"
+"} \n"
+" \n"
+"// how far an animation is at 'time', from 0.0 to 1.0. 'timing' holds its \n"
+"// start time, duration, iterations and flags \n"
+"float \n"
+"animation_progress (vec4 timing) \n"
+"{ \n"
+"  float iterations = timing.z; \n"
+"  float p = max (time - timing.x, 0.0) / max (timing.y, 0.0001); \n"
+"  uint flags = uint (timing.w); \n"
+" \n"
+"  // it holds the last value reached once done \n"
+"  float cycle = floor (p); \n"
+"  float f = p - cycle; \n"
+"  if (iterations > 0.0 && p >= iterations) { \n"
+"    cycle = ceil (iterations) - 1.0; \n"
+"    f = iterations - cycle; \n"
+"  } \n"
+" \n"
+"  if ((flags & ANIMATION_ALTERNATE) != uint (0) && mod (cycle, 2.0) == 1.0) \n"
+"    f = 1.0 - f; \n"
+" \n"
+"  if ((flags & ANIMATION_EASE_IN_OUT) != uint (0)) \n"
+"    f = smoothstep (0.0, 1.0, f); \n"
+" \n"
+"  return f; \n"
+"} \n"
+" \n"
+"vec4 \n"
+"color_from_uint (uint color) \n"
+"{ \n"
+"  return vec4 (float ( color >> 24)               / 255.0, \n"
+"               float ((color >> 16) & MASK_8_BIT) / 255.0, \n"
+"               float ((color >>  8) & MASK_8_BIT) / 255.0, \n"
+"               float ( color        & MASK_8_BIT) / 255.0); \n"
+"} \n"
+" \n"
+"void \n"
+"main () \n"
+"{ \n"
+"  vec4 pos; \n"
+"  tex_coords = RECT_VERTICES[gl_VertexID]; \n"
+"  float scale_x = 1.0; \n"
+"  float scale_y = 1.0; \n"
+" \n"
+"  // unpack the instance, if it comes in the compact format \n"
+"  // --------------------------------------------------------------------------- \n"
+"  vec4 lyt; \n"
+"  uvec4 config; \n"
+" \n"
+"  if (compact_instances) { \n"
+"    // the layout is given in 1/8 of a pixel, and the config is packed in a \n"
+"    // single word: bits 28 to 31 encode the instance type, and bits 0 to 27 \n"
+"    // the offset of a style entry holding the rest of config0 and config1 \n"
+"    // to config3, if any \n"
+"    lyt = lyt_attr / COMPACT_LAYOUT_SUBPIXELS; \n"
+" \n"
+"    uint style_offset = config_attr[0] & uint (0x0FFFFFFF); \n"
+"    if (style_offset > uint (0)) \n"
+"      config = uvec4 (get_dyn_attrs_sample (style_offset)); \n"
+"    else \n"
+"      config = uvec4 (0); \n"
+" \n"
+"    config[0] |= (config_attr[0] >> 28) << 26; \n"
+"  } \n"
+"  else { \n"
+"    lyt = lyt_attr; \n"
+"    config = config_attr; \n"
+"  } \n"
+" \n"
+"  // load config, which is encoded in 4 uint32 words (config[0] to config[3]) \n"
+"  // --------------------------------------------------------------------------- \n"
+" \n"
+"  // bits 30 to 31 (2 bits) of config0 are reserved, and must be zero \n"
+" \n"
+"  // bits 26 to 29 (4 bits) of config0 encode the instance type \n"
+"  instance_type = (config[0] >> 26) & uint (0x0F); \n"
+" \n"
+"  // bits 20 to 23 (4 bits) of config0 encode the number of samples to describe \n"
+"  // the border \n"
+"  uint border_num_samples = (config[0] >> 20) & uint (0x0F); \n"
+" \n"
+"  // bits 16 to 19 (4 bits) of config0 encode the number of samples to describe \n"
+"  // the background \n"
+"  uint background_num_samples = (config[0] >> 16) & uint (0x0F); \n"
+" \n"
+"  // in the opaque pass, leave the anti-aliased edges out, the translucent \n"
+"  // pass blends them in later. Pixel-aligned rects have none \n"
+"  if (opaque_pass && instance_type != INSTANCE_RECT_ALIGNED) { \n"
+"    vec2 inset = vec2 (aa_offset) / abs (lyt.zw); \n"
+" \n"
+"    if (inset.x >= 0.5 || inset.y >= 0.5) { \n"
+"      gl_Position = CULLED_POSITION; \n"
+"      return; \n"
+"    } \n"
+" \n"
+"    tex_coords = mix (inset, vec2 (1.0) - inset, tex_coords); \n"
+"  } \n"
+" \n"
+"  // load instance's layout \n"
+"  // --------------------------------------------------------------------------- \n"
+"  pos = vec4 (lyt.x + lyt.z * tex_coords.x, \n"
+"              lyt.y + lyt.w * tex_coords.y, \n"
+"              0.0, 1.0); \n"
+" \n"
+"  // load clip, if any \n"
+"  // --------------------------------------------------------------------------- \n"
+"  // if bit 22 of config1 is set, the offset in it points to a 2-sample clip: \n"
+"  // its left, top, right and bottom, and its corner radii. The transform \n"
+"  // follows, unless bit 21 is set too \n"
+"  uint transform_offset = config[1] & TRANSFORM_OFFSET_MASK; \n"
+"  vec2 clip_center = vec2 (0.0); \n"
+" \n"
+"  clip_half_size = vec2 (-1.0); \n"
+"  clip_radii = vec4 (0.0); \n"
+"  if ((config[1] & CLIP) != uint (0)) { \n"
+"    vec4 clip = get_dyn_attrs_sample (transform_offset); \n"
+" \n"
+"    clip_radii = get_dyn_attrs_sample (transform_offset + uint (1)); \n"
+"    clip_center = (clip.xy + clip.zw) / 2.0; \n"
+"    clip_half_size = (clip.zw - clip.xy) / 2.0; \n"
+" \n"
+"    // its edges are anti-aliased, so nothing clipped is opaque \n"
+"    if (opaque_pass) { \n"
+"      gl_Position = CULLED_POSITION; \n"
+"      return; \n"
+"    } \n"
+" \n"
+"    if ((config[1] & CLIP_ONLY) != uint (0)) \n"
+"      transform_offset = uint (0); \n"
+"    else \n"
+"      transform_offset += uint (2); \n"
+"  } \n"
+" \n"
+"  // load and apply animation, if any \n"
+"  // --------------------------------------------------------------------------- \n"
+"  // if bit 20 of config1 is set, a 5-sample animation comes next: its \n"
+"  // timing, the rotation and opacity, the scale and the translation it goes \n"
+"  // from and to, and its origin. The transform follows if its third \n"
+"  // component is set. It applies before the transform \n"
+"  instance_opacity = 1.0; \n"
+"  if ((config[1] & ANIMATION) != uint (0)) { \n"
+"    float f = animation_progress (get_dyn_attrs_sample (transform_offset)); \n"
+"    vec4 rotate_opacity = get_dyn_attrs_sample (transform_offset + uint (1)); \n"
+"    vec4 scale = get_dyn_attrs_sample (transform_offset + uint (2)); \n"
+"    vec4 translate = get_dyn_attrs_sample (transform_offset + uint (3)); \n"
+"    vec4 origin = get_dyn_attrs_sample (transform_offset + uint (4)); \n"
+" \n"
+"    float angle = mix (rotate_opacity.x, rotate_opacity.y, f); \n"
+"    mat2 rotation = mat2 (cos (angle), sin (angle), -sin (angle), cos (angle)); \n"
+" \n"
+"    pos.xy = origin.xy \n"
+"      + rotation * (mix (scale.xy, scale.zw, f) * (pos.xy - origin.xy)) \n"
+"      + mix (translate.xy, translate.zw, f); \n"
+"    instance_opacity = mix (rotate_opacity.z, rotate_opacity.w, f); \n"
+" \n"
+"    if (opaque_pass && instance_opacity < 1.0) { \n"
+"      gl_Position = CULLED_POSITION; \n"
+"      return; \n"
+"    } \n"
+" \n"
+"    if (origin.z > 0.0) \n"
+"      transform_offset += uint (5); \n"
+"    else \n"
+"      transform_offset = uint (0); \n"
+"  } \n"
+" \n"
+"  // load and apply linear transformation, if any \n"
+"  // --------------------------------------------------------------------------- \n"
+"  // bits 0 to 19 of config1 encode the offset of the transformation. If bit \n"
+"  // 23 is set, it is a 2D affine transform given as a 2-sample dynamic \n"
+"  // attribute: the 2x2 linear part and the translation. Otherwise it is a \n"
+"  // 4-sample matrix. Translations alone are already applied to the layout \n"
+"  if (transform_offset > uint (0)) { \n"
+"    if ((config[1] & TRANSFORM_AFFINE_2D) != uint (0)) { \n"
+"      vec4 linear = get_dyn_attrs_sample (transform_offset); \n"
+"      vec4 translation = get_dyn_attrs_sample (transform_offset + uint (1)); \n"
+" \n"
+"      pos.xy = mat2 (linear.xy, linear.zw) * pos.xy + translation.xy; \n"
+"    } \n"
+"    else { \n"
+"      mat4 transform_matrix = mat4 ( \n"
+"        get_dyn_attrs_sample (transform_offset), \n"
+"        get_dyn_attrs_sample (transform_offset + uint (1)), \n"
+"        get_dyn_attrs_sample (transform_offset + uint (2)), \n"
+"        get_dyn_attrs_sample (transform_offset + uint (3)) \n"
+"      ); \n"
+"      pos = transform_matrix * pos; \n"
+"    } \n"
+"  } \n"
+" \n"
+"  // move with the scroll node, if any \n"
+"  // --------------------------------------------------------------------------- \n"
+"  // bits 8 to 11 of config0 encode the scroll node of the instance. It \n"
+"  // moves in canvas coordinates, while its clip stays in place \n"
+"  uint scroll_node = (config[0] >> 8) & uint (0x0F); \n"
+"  pos.xy += scroll_offsets[scroll_node] * pos.w; \n"
+" \n"
+"  // the clip is in canvas coordinates, as the position is at this point \n"
+"  clip_pos = pos.xy - clip_center; \n"
+" \n"
+"  // apply global transformation, projection and perspective \n"
+"  // --------------------------------------------------------------------------- \n"
+"  pos = view_matrix * pos; \n"
+" \n"
+"  gl_Position = pos; \n"
+" \n"
+"  // load color \n"
+"  // --------------------------------------------------------------------------- \n"
+"  color = vec4 (color_attr.a, color_attr.b, color_attr.g, color_attr.r); \n"
+"  color = mix (vec4 (color.rgb, 0.0), color, 2.00 - gl_Position.z); \n"
+" \n"
+"  if (opaque_pass && color.a < 1.0) { \n"
+"    gl_Position = CULLED_POSITION; \n"
+"    return; \n"
+"  } \n"
+" \n"
+"  // depth from the drawing order, so later instances hide earlier ones \n"
+"  // --------------------------------------------------------------------------- \n"
+"  float depth_slot = float (depth_base + uint (gl_InstanceID)) + 1.0; \n"
+"  gl_Position.z = (1.0 - 2.0 * DEPTH_STEP * depth_slot) * gl_Position.w; \n"
+" \n"
+"  // character glyph \n"
+"  if (instance_type == uint (INSTANCE_CHAR_GLYPH)) { \n"
+"    uint tex_area_offset = config[2]; \n"
+"    area_in_tex = vec4 (get_dyn_attrs_sample (tex_area_offset)); \n"
+" \n"
+"    // bits 12 to 15 (4 bits) of config0 encode the texture unit to use, \n"
+"    // either for glyphs, background-image or border-image \n"
+"    tex_id = int (config[0] >> 12) & 0x0F; \n"
+"  } \n"
+" \n"
+"  else { \n"
+"    // load box \n"
+"    // --------------------------------------------------------------------------- \n"
+" \n"
+"    // a box is a 3-sample dynamic attribute whose offset is encoded in \n"
+"    // config2: the border widths, the corner radii and the border color. \n"
+"    // Its fragments are positioned relative to its center, in pixels \n"
+"    if (instance_type == INSTANCE_BOX) { \n"
+"      uint box_offset = config[2]; \n"
+" \n"
+"      box_border_width = get_dyn_attrs_sample (box_offset); \n"
+"      box_radii = get_dyn_attrs_sample (box_offset + uint (1)); \n"
+"      box_border_color = get_dyn_attrs_sample (box_offset + uint (2)); \n"
+" \n"
+"      box_half_size = (abs (lyt.zw) - vec2 (aa_offset)) / 2.0; \n"
+"      box_pos = (tex_coords - vec2 (0.5)) * abs (lyt.zw); \n"
+"    } \n"
+" \n"
+"    // load border \n"
+"    // --------------------------------------------------------------------------- \n"
+" \n"
+"    // no borders \n"
+"    if (border_num_samples == uint (0)) { \n"
+"      border_width = vec4 (0.0); \n"
+"      border_radius = vec2[4] (vec2 (0.0), vec2 (0.0), vec2 (0.0), vec2 (0.0)); \n"
+"    } \n"
+"    // simplest case: width, radius and color of all borders are equal \n"
+"    else if (border_num_samples == uint (1)) { \n"
+"      uint border_offset = config[2]; \n"
+"      vec4 border = get_dyn_attrs_sample (border_offset); \n"
+" \n"
+"      border_style = ivec4 (int (border[0]), \n"
+"                            int (border[0]), \n"
+"                            int (border[0]), \n"
+"                            int (border[0])); \n"
+"      border_width = vec4 (border[1] * scale_x, \n"
+"                           border[1] * scale_y, \n"
+"                           border[1] * scale_x, \n"
+"                           border[1] * scale_y); \n"
+"      border_radius[0] = \n"
+"        border_radius[1] = \n"
+"        border_radius[2] = \n"
+"        border_radius[3] = vec2 (border[2] * scale_x, border[2] * scale_y); \n"
+" \n"
+"      border_color = uvec4 (uint (border[3]), \n"
+"                            uint (border[3]), \n"
+"                            uint (border[3]), \n"
+"                            uint (border[3])); \n"
+"    } \n"
+"    else { \n"
+"      // @TODO: other cases not yet implemented \n"
+"    } \n"
+" \n"
+"    // load background \n"
+"    // --------------------------------------------------------------------------- \n"
+"    if (background_num_samples == uint (3)) \n"
+"      { \n"
+"        // linear gradient \n"
+"        uint bg_offset = config[3]; \n"
+"        vec4 bg = get_dyn_attrs_sample (bg_offset); \n"
+" \n"
+"        background_type = BACKGROUND_TYPE_LINEAR_GRAD; \n"
+"        linear_grad_angle = bg[0]; \n"
+"        linear_grad_length = bg[1]; \n"
+"        linear_grad_gamma = bg[2]; \n"
+" \n"
+"        linear_grad_colors = vec4[2] (get_dyn_attrs_sample (bg_offset + uint(1)), \n"
+"                                      get_dyn_attrs_sample (bg_offset + uint(2))); \n"
+"      } \n"
+"    else \n"
+"      { \n"
+"        // @TODO: other cases not yet implemented, assume solid color \n"
+"        background_type = BACKGROUND_TYPE_SOLID_COLOR; \n"
+"      } \n"
+" \n"
+"    // @FIXME: we need actual values for scale_x and scale_y \n"
+"    norm.x = 1.0 / abs (lyt.z * scale_x); \n"
+"    norm.y = 1.0 / abs (lyt.w * scale_y); \n"
+"    aa_size = vec2 (aa_offset * norm.x, aa_offset * norm.y); \n"
+"  } \n"
+"} \n"
+;
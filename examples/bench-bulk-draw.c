@@ -0,0 +1,258 @@
+#include <glib.h>
+#include <stdio.h>
+#include <sys/time.h>
+
+#include "../glr.h"
+#include "utils.h"
+
+/* Compares encoding many rects and glyphs one call at a time against the
+   bulk draw functions, pixel-aligned rects against unaligned ones, and
+   encoding the rects on a single thread against splitting them over
+   NUM_RECORDERS threads. Times are averaged over NUM_ROUNDS frames, split
+   in what the draw calls take on the CPU and what flushing the frame
+   takes. */
+
+#define WINDOW_WIDTH  1920
+#define WINDOW_HEIGHT 1080
+
+#define FONT_FILE  (FONTS_DIR "DejaVuSansMono-Bold.ttf")
+#define FONT_SIZE  10
+
+#define NUM_RECTS  100000
+#define NUM_GLYPHS  50000
+#define NUM_ROUNDS     20
+
+#define GRID_COLUMNS 320
+
+#define NUM_RECORDERS 8
+
+static GlrContext *context = NULL;
+static GlrTarget *target = NULL;
+static GlrCanvas *canvas = NULL;
+
+static float rect_positions[NUM_RECTS * 2];
+static float rect_positions_unaligned[NUM_RECTS * 2];
+static float rect_sizes[NUM_RECTS * 2];
+static GlrColor rect_colors[NUM_RECTS];
+
+static uint32_t glyph_ids[NUM_GLYPHS];
+static float glyph_positions[NUM_GLYPHS * 2];
+
+static GlrFont font = { FONT_FILE, 0, FONT_SIZE };
+
+static GlrRecorder *recorders[NUM_RECORDERS];
+
+typedef void (* DrawFunc) (void);
+
+static double
+get_time (void)
+{
+  struct timeval t;
+
+  gettimeofday (&t, NULL);
+
+  return t.tv_sec + t.tv_usec * 1e-6;
+}
+
+static void
+prepare_data (void)
+{
+  int i;
+
+  for (i = 0; i < NUM_RECTS; i++)
+    {
+      rect_positions[i * 2] = (i % GRID_COLUMNS) * 6.0;
+      rect_positions[i * 2 + 1] = (i / GRID_COLUMNS) * 3.0;
+      rect_positions_unaligned[i * 2] = rect_positions[i * 2] + 0.5;
+      rect_positions_unaligned[i * 2 + 1] = rect_positions[i * 2 + 1] + 0.5;
+      rect_sizes[i * 2] = 5.0;
+      rect_sizes[i * 2 + 1] = 2.0;
+      rect_colors[i] = glr_color_from_hue (i, 255);
+    }
+
+  // any glyph index of the font will do
+  for (i = 0; i < NUM_GLYPHS; i++)
+    {
+      glyph_ids[i] = 36 + i % 52;
+      glyph_positions[i * 2] = (i % GRID_COLUMNS) * 6.0;
+      glyph_positions[i * 2 + 1] = 12.0 + (i / GRID_COLUMNS) * 6.0;
+    }
+}
+
+static void
+draw_rects_per_call (void)
+{
+  GlrStyle style = GLR_STYLE_DEFAULT;
+  int i;
+
+  for (i = 0; i < NUM_RECTS; i++)
+    {
+      glr_background_set_color (&(style.background), rect_colors[i]);
+      glr_canvas_draw_rect (canvas,
+                            rect_positions[i * 2], rect_positions[i * 2 + 1],
+                            rect_sizes[i * 2], rect_sizes[i * 2 + 1],
+                            &style);
+    }
+}
+
+static void
+draw_rects_bulk (void)
+{
+  GlrStyle style = GLR_STYLE_DEFAULT;
+
+  glr_background_set_color (&(style.background), 0);
+  glr_canvas_draw_rects (canvas,
+                         NUM_RECTS,
+                         rect_positions,
+                         rect_sizes,
+                         rect_colors,
+                         &style);
+}
+
+/* same as above, but off the pixel grid so every rect is anti-aliased */
+static void
+draw_rects_bulk_unaligned (void)
+{
+  GlrStyle style = GLR_STYLE_DEFAULT;
+
+  glr_background_set_color (&(style.background), 0);
+  glr_canvas_draw_rects (canvas,
+                         NUM_RECTS,
+                         rect_positions_unaligned,
+                         rect_sizes,
+                         rect_colors,
+                         &style);
+}
+
+/* draws a share of the rects into the recorder of the same index. The
+   previous frame was flushed already, so it can be reset */
+static gpointer
+record_rects (gpointer data)
+{
+  size_t index = GPOINTER_TO_SIZE (data);
+  size_t first = NUM_RECTS * index / NUM_RECORDERS;
+  size_t last = NUM_RECTS * (index + 1) / NUM_RECORDERS;
+  GlrStyle style = GLR_STYLE_DEFAULT;
+
+  glr_recorder_reset (recorders[index]);
+
+  glr_background_set_color (&(style.background), 0);
+  glr_canvas_draw_rects (glr_recorder_get_canvas (recorders[index]),
+                         last - first,
+                         rect_positions + first * 2,
+                         rect_sizes + first * 2,
+                         rect_colors + first,
+                         &style);
+
+  return NULL;
+}
+
+static void
+draw_rects_recorders (void)
+{
+  GThread *threads[NUM_RECORDERS];
+  size_t i;
+
+  for (i = 0; i < NUM_RECORDERS; i++)
+    threads[i] = g_thread_new ("recorder", record_rects, GSIZE_TO_POINTER (i));
+
+  for (i = 0; i < NUM_RECORDERS; i++)
+    g_thread_join (threads[i]);
+
+  glr_canvas_draw_recorders (canvas, NUM_RECORDERS, recorders);
+}
+
+static void
+draw_glyphs_per_call (void)
+{
+  int i;
+
+  for (i = 0; i < NUM_GLYPHS; i++)
+    glr_canvas_draw_char (canvas,
+                          glyph_ids[i],
+                          glyph_positions[i * 2], glyph_positions[i * 2 + 1],
+                          &font,
+                          glr_color_from_rgba (0, 0, 0, 255));
+}
+
+static void
+draw_glyphs_bulk (void)
+{
+  glr_canvas_draw_glyph_run (canvas,
+                             NUM_GLYPHS,
+                             glyph_ids,
+                             glyph_positions,
+                             &font,
+                             glr_color_from_rgba (0, 0, 0, 255));
+}
+
+static void
+run (const char *name, DrawFunc draw_func)
+{
+  double draw_time = 0.0;
+  double flush_time = 0.0;
+  int i;
+
+  // the first round warms up the glyph cache and the batches
+  for (i = 0; i <= NUM_ROUNDS; i++)
+    {
+      double t1, t2, t3;
+
+      glr_canvas_clear (canvas, glr_color_from_rgba (255, 255, 255, 255));
+
+      t1 = get_time ();
+      draw_func ();
+      t2 = get_time ();
+      glr_canvas_flush (canvas);
+      glFinish ();
+      t3 = get_time ();
+
+      if (i == 0)
+        continue;
+
+      draw_time += t2 - t1;
+      flush_time += t3 - t2;
+    }
+
+  printf ("%-20s draw: %8.3f ms  flush: %8.3f ms\n",
+          name,
+          draw_time / NUM_ROUNDS * 1000.0,
+          flush_time / NUM_ROUNDS * 1000.0);
+}
+
+int
+main (int argc, char* argv[])
+{
+  int i;
+
+  /* init windowing system */
+  utils_initialize_egl (WINDOW_WIDTH, WINDOW_HEIGHT, "Bulk draw benchmark");
+
+  /* init glr */
+  context = glr_context_new ();
+  target = glr_target_new (context, WINDOW_WIDTH, WINDOW_HEIGHT, 0);
+  canvas = glr_canvas_new (context, target);
+
+  for (i = 0; i < NUM_RECORDERS; i++)
+    recorders[i] = glr_recorder_new (context, GLR_CANVAS_FLAGS_NONE);
+
+  prepare_data ();
+
+  run ("rects, per call", draw_rects_per_call);
+  run ("rects, bulk", draw_rects_bulk);
+  run ("rects, unaligned", draw_rects_bulk_unaligned);
+  run ("rects, recorders", draw_rects_recorders);
+  run ("glyphs, per call", draw_glyphs_per_call);
+  run ("glyphs, bulk", draw_glyphs_bulk);
+
+  /* clean up */
+  for (i = 0; i < NUM_RECORDERS; i++)
+    glr_recorder_unref (recorders[i]);
+  glr_canvas_unref (canvas);
+  glr_target_unref (target);
+  glr_context_unref (context);
+
+  utils_finalize_egl ();
+
+  return 0;
+}
@@ -234,7 +234,7 @@ draw_func (uint32_t frame, float _zoom_factor, void *user_data)
                          target_width, target_height,
                          0, window_height - target_height,
                          target_width, window_height,
-                         GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                         GL_COLOR_BUFFER_BIT,
                          GL_NEAREST);
     }
 }
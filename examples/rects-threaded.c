@@ -10,6 +10,9 @@
 
 #define SCALE 80
 
+/* the animations are timed in frames of the original per-frame version */
+#define FRAMES_PER_SECOND 60.0
+
 static GlrContext *context = NULL;
 static GlrTarget *target = NULL;
 static GlrCanvas *canvas = NULL;
@@ -17,37 +20,51 @@ static GlrCanvas *canvas = NULL;
 static uint32_t window_width, window_height;
 static float zoom_factor = 1.0;
 
+/* the rects are recorded once, each with its own animation, and only
+   drawn again every frame. They are recorded again when the size of the
+   target or the zoom change */
+static GlrDisplayList *rects = NULL;
+static uint32_t rects_width, rects_height;
+static float rects_zoom_factor;
+
 static void
-draw_frame (uint32_t frame)
+record_rects (uint32_t width, uint32_t height)
 {
   int i, j;
   int scale = SCALE / 2;
-  uint32_t width, height;
 
-  glr_target_get_size (target, &width, &height);
-  width *= zoom_factor;
-  height *= zoom_factor;
+  glr_canvas_begin_display_list (canvas);
 
   for (i = 0; i < scale; i++)
     for (j = 0; j < scale; j++)
       {
         GlrStyle style = GLR_STYLE_DEFAULT;
+        GlrAnimation animation;
         GlrColor color;
-        float rotation = (frame + i + j) / 10.0;
         uint8_t step = (i * scale + j) % 2;
         uint32_t scaling = step == 0 ? 75 : 60;
-
-        glr_canvas_set_transform_origin (canvas,
-                                         -(width/scale/2.0),
-                                         height/scale/2.0,
-                                         0.0);
-        glr_canvas_rotate (canvas, 0.0, 0.0, rotation);
-        glr_canvas_scale (canvas,
-                          cos ((M_PI/scaling) * ((frame + i + j) % scaling)) + 1,
-                          cos ((M_PI/scaling) * ((frame + i + j) % scaling)) + 1,
-                          1.0);
-
-        color = glr_color_from_hue (frame + i + j + ((i + j %2) * 3), 255);
+        float left = i * width/scale + (step == 1 ? width/scale/2.0 : 0.0);
+        float top = j * height/scale + (step == 1 ? height/scale/2.0 : 0.0);
+
+        // a constant rotation, and a scale from 2 down to 0 every 'scaling'
+        // frames, both starting 'i + j' frames early. They restart together
+        // on each scale cycle, when the rect is at its smallest anyway, and
+        // the easing stands for the cosine the scale used to follow
+        glr_animation_init (&animation,
+                            -(i + j) / FRAMES_PER_SECOND,
+                            scaling / FRAMES_PER_SECOND);
+        animation.iterations = 0.0;
+        animation.timing = GLR_ANIMATION_EASE_IN_OUT;
+        animation.origin[0] = left - width/scale/2.0;
+        animation.origin[1] = top + height/scale/2.0;
+        animation.from.scale[0] = animation.from.scale[1] = 2.0;
+        animation.to.scale[0] = animation.to.scale[1] = 0.0;
+        animation.from.rotate = (i + j) / 10.0;
+        animation.to.rotate = animation.from.rotate + scaling / 10.0;
+
+        glr_canvas_set_animation (canvas, &animation);
+
+        color = glr_color_from_hue (i + j + ((i + j %2) * 3), 255);
         if (step == 0)
           {
             glr_background_set_color (&(style.background), color);
@@ -60,13 +77,43 @@ draw_frame (uint32_t frame)
           }
 
         glr_canvas_draw_rect (canvas,
-                              i * width/scale + (step == 1 ? width/scale/2.0 : 0.0),
-                              j * height/scale + (step == 1 ? height/scale/2.0 : 0.0),
+                              left, top,
                               width/scale/2.0,
                               height/scale/2.0,
                               &style);
       }
 
+  glr_canvas_set_animation (canvas, NULL);
+
+  rects = glr_canvas_end_display_list (canvas);
+  rects_width = width;
+  rects_height = height;
+  rects_zoom_factor = zoom_factor;
+}
+
+static void
+draw_frame (uint32_t frame)
+{
+  uint32_t width, height;
+
+  glr_target_get_size (target, &width, &height);
+  width *= zoom_factor;
+  height *= zoom_factor;
+
+  if (rects == NULL
+      || width != rects_width
+      || height != rects_height
+      || zoom_factor != rects_zoom_factor)
+    {
+      if (rects != NULL)
+        glr_display_list_unref (rects);
+
+      record_rects (width, height);
+    }
+
+  glr_canvas_set_time (canvas, frame / FRAMES_PER_SECOND);
+  glr_canvas_draw_display_list (canvas, rects);
+
   glr_canvas_reset_transform (canvas);
   glr_canvas_rotate (canvas,
                      (M_PI*2.0 / 360.0) * (frame % 360),
@@ -102,7 +149,7 @@ draw_func (uint32_t frame, float _zoom_factor, void *user_data)
                          target_width, target_height,
                          0, window_height - target_height,
                          target_width, window_height,
-                         GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                         GL_COLOR_BUFFER_BIT,
                          GL_NEAREST);
     }
 }
@@ -132,6 +179,8 @@ main (int argc, char *argv[])
   utils_main_loop (draw_func, resize_func, NULL);
 
   /* clean up */
+  if (rects != NULL)
+    glr_display_list_unref (rects);
   glr_canvas_unref (canvas);
   glr_target_unref (target);
   glr_context_unref (context);
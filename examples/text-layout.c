@@ -126,6 +126,10 @@ static float zoom_factor = 1.0;
 
 static bool need_redraw = true;
 
+/* the text only needs to be laid out again when the zoom changes. Frames
+   in between replay what was recorded then */
+static GlrDisplayList *page = NULL;
+
 static TextNode *text_node_en = NULL;
 static GlrFont font_en = {0};
 
@@ -279,19 +283,20 @@ draw_func (uint32_t frame, float _zoom_factor, void *user_data)
                                     HB_DIRECTION_LTR,
                                     hb_language_from_string ("bg", 2));
 
-      glr_canvas_clear (canvas, glr_color_from_rgba (255, 255, 255, 255));
+      if (page != NULL)
+        glr_display_list_unref (page);
+
       glr_canvas_reset_transform (canvas);
+      glr_canvas_begin_display_list (canvas);
       draw_frame (frame);
+      page = glr_canvas_end_display_list (canvas);
 
       need_redraw = false;
     }
-  else
-    {
-      glClearColor (1.0, 1.0, 1.0, 1.0);
-      glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    }
 
+  glr_canvas_clear (canvas, glr_color_from_rgba (255, 255, 255, 255));
   glr_canvas_reset_transform (canvas);
+  glr_canvas_draw_display_list (canvas, page);
 
   static const uint32_t anim_speed = 360.0;
   static float anim_factor = 0.0;
@@ -343,7 +348,7 @@ draw_func (uint32_t frame, float _zoom_factor, void *user_data)
                          target_width, target_height,
                          0, window_height - target_height,
                          target_width, window_height,
-                         GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT,
+                         GL_COLOR_BUFFER_BIT,
                          GL_NEAREST);
     }
 }
@@ -375,6 +380,8 @@ main (int argc, char* argv[])
   utils_main_loop (draw_func, resize_func, NULL);
 
   /* clean up */
+  if (page != NULL)
+    glr_display_list_unref (page);
   glr_canvas_unref (canvas);
   glr_target_unref (target);
   glr_context_unref (context);
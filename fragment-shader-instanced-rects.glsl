@@ -1,5 +1,21 @@
 #version 300 es
 
+// this shader is built into one program per instance class (see the
+// Makefile), each defining one of GLR_CLASS_SOLID, GLR_CLASS_ROUNDED,
+// GLR_CLASS_GRADIENT or GLR_CLASS_GLYPH. A variant only carries the code
+// its class needs, so instances of different kinds do not share a program
+#if defined (GLR_CLASS_GLYPH)
+#  define WITH_GLYPHS
+#else
+#  define WITH_RECTS
+#  if defined (GLR_CLASS_ROUNDED) || defined (GLR_CLASS_GRADIENT)
+#    define WITH_ROUND_CORNERS
+#  endif
+#  if defined (GLR_CLASS_GRADIENT)
+#    define WITH_GRADIENTS
+#  endif
+#endif
+
 precision highp float;
 
 const float PI = 3.14159265359;
@@ -14,6 +30,8 @@ const uint INSTANCE_BORDER_TOP_RIGHT    = uint (6);
 const uint INSTANCE_BORDER_BOTTOM_LEFT  = uint (7);
 const uint INSTANCE_BORDER_BOTTOM_RIGHT = uint (8);
 const uint INSTANCE_CHAR_GLYPH          = uint (9);
+const uint INSTANCE_BOX                 = uint (10);
+const uint INSTANCE_RECT_ALIGNED        = uint (11);
 
 const int BACKGROUND_TYPE_NONE         = 0;
 const int BACKGROUND_TYPE_SOLID_COLOR  = 1;
@@ -41,6 +59,20 @@ flat in  uvec4 border_color;
 
 flat in  int   background_type;
 
+     in  vec2  box_pos;
+flat in  vec2  box_half_size;
+flat in  vec4  box_border_width;
+flat in  vec4  box_radii;
+flat in  vec4  box_border_color;
+
+     in  vec2  clip_pos;
+flat in  vec2  clip_half_size;
+flat in  vec4  clip_radii;
+
+flat in  float instance_opacity;
+
+uniform float aa_offset;
+
 flat in  vec4  linear_grad_colors[2];
 flat in  float linear_grad_steps[4];
 flat in  float linear_grad_angle;
@@ -132,6 +164,86 @@ draw_border_corner (vec4 col,
   return true;
 }
 
+// signed distance from 'p' to the edge of a box centered at the origin,
+// negative inside. 'radii' round its top-left, top-right, bottom-left and
+// bottom-right corners
+float
+rounded_box_distance (vec2 p, vec2 half_size, vec4 radii)
+{
+  float r;
+
+  if (p.y < 0.0)
+    r = p.x < 0.0 ? radii.x : radii.y;
+  else
+    r = p.x < 0.0 ? radii.z : radii.w;
+
+  vec2 q = abs (p) - half_size + r;
+
+  return min (max (q.x, q.y), 0.0) + length (max (q, 0.0)) - r;
+}
+
+// how much of the fragment is inside the instance's clip, if any
+float
+clip_coverage ()
+{
+  if (clip_half_size.x < 0.0)
+    return 1.0;
+
+  float d = rounded_box_distance (clip_pos, clip_half_size, clip_radii);
+
+  return clamp (0.5 - d / max (aa_offset, 0.001), 0.0, 1.0);
+}
+
+#if defined (WITH_ROUND_CORNERS)
+vec4
+draw_box (vec4 bg)
+{
+  vec4 bw = box_border_width;
+  float aa = max (aa_offset, 0.001);
+
+  // the area inside the border, and its corners
+  vec2 inner_half_size = max (box_half_size - (bw.xy + bw.zw) / 2.0, 0.0);
+  vec2 inner_center = (bw.xy - bw.zw) / 2.0;
+  vec4 inner_radii = max (box_radii - vec4 (max (bw.x, bw.y),
+                                            max (bw.y, bw.z),
+                                            max (bw.w, bw.x),
+                                            max (bw.z, bw.w)),
+                          0.0);
+
+  // away from the border and the inner corners there is only background
+  vec2 d = inner_half_size - abs (box_pos - inner_center);
+  float max_inner_radius = max (max (inner_radii.x, inner_radii.y),
+                                max (inner_radii.z, inner_radii.w));
+  if (min (d.x, d.y) > aa && max (d.x, d.y) > max_inner_radius + aa)
+    return bg;
+
+  float outer = rounded_box_distance (box_pos, box_half_size, box_radii);
+  float coverage = clamp (0.5 - outer / aa, 0.0, 1.0);
+  if (coverage == 0.0)
+    discard;
+
+  float border = 0.0;
+  if (any (greaterThan (bw, vec4 (0.0)))) {
+    float inner = rounded_box_distance (box_pos - inner_center,
+                                        inner_half_size,
+                                        inner_radii);
+    border = clamp (0.5 + inner / aa, 0.0, 1.0);
+  }
+
+  // mix with premultiplied alpha, the background may be transparent
+  vec4 col = mix (vec4 (bg.rgb * bg.a, bg.a),
+                  vec4 (box_border_color.rgb * box_border_color.a,
+                        box_border_color.a),
+                  border);
+  if (col.a > 0.0)
+    col.rgb /= col.a;
+
+  col.a *= coverage;
+
+  return col;
+}
+#endif
+
 vec4
 apply_vertical_aa (float s, vec4 col)
 {
@@ -196,7 +308,7 @@ apply_linear_gradient (vec4 color, float s, float t)
 }
 
 void
-main ()
+draw_instance ()
 {
   vec4 col = color;
 
@@ -206,9 +318,10 @@ main ()
   vec2 br[4] = border_radius;
   vec4 bw = border_width;
 
+#if defined (WITH_GLYPHS)
   // character glyph
   // ---------------------------------------------------------------------------
-  if (instance_type == INSTANCE_CHAR_GLYPH) {
+  {
     float f = 0.0;
     vec4 a;
 
@@ -221,18 +334,43 @@ main ()
 
     col.a *= f;
   }
+#endif
+
+#if defined (WITH_RECTS)
+  // pixel-aligned rects need no anti-aliasing
+  if (instance_type == INSTANCE_RECT_ALIGNED) {
+    my_FragColor = col;
+    return;
+  }
+
+#if defined (WITH_ROUND_CORNERS)
+  // background, border and corners of a rect in a single instance
+  // ---------------------------------------------------------------------------
+  if (instance_type == INSTANCE_BOX) {
+#if defined (WITH_GRADIENTS)
+    if (background_type == BACKGROUND_TYPE_LINEAR_GRAD)
+      col = apply_linear_gradient (col, s, t);
+#endif
+
+    col = draw_box (col);
+  }
+  else
+#endif
 
   // rectangle background
   // ---------------------------------------------------------------------------
-  else if (instance_type == INSTANCE_RECT_BG) {
+  if (instance_type == INSTANCE_RECT_BG) {
     float rx, ry;
 
     // consider type of background
 
+#if defined (WITH_GRADIENTS)
     // linear gradient
     if (background_type == BACKGROUND_TYPE_LINEAR_GRAD)
       col = apply_linear_gradient (col, s, t);
+#endif
 
+#if defined (WITH_ROUND_CORNERS)
     // top-left round corner
     if (br[0].x * br[0].y > 0.0) {
         rx = br[0].x * norm.x;
@@ -264,6 +402,7 @@ main ()
         if (draw_round_corner (col, 1.0 - s, 1.0 - t, rx, ry))
           return;
     }
+#endif
 
     col = apply_vertical_aa (s, col);
     col = apply_horiz_aa (t, col);
@@ -284,6 +423,7 @@ main ()
   // top-left solid border corner
   // ---------------------------------------------------------------------------
   else if (instance_type == INSTANCE_BORDER_TOP_LEFT) {
+#if defined (WITH_ROUND_CORNERS)
     if (br[0].x > 0.0 && br[0].y > 0.0) {
       vec2 outer_radi = vec2 (br[0].x * norm.x, br[0].y * norm.y);
       vec2 inner_radi = vec2 (min ((bw[0] - br[0].x) * norm.x, 0.0),
@@ -292,6 +432,7 @@ main ()
       if (draw_border_corner (col, s, t, ar, outer_radi, inner_radi))
         return;
     }
+#endif
 
     if (s < aa_size.s)
       col.a *= (1.0/aa_size.s) * s;
@@ -302,6 +443,7 @@ main ()
   // top-right solid border corner
   // ---------------------------------------------------------------------------
   else if (instance_type == INSTANCE_BORDER_TOP_RIGHT) {
+#if defined (WITH_ROUND_CORNERS)
     if (br[1].x > 0.0 && br[1].y > 0.0) {
       vec2 outer_radi = vec2 (br[1].x * norm.x, br[1].y * norm.y);
       vec2 inner_radi = vec2 (min ((bw[2] - br[1].x) * norm.x, 0.0),
@@ -310,6 +452,7 @@ main ()
       if (draw_border_corner (col, 1.0 - s, t, ar, outer_radi, inner_radi))
         return;
     }
+#endif
 
     if (s > 1.0 - aa_size.s)
       col.a *= (1.0/aa_size.s) * (1.0 - s);
@@ -320,6 +463,7 @@ main ()
   // bottom-right solid border corner
   // ---------------------------------------------------------------------------
   else if (instance_type == INSTANCE_BORDER_BOTTOM_RIGHT) {
+#if defined (WITH_ROUND_CORNERS)
     if (br[2].x > 0.0 && br[2].y > 0.0) {
       vec2 outer_radi = vec2 (br[2].x * norm.x, br[2].y * norm.y);
       vec2 inner_radi = vec2 (min ((bw[2] - br[2].x) * norm.x, 0.0),
@@ -328,6 +472,7 @@ main ()
       if (draw_border_corner (col, 1.0 - s, 1.0 - t, ar, outer_radi, inner_radi))
         return;
     }
+#endif
 
     if (s > 1.0 - aa_size.s)
       col.a *= (1.0/aa_size.s) * (1.0 - s);
@@ -338,6 +483,7 @@ main ()
   // bottom-left solid border corner
   // ---------------------------------------------------------------------------
   else if (instance_type == INSTANCE_BORDER_BOTTOM_LEFT) {
+#if defined (WITH_ROUND_CORNERS)
     if (br[3].x > 0.0 && br[3].y > 0.0) {
       vec2 outer_radi = vec2 (br[3].x * norm.x, br[3].y * norm.y);
       vec2 inner_radi = vec2 (min ((bw[0] - br[3].x) * norm.x, 0.0),
@@ -346,12 +492,27 @@ main ()
       if (draw_border_corner (col, s, 1.0 - t, ar, outer_radi, inner_radi))
         return;
     }
+#endif
 
     if (s < aa_size.s)
       col.a *= (1.0/aa_size.s) * s;
     if (t > 1.0 - aa_size.t)
       col.a *= (1.0/aa_size.t) * (1.0 - t);
   }
+#endif
 
   my_FragColor = col;
 }
+
+void
+main ()
+{
+  float clip = clip_coverage ();
+
+  if (clip == 0.0)
+    discard;
+
+  draw_instance ();
+
+  my_FragColor.a *= clip * instance_opacity;
+}
@@ -8,33 +8,148 @@
 #define FIXED_ATTRS_BUFFER_INITIAL_SIZE    (8192 *    1) /* 8KB */
 #define FIXED_ATTRS_BUFFER_MAXIMUM_SIZE    (8192 * 1024) /* 8MB */
 
-#define DYN_ATTRS_TEX_WIDTH  1024
-#define DYN_ATTRS_TEX_HEIGHT 1024
+/* the dyn attrs texture starts with a few rows and doubles its height
+   as needed, up to the maximum height */
+#define DYN_ATTRS_TEX_WIDTH          1024
+#define DYN_ATTRS_TEX_INITIAL_HEIGHT    4
+#define DYN_ATTRS_TEX_MAXIMUM_HEIGHT 1024
+#define DYN_ATTRS_TEX_ROW_SIZE        (DYN_ATTRS_TEX_WIDTH * 16)
 #define DYN_ATTRS_BUFFER_INITIAL_SIZE (DYN_ATTRS_TEX_WIDTH  * 1 * 16)
-#define DYN_ATTRS_BUFFER_MAXIMUM_SIZE (DYN_ATTRS_TEX_WIDTH * DYN_ATTRS_TEX_HEIGHT * 16)
+#define DYN_ATTRS_BUFFER_MAXIMUM_SIZE (DYN_ATTRS_TEX_WIDTH * DYN_ATTRS_TEX_MAXIMUM_HEIGHT * 16)
+#define DYN_ATTRS_MAXIMUM_SAMPLES     (DYN_ATTRS_TEX_WIDTH * DYN_ATTRS_TEX_MAXIMUM_HEIGHT)
+
+/* uploads of at least this many samples go through a pixel unpack buffer,
+   so the texture copy can happen asynchronously. Smaller ones are cheaper
+   to hand to the driver directly */
+#define DYN_ATTRS_PBO_MINIMUM_SAMPLES (DYN_ATTRS_TEX_WIDTH * 16)
+
+#define DYN_ATTRS_TEX_UNIT GLR_BATCH_DYN_ATTRS_TEX_UNIT
 
 #define LAYOUT_ATTR 0
 #define COLOR_ATTR  1
 #define CONFIG_ATTR 2
 
+/* number of VBOs the fixed attributes rotate through, one per reset. Only
+   the context's frames in flight are used. A region is only rewritten once
+   the GPU is done reading from it, which is checked with a fence when
+   available, waiting at most this long for it before giving up and
+   orphaning its storage */
+#define FIXED_ATTRS_VBO_RING_SIZE GLR_CONTEXT_MAX_FRAMES_IN_FLIGHT
+#define FIXED_ATTRS_FENCE_TIMEOUT 1000000000 /* 1 second, in nanoseconds */
+
+typedef struct
+{
+  GLuint vbo;
+  size_t size;
+  GLsync fence;
+} VboRegion;
+
+/* instances of each class are written to their own stream, directly into
+   the mapped range of the current region, starting at byte 'map_offset'
+   of the VBO. The VBOs are created on first use.
+   Deferred batches write them to 'staging' instead, which 'map' then
+   points to, and copy the bytes past 'uploaded_size' into the region on
+   upload.
+   Each stream is drawn with its own VAO, whose attribute pointers were
+   last set to byte 'vao_base' of 'vao_vbo' (zero when not set yet) */
+typedef struct
+{
+  VboRegion ring[FIXED_ATTRS_VBO_RING_SIZE];
+  uint32_t current_region;
+  uint8_t *map;
+  size_t map_offset;
+  size_t used_size;
+  size_t num_instances;
+
+  uint8_t *staging;
+  size_t staging_size;
+  size_t uploaded_size;
+
+  GLuint vao;
+  GLuint vao_vbo;
+  size_t vao_base;
+} InstanceStream;
+
+/* a run of consecutive instances of one class, drawn with a single call.
+   A new instance joins the last run of its class when it does not overlap
+   any run added after that one, which keeps the painter's order.
+   Overlapping instances therefore always get increasing depth values when
+   the runs are numbered in order, see glr_batch_draw() */
+typedef struct
+{
+  GlrInstanceClass klass;
+  size_t first;
+  size_t count;
+  size_t num_opaque;
+  bool bounded;
+  float bounds[4]; /* left, top, right, bottom */
+} InstanceRun;
+
+#define INSTANCE_RUNS_INITIAL_SIZE 16
+
+/* how many later runs are checked for overlap before giving up on
+   joining an earlier run */
+#define INSTANCE_RUNS_MAXIMUM_LOOKBACK 32
+
+/* the compact instance format stores the layout in int16 units of 1/8 of
+   a pixel, which covers coordinates within about [-4096, 4096) */
+#define COMPACT_LAYOUT_SUBPIXELS 8
+#define COMPACT_LAYOUT_MAXIMUM   (INT16_MAX / COMPACT_LAYOUT_SUBPIXELS)
+
+/* dyn attr blocks of up to this size (a Mat4) can be interned */
+#define DYN_ATTRS_INTERN_MAXIMUM_SIZE (4 * 16)
+
+typedef struct
+{
+  size_t size;
+  uint8_t data[DYN_ATTRS_INTERN_MAXIMUM_SIZE];
+} DynAttrKey;
+
 struct _GlrBatch
 {
   int ref_count;
 
+  GlrContext *context;
+  const GlrSymbols *gl;
+
+  GlrInstanceFormat instance_format;
+
   size_t num_instances;
 
-  GLuint fixed_attrs_vbo;
-  uint8_t *fixed_attrs_buf;
-  size_t fixed_attrs_vbo_size;
-  size_t fixed_attrs_size;
-  size_t fixed_attrs_used_size;
-  size_t fixed_attrs_uploaded_size;
+  InstanceStream streams[GLR_INSTANCE_NUM_CLASSES];
+  bool use_fences;
+
+  /* set on batches filled without GL calls, see glr_batch_new_deferred() */
+  bool deferred;
+
+  /* times a region was still in use by the GPU when starting over on it,
+     since the last reset */
+  size_t num_fence_waits;
 
+  InstanceRun *runs;
+  size_t runs_size;
+  size_t num_runs;
+  size_t num_opaque_instances;
+
+  /* instances added while set may be moved later, see
+     glr_batch_update_instance(), so nothing is reordered around them */
+  bool movable;
+
+  /* 'dyn_attrs_tex_height' is the height reserved in the context's dyn attrs
+     memory budget, while the texture is only created, and its storage
+     (re)allocated to that height, on upload */
   GLuint dyn_attrs_tex;
+  uint32_t dyn_attrs_tex_height;
+  uint32_t dyn_attrs_tex_allocated_height;
+  GLuint dyn_attrs_pbo;
   uint8_t *dyn_attrs_buffer;
   size_t dyn_attrs_buffer_size;
   size_t dyn_attrs_uploaded_samples;
   size_t dyn_attrs_sample_count;
+
+  /* maps the encoded bytes of interned dyn attr blocks to their offset,
+     so identical descriptions are stored only once per batch */
+  GHashTable *dyn_attrs_intern_table;
 };
 
 typedef struct
@@ -44,14 +159,64 @@ typedef struct
   GlrInstanceConfig config;
 } InstanceAttr;
 
+/* bits 28 to 31 of 'config' encode the instance type, and bits 0 to 27
+   the offset of a style entry (a dyn attr sample) holding the rest of
+   config0 and config1 to config3. Zero means all of them are zero */
+typedef struct
+{
+  int16_t lyt[4];
+  GlrColor color;
+  uint32_t config;
+} CompactInstanceAttr;
+
+static size_t
+instance_size (GlrBatch *self)
+{
+  if (self->instance_format == GLR_INSTANCE_FORMAT_COMPACT)
+    return sizeof (CompactInstanceAttr);
+  else
+    return sizeof (InstanceAttr);
+}
+
 static void
 glr_batch_free (GlrBatch *self)
 {
+  int i;
+
+  g_hash_table_unref (self->dyn_attrs_intern_table);
   free (self->dyn_attrs_buffer);
-  glDeleteTextures (1, &self->dyn_attrs_tex);
+  if (self->dyn_attrs_tex != 0)
+    self->gl->DeleteTextures (1, &self->dyn_attrs_tex);
+  glr_context_release_dyn_attrs_memory (self->context,
+                                        self->dyn_attrs_tex_height
+                                        * DYN_ATTRS_TEX_ROW_SIZE);
+  if (self->dyn_attrs_pbo != 0)
+    self->gl->DeleteBuffers (1, &self->dyn_attrs_pbo);
+
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    {
+      InstanceStream *stream = &self->streams[i];
+      int j;
+
+      free (stream->staging);
+
+      if (stream->vao != 0)
+        self->gl->DeleteVertexArrays (1, &stream->vao);
+
+      for (j = 0; j < FIXED_ATTRS_VBO_RING_SIZE; j++)
+        {
+          VboRegion *region = &stream->ring[j];
+
+          if (region->fence != NULL)
+            self->gl->DeleteSync (region->fence);
+          if (region->vbo != 0)
+            self->gl->DeleteBuffers (1, &region->vbo);
+        }
+    }
 
-  free (self->fixed_attrs_buf);
-  glDeleteBuffers (1, &self->fixed_attrs_vbo);
+  free (self->runs);
+
+  glr_context_unref (self->context);
 
   free (self);
   self = NULL;
@@ -59,32 +224,454 @@ glr_batch_free (GlrBatch *self)
   // g_print ("GlrBatch freed\n");
 }
 
+static void
+unmap_fixed_attrs (GlrBatch *self, InstanceStream *stream)
+{
+  VboRegion *region = &stream->ring[stream->current_region];
+
+  // staged instances stay where they are, see upload_staged_fixed_attrs()
+  if (stream->map == NULL || self->deferred)
+    return;
+
+  self->gl->BindBuffer (GL_ARRAY_BUFFER, region->vbo);
+
+  // only the bytes written since the range was mapped need to be flushed
+  self->gl->FlushMappedBufferRange (GL_ARRAY_BUFFER,
+                                    0,
+                                    stream->used_size - stream->map_offset);
+  if (self->gl->UnmapBuffer (GL_ARRAY_BUFFER) == GL_FALSE)
+    g_warning ("Fixed attributes buffer got corrupted while mapped.");
+
+  stream->map = NULL;
+}
+
+static void
+create_fixed_attrs_buffers (GlrBatch *self, InstanceStream *stream)
+{
+  int i;
+
+  for (i = 0; i < FIXED_ATTRS_VBO_RING_SIZE; i++)
+    {
+      VboRegion *region = &stream->ring[i];
+
+      self->gl->GenBuffers (1, &region->vbo);
+      self->gl->BindBuffer (GL_ARRAY_BUFFER, region->vbo);
+      self->gl->BufferData (GL_ARRAY_BUFFER,
+                            FIXED_ATTRS_BUFFER_INITIAL_SIZE,
+                            NULL,
+                            GL_STREAM_DRAW);
+      region->size = FIXED_ATTRS_BUFFER_INITIAL_SIZE;
+    }
+}
+
+/* starting over on the region bound to GL_ARRAY_BUFFER. If the GPU might
+   still be reading from it, wait for it to be done. Without fences, orphan
+   its storage */
+static void
+start_over_on_region (GlrBatch *self, VboRegion *region)
+{
+  bool busy = true;
+
+  if (region->fence != NULL)
+    {
+      GLenum status = self->gl->ClientWaitSync (region->fence, 0, 0);
+
+      if (status == GL_TIMEOUT_EXPIRED)
+        {
+          self->num_fence_waits++;
+          status = self->gl->ClientWaitSync (region->fence,
+                                             GL_SYNC_FLUSH_COMMANDS_BIT,
+                                             FIXED_ATTRS_FENCE_TIMEOUT);
+        }
+
+      busy = status != GL_ALREADY_SIGNALED
+        && status != GL_CONDITION_SATISFIED;
+
+      self->gl->DeleteSync (region->fence);
+      region->fence = NULL;
+    }
+  else if (self->use_fences)
+    {
+      // the region has never been drawn
+      busy = false;
+    }
+
+  if (busy)
+    self->gl->BufferData (GL_ARRAY_BUFFER,
+                          region->size,
+                          NULL,
+                          GL_STREAM_DRAW);
+}
+
+static void
+map_fixed_attrs (GlrBatch *self, InstanceStream *stream)
+{
+  VboRegion *region = &stream->ring[stream->current_region];
+  GLbitfield flags;
+
+  self->gl->BindBuffer (GL_ARRAY_BUFFER, region->vbo);
+
+  if (stream->used_size == 0)
+    start_over_on_region (self, region);
+
+  // the mapped range is never read by a draw call already in flight, which
+  // only covers bytes before 'used_size'
+  flags = GL_MAP_WRITE_BIT
+    | GL_MAP_INVALIDATE_RANGE_BIT
+    | GL_MAP_FLUSH_EXPLICIT_BIT
+    | GL_MAP_UNSYNCHRONIZED_BIT;
+
+  stream->map_offset = stream->used_size;
+  stream->map = self->gl->MapBufferRange (GL_ARRAY_BUFFER,
+                                          stream->map_offset,
+                                          region->size - stream->map_offset,
+                                          flags);
+}
+
+/* makes room for 'size' bytes of instances in the client memory of a
+   deferred batch's stream */
 static bool
-check_fixed_attrs_buffers_maybe_grow (GlrBatch *self)
+grow_staging (InstanceStream *stream, size_t size)
 {
   size_t new_size;
 
-  new_size = self->fixed_attrs_used_size
-    + (sizeof (GlrLayout) + sizeof (GlrInstanceConfig));
-
-  if (new_size < self->fixed_attrs_size)
+  if (size <= stream->staging_size)
     return true;
 
+  if (size > FIXED_ATTRS_BUFFER_MAXIMUM_SIZE)
+    return false;
+
+  new_size = MAX (stream->staging_size, FIXED_ATTRS_BUFFER_INITIAL_SIZE);
+  while (new_size < size)
+    new_size *= 2;
+  new_size = MIN (new_size, FIXED_ATTRS_BUFFER_MAXIMUM_SIZE);
+
+  stream->staging = realloc (stream->staging, new_size);
+  stream->staging_size = new_size;
+
+  stream->map = stream->staging;
+  stream->map_offset = 0;
+
+  return true;
+}
+
+/* copies the instances staged since the last upload into the current
+   region with a single call, growing it first if needed */
+static void
+upload_staged_fixed_attrs (GlrBatch *self, InstanceStream *stream)
+{
+  VboRegion *region;
+  size_t new_region_size;
+
+  if (stream->used_size == stream->uploaded_size)
+    return;
+
+  if (stream->ring[0].vbo == 0)
+    create_fixed_attrs_buffers (self, stream);
+
+  region = &stream->ring[stream->current_region];
+  self->gl->BindBuffer (GL_ARRAY_BUFFER, region->vbo);
+
+  if (stream->uploaded_size == 0)
+    start_over_on_region (self, region);
+
+  if (stream->used_size > region->size)
+    {
+      // new storage under the same name, which needs everything again
+      new_region_size = region->size * 2;
+      while (new_region_size < stream->used_size)
+        new_region_size *= 2;
+      new_region_size = MIN (new_region_size, FIXED_ATTRS_BUFFER_MAXIMUM_SIZE);
+
+      self->gl->BufferData (GL_ARRAY_BUFFER,
+                            new_region_size,
+                            NULL,
+                            GL_STREAM_DRAW);
+      region->size = new_region_size;
+      stream->uploaded_size = 0;
+    }
+
+  self->gl->BufferSubData (GL_ARRAY_BUFFER,
+                           stream->uploaded_size,
+                           stream->used_size - stream->uploaded_size,
+                           stream->staging + stream->uploaded_size);
+  stream->uploaded_size = stream->used_size;
+}
+
+static bool
+check_fixed_attrs_buffers_maybe_grow (GlrBatch       *self,
+                                      InstanceStream *stream,
+                                      size_t          num_instances)
+{
+  VboRegion *region;
+  size_t new_size;
+  size_t new_region_size;
+  GLuint new_vbo;
+
+  new_size = stream->used_size + num_instances * instance_size (self);
+
+  if (self->deferred)
+    return grow_staging (stream, new_size);
+
+  if (stream->ring[0].vbo == 0)
+    create_fixed_attrs_buffers (self, stream);
+
+  region = &stream->ring[stream->current_region];
+
+  if (new_size <= region->size)
+    {
+      if (stream->map == NULL)
+        map_fixed_attrs (self, stream);
+
+      return stream->map != NULL;
+    }
+
   // need to grow buffers
 
   // check if that's possible
   if (new_size > FIXED_ATTRS_BUFFER_MAXIMUM_SIZE)
     return false;
 
-  self->fixed_attrs_size =
-    MIN (self->fixed_attrs_size * 2, FIXED_ATTRS_BUFFER_MAXIMUM_SIZE);
+  // move the instances already stored in the region into a bigger VBO,
+  // without going through client memory
+  unmap_fixed_attrs (self, stream);
+
+  new_region_size = region->size * 2;
+  while (new_region_size < new_size)
+    new_region_size *= 2;
+  new_region_size = MIN (new_region_size, FIXED_ATTRS_BUFFER_MAXIMUM_SIZE);
+
+  self->gl->GenBuffers (1, &new_vbo);
+  self->gl->BindBuffer (GL_COPY_WRITE_BUFFER, new_vbo);
+  self->gl->BufferData (GL_COPY_WRITE_BUFFER,
+                        new_region_size,
+                        NULL,
+                        GL_STREAM_DRAW);
+
+  if (stream->used_size > 0)
+    {
+      self->gl->BindBuffer (GL_COPY_READ_BUFFER, region->vbo);
+      self->gl->CopyBufferSubData (GL_COPY_READ_BUFFER,
+                                   GL_COPY_WRITE_BUFFER,
+                                   0, 0,
+                                   stream->used_size);
+    }
+
+  self->gl->DeleteBuffers (1, &region->vbo);
+  if (region->fence != NULL)
+    {
+      self->gl->DeleteSync (region->fence);
+      region->fence = NULL;
+    }
+
+  region->vbo = new_vbo;
+  region->size = new_region_size;
+
+  // the VAO may still point to the old storage, under a name that can
+  // be reused
+  stream->vao_vbo = 0;
+
+  map_fixed_attrs (self, stream);
+
+  return stream->map != NULL;
+}
+
+static uint32_t
+dyn_attrs_tex_height_for_samples (GlrBatch *self, size_t num_samples)
+{
+  uint32_t height = MAX (self->dyn_attrs_tex_height,
+                         DYN_ATTRS_TEX_INITIAL_HEIGHT);
+
+  while ((size_t) height * DYN_ATTRS_TEX_WIDTH < num_samples)
+    height *= 2;
+
+  return MIN (height, DYN_ATTRS_TEX_MAXIMUM_HEIGHT);
+}
+
+static bool
+can_grow_dyn_attrs_tex (GlrBatch *self, size_t num_samples)
+{
+  uint32_t height;
+
+  if (num_samples <= (size_t) self->dyn_attrs_tex_height * DYN_ATTRS_TEX_WIDTH)
+    return true;
+
+  if (num_samples > DYN_ATTRS_MAXIMUM_SAMPLES)
+    return false;
+
+  height = dyn_attrs_tex_height_for_samples (self, num_samples);
 
-  self->fixed_attrs_buf = realloc (self->fixed_attrs_buf,
-                                   self->fixed_attrs_size);
+  return glr_context_has_dyn_attrs_memory (self->context,
+                                           (height - self->dyn_attrs_tex_height)
+                                           * DYN_ATTRS_TEX_ROW_SIZE);
+}
+
+static bool
+maybe_grow_dyn_attrs_tex (GlrBatch *self, size_t num_samples)
+{
+  uint32_t height;
+
+  if (num_samples <= (size_t) self->dyn_attrs_tex_height * DYN_ATTRS_TEX_WIDTH)
+    return true;
+
+  if (num_samples > DYN_ATTRS_MAXIMUM_SAMPLES)
+    return false;
+
+  height = dyn_attrs_tex_height_for_samples (self, num_samples);
+
+  if (! glr_context_reserve_dyn_attrs_memory (self->context,
+                                              (height - self->dyn_attrs_tex_height)
+                                              * DYN_ATTRS_TEX_ROW_SIZE))
+    {
+      return false;
+    }
+
+  self->dyn_attrs_tex_height = height;
 
   return true;
 }
 
+/* creates the dyn attrs texture, leaving it bound */
+static void
+create_dyn_attrs_tex (GlrBatch *self)
+{
+  self->gl->GenTextures (1, &self->dyn_attrs_tex);
+  glr_context_bind_texture (self->context,
+                            DYN_ATTRS_TEX_UNIT,
+                            self->dyn_attrs_tex);
+  self->gl->TexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  self->gl->TexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  self->gl->TexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  self->gl->TexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+/* makes sure the texture storage has the reserved height. New storage has
+   undefined content, so all samples have to be uploaded again */
+static void
+maybe_reallocate_dyn_attrs_tex (GlrBatch *self)
+{
+  if (self->dyn_attrs_tex_allocated_height == self->dyn_attrs_tex_height)
+    return;
+
+  self->gl->TexImage2D (GL_TEXTURE_2D,
+                        0,
+                        GL_RGBA32F,
+                        DYN_ATTRS_TEX_WIDTH,
+                        self->dyn_attrs_tex_height,
+                        0,
+                        GL_RGBA,
+                        GL_FLOAT,
+                        NULL);
+
+  self->dyn_attrs_tex_allocated_height = self->dyn_attrs_tex_height;
+  self->dyn_attrs_uploaded_samples = 0;
+}
+
+/* uploads samples [first, last) of the dyn attrs texture, whose data
+   is at 'data' (a client pointer, or an offset into a bound unpack
+   buffer). Only the touched texels are sent: the tail of the first row,
+   the full rows in between and the head of the last row */
+static void
+upload_dyn_attrs_range (GlrBatch      *self,
+                        size_t         first,
+                        size_t         last,
+                        const uint8_t *data)
+{
+  const size_t W = DYN_ATTRS_TEX_WIDTH;
+  size_t column = first % W;
+  size_t row = first / W;
+  size_t count;
+
+  if (column > 0)
+    {
+      count = MIN (W - column, last - first);
+      self->gl->TexSubImage2D (GL_TEXTURE_2D,
+                               0,
+                               column, row,
+                               count, 1,
+                               GL_RGBA,
+                               GL_FLOAT,
+                               data);
+      first += count;
+      data += count * 4 * sizeof (float);
+      row++;
+    }
+
+  if (last - first >= W)
+    {
+      count = (last - first) / W;
+      self->gl->TexSubImage2D (GL_TEXTURE_2D,
+                               0,
+                               0, row,
+                               W, count,
+                               GL_RGBA,
+                               GL_FLOAT,
+                               data);
+      first += count * W;
+      data += count * W * 4 * sizeof (float);
+      row += count;
+    }
+
+  if (last > first)
+    {
+      self->gl->TexSubImage2D (GL_TEXTURE_2D,
+                               0,
+                               0, row,
+                               last - first, 1,
+                               GL_RGBA,
+                               GL_FLOAT,
+                               data);
+    }
+}
+
+static void
+upload_dyn_attrs (GlrBatch *self)
+{
+  size_t first = self->dyn_attrs_uploaded_samples;
+  size_t last = self->dyn_attrs_sample_count;
+  const uint8_t *src = self->dyn_attrs_buffer + first * 4 * sizeof (float);
+  size_t size = (last - first) * 4 * sizeof (float);
+  void *pbo_data;
+
+  if (last - first < DYN_ATTRS_PBO_MINIMUM_SAMPLES)
+    {
+      upload_dyn_attrs_range (self, first, last, src);
+      return;
+    }
+
+  if (self->dyn_attrs_pbo == 0)
+    self->gl->GenBuffers (1, &self->dyn_attrs_pbo);
+
+  // orphan the previous contents, which may still be feeding a copy
+  self->gl->BindBuffer (GL_PIXEL_UNPACK_BUFFER, self->dyn_attrs_pbo);
+  self->gl->BufferData (GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+
+  pbo_data = self->gl->MapBufferRange (GL_PIXEL_UNPACK_BUFFER,
+                                       0,
+                                       size,
+                                       GL_MAP_WRITE_BIT
+                                       | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (pbo_data == NULL)
+    {
+      self->gl->BindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+      upload_dyn_attrs_range (self, first, last, src);
+      return;
+    }
+
+  memcpy (pbo_data, src, size);
+
+  if (self->gl->UnmapBuffer (GL_PIXEL_UNPACK_BUFFER) == GL_TRUE)
+    {
+      upload_dyn_attrs_range (self, first, last, NULL);
+      self->gl->BindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+  else
+    {
+      self->gl->BindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+      upload_dyn_attrs_range (self, first, last, src);
+    }
+}
+
 static bool
 check_dyn_attrs_buffer_maybe_grow (GlrBatch *self, size_t samples_needed)
 {
@@ -108,24 +695,283 @@ check_dyn_attrs_buffer_maybe_grow (GlrBatch *self, size_t samples_needed)
   return true;
 }
 
+/* the packed config word of a compact instance, storing the style entry it
+   points to if needed */
+static uint32_t
+compact_config (GlrBatch *self, const GlrInstanceConfig config)
+{
+  float style[4];
+  size_t style_offset = 0;
+  bool interned;
+
+  // all values are below 2^24, so they are exact as floats. Sub-instances
+  // of a rect share the same entry, since the type is not part of it
+  style[0] = config[0] & 0x00FFFFFF;
+  style[1] = config[1];
+  style[2] = config[2];
+  style[3] = config[3];
+
+  if (style[0] != 0 || style[1] != 0 || style[2] != 0 || style[3] != 0)
+    {
+      style_offset = glr_batch_add_dyn_attr_interned (self,
+                                                      style,
+                                                      sizeof (style),
+                                                      &interned);
+    }
+
+  // bits 26 to 29 of config0 (the instance type) go to bits 28 to 31
+  return ((config[0] & 0x3C000000) << 2) | style_offset;
+}
+
+static void
+write_compact_instance (CompactInstanceAttr *attr,
+                        const GlrLayout     *layout,
+                        GlrColor             color,
+                        uint32_t             config)
+{
+  attr->lyt[0] = lrintf (layout->left * COMPACT_LAYOUT_SUBPIXELS);
+  attr->lyt[1] = lrintf (layout->top * COMPACT_LAYOUT_SUBPIXELS);
+  attr->lyt[2] = lrintf (layout->width * COMPACT_LAYOUT_SUBPIXELS);
+  attr->lyt[3] = lrintf (layout->height * COMPACT_LAYOUT_SUBPIXELS);
+
+  attr->color = color;
+  attr->config = config;
+}
+
+static bool
+bounds_overlap (const float *a, const float *b)
+{
+  return a[0] < b[2] && b[0] < a[2] && a[1] < b[3] && b[1] < a[3];
+}
+
+/* whether the inner area of an instance can be drawn without blending.
+   Only instances of the solid class lack round corners, and their anti-aliased
+   edges are left to the translucent pass. So are the edges of a clip */
+static bool
+instance_is_opaque (GlrInstanceClass         klass,
+                    GlrColor                 color,
+                    const GlrInstanceConfig  config)
+{
+  return klass == GLR_INSTANCE_CLASS_SOLID
+    && (color & 0xFF) == 0xFF
+    && (config[1] & GLR_INSTANCE_CLIP_FLAG) == 0;
+}
+
+static void
+layout_bounds (const GlrLayout *layout, float *bounds)
+{
+  bounds[0] = MIN (layout->left, layout->left + layout->width);
+  bounds[1] = MIN (layout->top, layout->top + layout->height);
+  bounds[2] = MAX (layout->left, layout->left + layout->width);
+  bounds[3] = MAX (layout->top, layout->top + layout->height);
+}
+
+/* adds 'count' consecutive instances of a class' stream, starting at
+   'index', to the runs. 'bounds' covers all of them */
+static void
+add_to_run (GlrBatch         *self,
+            GlrInstanceClass  klass,
+            size_t            index,
+            size_t            count,
+            const float      *bounds,
+            bool              bounded,
+            size_t            num_opaque)
+{
+  InstanceRun *run = NULL;
+  size_t i;
+
+  // look for the last run of this class, making sure the instance can be
+  // drawn before all the runs that follow it
+  for (i = self->num_runs; i > 0; i--)
+    {
+      InstanceRun *r = &self->runs[i - 1];
+
+      if (r->klass == klass)
+        {
+          run = r;
+          break;
+        }
+
+      if (! bounded
+          || ! r->bounded
+          || bounds_overlap (bounds, r->bounds)
+          || self->num_runs - i >= INSTANCE_RUNS_MAXIMUM_LOOKBACK)
+        {
+          break;
+        }
+    }
+
+  // a run covers consecutive instances of its class' stream, which is
+  // always the case for the last run of a class
+  if (run != NULL)
+    {
+      run->count += count;
+      run->num_opaque += num_opaque;
+      run->bounded = run->bounded && bounded;
+      run->bounds[0] = MIN (run->bounds[0], bounds[0]);
+      run->bounds[1] = MIN (run->bounds[1], bounds[1]);
+      run->bounds[2] = MAX (run->bounds[2], bounds[2]);
+      run->bounds[3] = MAX (run->bounds[3], bounds[3]);
+      return;
+    }
+
+  if (self->num_runs == self->runs_size)
+    {
+      self->runs_size *= 2;
+      self->runs = realloc (self->runs, sizeof (InstanceRun) * self->runs_size);
+    }
+
+  run = &self->runs[self->num_runs++];
+  run->klass = klass;
+  run->first = index;
+  run->count = count;
+  run->num_opaque = num_opaque;
+  run->bounded = bounded;
+  memcpy (run->bounds, bounds, sizeof (run->bounds));
+}
+
+static void
+set_attr_pointers (GlrBatch *self, size_t base)
+{
+  const GlrContextCaps *caps = glr_context_get_caps (self->context);
+
+  // layout attr
+  self->gl->VertexAttribPointer (LAYOUT_ATTR,
+                                 4,
+                                 GL_FLOAT,
+                                 GL_FALSE,
+                                 sizeof (InstanceAttr),
+                                 (const GLvoid *) (base));
+
+  // color attr
+  self->gl->VertexAttribPointer (COLOR_ATTR,
+                                 4,
+                                 GL_UNSIGNED_BYTE,
+                                 GL_TRUE,
+                                 sizeof (InstanceAttr),
+                                 (const GLvoid *) (base + sizeof (GlrLayout)));
+
+  // config attr
+  if (caps->integer_vertex_attribs)
+    self->gl->VertexAttribIPointer (CONFIG_ATTR,
+                                    4,
+                                    GL_UNSIGNED_INT,
+                                    sizeof (InstanceAttr),
+                                    (const GLvoid *) (base
+                                                      + sizeof (GlrLayout)
+                                                      + sizeof (GlrColor)));
+  else
+    self->gl->VertexAttribPointer (CONFIG_ATTR,
+                                   4,
+                                   caps->legacy_config_attr_type,
+                                   GL_FALSE,
+                                   sizeof (InstanceAttr),
+                                   (const GLvoid *) (base
+                                                     + sizeof (GlrLayout)
+                                                     + sizeof (GlrColor)));
+}
+
+static void
+set_compact_attr_pointers (GlrBatch *self, size_t base)
+{
+  // layout attr
+  self->gl->VertexAttribPointer (LAYOUT_ATTR,
+                                 4,
+                                 GL_SHORT,
+                                 GL_FALSE,
+                                 sizeof (CompactInstanceAttr),
+                                 (const GLvoid *) (base));
+
+  // color attr
+  self->gl->VertexAttribPointer (COLOR_ATTR,
+                                 4,
+                                 GL_UNSIGNED_BYTE,
+                                 GL_TRUE,
+                                 sizeof (CompactInstanceAttr),
+                                 (const GLvoid *) (base
+                                                   + sizeof (int16_t) * 4));
+
+  // packed config attr
+  self->gl->VertexAttribIPointer (CONFIG_ATTR,
+                                  1,
+                                  GL_UNSIGNED_INT,
+                                  sizeof (CompactInstanceAttr),
+                                  (const GLvoid *) (base
+                                                    + sizeof (int16_t) * 4
+                                                    + sizeof (GlrColor)));
+}
+
+static void
+bind_stream_vao (GlrBatch *self, InstanceStream *stream)
+{
+  int i;
+
+  if (stream->vao != 0)
+    {
+      glr_context_bind_vertex_array (self->context, stream->vao);
+      return;
+    }
+
+  // all attributes advance once per instance
+  self->gl->GenVertexArrays (1, &stream->vao);
+  glr_context_bind_vertex_array (self->context, stream->vao);
+
+  for (i = LAYOUT_ATTR; i <= CONFIG_ATTR; i++)
+    {
+      self->gl->EnableVertexAttribArray (i);
+      self->gl->VertexAttribDivisor (i, 1);
+    }
+
+  stream->vao_vbo = 0;
+}
+
+static guint
+dyn_attr_key_hash (gconstpointer key)
+{
+  const DynAttrKey *k = key;
+  guint hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < k->size; i++)
+    hash = (hash ^ k->data[i]) * 16777619u;
+
+  return hash;
+}
+
+static gboolean
+dyn_attr_key_equal (gconstpointer a, gconstpointer b)
+{
+  const DynAttrKey *k1 = a;
+  const DynAttrKey *k2 = b;
+
+  return k1->size == k2->size && memcmp (k1->data, k2->data, k1->size) == 0;
+}
+
+static void
+dyn_attr_key_free (gpointer key)
+{
+  g_slice_free (DynAttrKey, key);
+}
+
 /* public API */
 
 GlrBatch *
-glr_batch_new (void)
+glr_batch_new (GlrContext *context)
 {
   GlrBatch *self;
 
   self = calloc (1, sizeof (GlrBatch));
   self->ref_count = 1;
 
-  // fixed attrs buffer
-  self->fixed_attrs_size = FIXED_ATTRS_BUFFER_INITIAL_SIZE;
-  self->fixed_attrs_buf = malloc (self->fixed_attrs_size);
-  self->fixed_attrs_vbo_size = 0;
-  self->fixed_attrs_used_size = 0;
-  self->fixed_attrs_uploaded_size = 0;
+  self->context = glr_context_ref (context);
+  self->gl = glr_context_get_symbols (context);
 
-  glGenBuffers (1, &self->fixed_attrs_vbo);
+  // fixed attrs buffers are created as each class gets its first instance
+  self->use_fences = glr_context_get_caps (context)->fence_sync;
+
+  self->runs_size = INSTANCE_RUNS_INITIAL_SIZE;
+  self->runs = malloc (sizeof (InstanceRun) * self->runs_size);
+  self->num_runs = 0;
 
   // dyn attrs buffer
   self->dyn_attrs_buffer_size = DYN_ATTRS_BUFFER_INITIAL_SIZE;
@@ -133,22 +979,30 @@ glr_batch_new (void)
   self->dyn_attrs_sample_count = 0;
   self->dyn_attrs_uploaded_samples = 0;
 
-  glGenTextures (1, &self->dyn_attrs_tex);
-  glBindTexture (GL_TEXTURE_2D, self->dyn_attrs_tex);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexImage2D (GL_TEXTURE_2D,
-                0,
-                GL_RGBA32F,
-                DYN_ATTRS_TEX_WIDTH,
-                DYN_ATTRS_TEX_HEIGHT,
-                0,
-                GL_RGBA,
-                GL_FLOAT,
-                NULL);
-  glBindTexture (GL_TEXTURE_2D, 0);
+  // the texture and its storage are created on first upload
+  self->dyn_attrs_tex = 0;
+  self->dyn_attrs_tex_height = 0;
+  self->dyn_attrs_tex_allocated_height = 0;
+
+  self->dyn_attrs_intern_table = g_hash_table_new_full (dyn_attr_key_hash,
+                                                        dyn_attr_key_equal,
+                                                        dyn_attr_key_free,
+                                                        NULL);
+
+  return self;
+}
+
+/* a batch whose instances and dyn attrs are only kept in client memory
+   until uploaded, so it can be filled without any GL call, from any thread.
+   Everything else still needs the GL thread, including dropping the last
+   reference once uploaded. Its instances cannot be updated in place */
+GlrBatch *
+glr_batch_new_deferred (GlrContext *context)
+{
+  GlrBatch *self;
+
+  self = glr_batch_new (context);
+  self->deferred = true;
 
   return self;
 }
@@ -177,140 +1031,424 @@ glr_batch_unref (GlrBatch *self)
 bool
 glr_batch_is_full (GlrBatch *self)
 {
-  return
-    self->fixed_attrs_used_size + sizeof (InstanceAttr) > FIXED_ATTRS_BUFFER_MAXIMUM_SIZE;
+  return ! glr_batch_has_room (self, 1, 0);
+}
+
+bool
+glr_batch_has_room (GlrBatch *self,
+                    size_t    num_instances,
+                    size_t    num_dyn_attr_samples)
+{
+  size_t used_size = 0;
+  int i;
+
+  // the instances may all go to the fullest stream
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    used_size = MAX (used_size, self->streams[i].used_size);
+
+  if (used_size + num_instances * instance_size (self)
+      > FIXED_ATTRS_BUFFER_MAXIMUM_SIZE)
+    {
+      return false;
+    }
+
+  // compact instances may need a style entry each
+  if (self->instance_format == GLR_INSTANCE_FORMAT_COMPACT)
+    num_dyn_attr_samples += num_instances;
+
+  return can_grow_dyn_attrs_tex (self,
+                                 self->dyn_attrs_sample_count
+                                 + num_dyn_attr_samples);
 }
 
 bool
 glr_batch_add_instance (GlrBatch                *self,
+                        GlrInstanceClass         klass,
                         const GlrLayout         *layout,
                         GlrColor                 color,
                         const GlrInstanceConfig  config)
 {
-  if (! check_fixed_attrs_buffers_maybe_grow (self))
+  return glr_batch_add_instances (self,
+                                  klass,
+                                  1,
+                                  layout,
+                                  &color,
+                                  (const GlrInstanceConfig *) config,
+                                  true) == 1;
+}
+
+/* adds 'count' instances of one class at once. 'configs' holds a config per
+   instance, or a single one for all of them if 'shared_config' is set */
+size_t
+glr_batch_add_instances (GlrBatch                *self,
+                         GlrInstanceClass         klass,
+                         size_t                   count,
+                         const GlrLayout         *layouts,
+                         const GlrColor          *colors,
+                         const GlrInstanceConfig *configs,
+                         bool                     shared_config)
+{
+  InstanceStream *stream = &self->streams[klass];
+  size_t num_opaque = 0;
+  bool bounded = ! self->movable;
+  float bounds[4];
+  float instance_bounds[4];
+  uint8_t *dest;
+  size_t i;
+
+  if (count == 0)
+    return 0;
+
+  if (! check_fixed_attrs_buffers_maybe_grow (self, stream, count))
     {
-      g_warning ("Fixed attributes buffers are full. Ignoring instance.");
-      return false;
+      g_warning ("Fixed attributes buffers are full. Ignoring instances.");
+      return 0;
     }
 
-  InstanceAttr attr;
+  dest = stream->map + (stream->used_size - stream->map_offset);
 
-  memcpy (&attr.lyt, layout, sizeof (GlrLayout));
-  memcpy (&attr.color, &color, sizeof (GlrColor));
-  memcpy (&attr.config, config, sizeof (GlrInstanceConfig));
+  if (self->instance_format == GLR_INSTANCE_FORMAT_COMPACT)
+    {
+      CompactInstanceAttr *attr = (CompactInstanceAttr *) dest;
+      uint32_t config = 0;
 
-  memcpy (self->fixed_attrs_buf + self->fixed_attrs_used_size,
-          &attr, sizeof (InstanceAttr));
-  self->fixed_attrs_used_size += sizeof (InstanceAttr);
+      if (shared_config)
+        config = compact_config (self, configs[0]);
 
-  self->num_instances++;
+      for (i = 0; i < count; i++)
+        {
+          if (! shared_config)
+            config = compact_config (self, configs[i]);
 
-  return true;
+          write_compact_instance (&attr[i], &layouts[i], colors[i], config);
+        }
+    }
+  else
+    {
+      InstanceAttr *attr = (InstanceAttr *) dest;
+
+      for (i = 0; i < count; i++)
+        {
+          attr[i].lyt = layouts[i];
+          attr[i].color = colors[i];
+          memcpy (&attr[i].config,
+                  configs[shared_config ? 0 : i],
+                  sizeof (GlrInstanceConfig));
+        }
+    }
+
+  // instances with their own transform matrix may land anywhere, while a
+  // clip alone only takes from their layout
+  layout_bounds (&layouts[0], bounds);
+  for (i = 0; i < count; i++)
+    {
+      const uint32_t *config = configs[shared_config ? 0 : i];
+
+      layout_bounds (&layouts[i], instance_bounds);
+      bounds[0] = MIN (bounds[0], instance_bounds[0]);
+      bounds[1] = MIN (bounds[1], instance_bounds[1]);
+      bounds[2] = MAX (bounds[2], instance_bounds[2]);
+      bounds[3] = MAX (bounds[3], instance_bounds[3]);
+
+      bounded = bounded
+        && (config[1] == 0 || (config[1] & GLR_INSTANCE_CLIP_ONLY_FLAG) != 0)
+        && (config[0] & GLR_INSTANCE_SCROLL_NODE_MASK) == 0;
+
+      if (instance_is_opaque (klass, colors[i], config))
+        num_opaque++;
+    }
+
+  add_to_run (self,
+              klass,
+              stream->num_instances,
+              count,
+              bounds,
+              bounded,
+              num_opaque);
+
+  stream->used_size += count * instance_size (self);
+  stream->num_instances += count;
+
+  self->num_instances += count;
+  self->num_opaque_instances += num_opaque;
+
+  return count;
 }
 
-bool
-glr_batch_draw (GlrBatch *self, GLuint shader_program)
+static void
+set_program_uniforms (GlrBatch   *self,
+                      GlrProgram *program,
+                      bool        opaque_pass,
+                      uint32_t    depth)
 {
-  GLsizei tex_height;
+  bool compact = self->instance_format == GLR_INSTANCE_FORMAT_COMPACT;
 
-  if (self->num_instances == 0)
-    return false;
+  if (program->compact_instances != compact)
+    {
+      self->gl->Uniform1i (program->compact_instances_loc, compact);
+      program->compact_instances = compact;
+    }
 
-  glBindBuffer (GL_ARRAY_BUFFER, self->fixed_attrs_vbo);
+  if (program->opaque_pass != opaque_pass)
+    {
+      self->gl->Uniform1i (program->opaque_pass_loc, opaque_pass);
+      program->opaque_pass = opaque_pass;
+    }
 
-  // upload fixed attribute's data to VBO
-  if (self->fixed_attrs_vbo_size < self->fixed_attrs_used_size)
+  if (program->depth_base != depth)
     {
-      glBufferData (GL_ARRAY_BUFFER,
-                    self->fixed_attrs_used_size,
-                    self->fixed_attrs_buf,
-                    GL_DYNAMIC_DRAW);
-      self->fixed_attrs_vbo_size = self->fixed_attrs_used_size;
+      self->gl->Uniform1ui (program->depth_base_loc, depth);
+      program->depth_base = depth;
     }
-  else if (self->fixed_attrs_uploaded_size < self->fixed_attrs_used_size)
+}
+
+static void
+draw_run (GlrBatch    *self,
+          InstanceRun *run,
+          GlrProgram  *programs,
+          bool         opaque_pass,
+          uint32_t     depth)
+{
+  InstanceStream *stream = &self->streams[run->klass];
+  GLuint vbo = stream->ring[stream->current_region].vbo;
+  size_t base = run->first * instance_size (self);
+
+  glr_context_use_program (self->context, programs[run->klass].program);
+  set_program_uniforms (self, &programs[run->klass], opaque_pass, depth);
+
+  // both passes draw the same runs, so the pointers are often still set
+  bind_stream_vao (self, stream);
+  if (stream->vao_vbo != vbo || stream->vao_base != base)
     {
-      glBufferSubData (GL_ARRAY_BUFFER,
-                       0,
-                       self->fixed_attrs_used_size,
-                       self->fixed_attrs_buf);
+      self->gl->BindBuffer (GL_ARRAY_BUFFER, vbo);
+
+      if (self->instance_format == GLR_INSTANCE_FORMAT_COMPACT)
+        set_compact_attr_pointers (self, base);
+      else
+        set_attr_pointers (self, base);
+
+      stream->vao_vbo = vbo;
+      stream->vao_base = base;
     }
 
-  self->fixed_attrs_uploaded_size = self->fixed_attrs_used_size;
+  self->gl->DrawArraysInstanced (GL_TRIANGLE_FAN, 0, 4, run->count);
+}
 
-  // layout attr
-  glVertexAttribPointer (LAYOUT_ATTR,
-                         4,
-                         GL_FLOAT,
-                         GL_FALSE,
-                         sizeof (InstanceAttr),
-                         (const GLvoid *) (0));
-  glEnableVertexAttribArray (LAYOUT_ATTR);
-  glVertexAttribDivisor (LAYOUT_ATTR, 1);
+/* makes the instances and dyn attrs added since the last upload available
+   to the GPU, and leaves the dyn attrs texture bound */
+void
+glr_batch_upload (GlrBatch *self)
+{
+  size_t i;
 
-  // color attr
-  glVertexAttribPointer (COLOR_ATTR,
-                         4,
-                         GL_UNSIGNED_BYTE,
-                         GL_TRUE,
-                         sizeof (InstanceAttr),
-                         (const GLvoid *) (sizeof (GlrLayout)));
-  glEnableVertexAttribArray (COLOR_ATTR);
-  glVertexAttribDivisor (COLOR_ATTR, 1);
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    {
+      if (self->deferred)
+        upload_staged_fixed_attrs (self, &self->streams[i]);
+      else
+        unmap_fixed_attrs (self, &self->streams[i]);
+    }
 
-  // config attr
-  // @FIXME: we need runtime detection of env to address GPU quirks
-  const char *backend = getenv ("GLR_BACKEND");
-  glVertexAttribPointer (CONFIG_ATTR,
-                         4,
-                         (backend == NULL || strcmp (backend, "fbdev") != 0) ? GL_FLOAT : GL_UNSIGNED_INT,
-                         GL_FALSE,
-                         sizeof (InstanceAttr),
-                         (const GLvoid *) (sizeof (GlrLayout) + sizeof (GlrColor)));
-  glEnableVertexAttribArray (CONFIG_ATTR);
-  glVertexAttribDivisor (CONFIG_ATTR, 1);
-
-  // upload dynamic attribute's data to texture
-  glActiveTexture (GL_TEXTURE8);
-  glBindTexture (GL_TEXTURE_2D, self->dyn_attrs_tex);
-  glUniform1i (glGetUniformLocation (shader_program, "dyn_attrs_tex"), 8);
-
-  tex_height = ((GLsizei) ceil (self->dyn_attrs_sample_count /
-                                (float) DYN_ATTRS_TEX_WIDTH));
-  if (tex_height > 0)
-    {
-      if (self->dyn_attrs_sample_count > self->dyn_attrs_uploaded_samples)
+  if (self->dyn_attrs_tex == 0)
+    create_dyn_attrs_tex (self);
+  else
+    glr_context_bind_texture (self->context,
+                              DYN_ATTRS_TEX_UNIT,
+                              self->dyn_attrs_tex);
+
+  maybe_reallocate_dyn_attrs_tex (self);
+
+  // only samples added since the previous upload need to be sent
+  if (self->dyn_attrs_sample_count > self->dyn_attrs_uploaded_samples)
+    {
+      upload_dyn_attrs (self);
+      self->dyn_attrs_uploaded_samples = self->dyn_attrs_sample_count;
+    }
+}
+
+bool
+glr_batch_draw (GlrBatch   *self,
+                GlrProgram *programs,
+                uint32_t    first_depth,
+                bool        opaque_pass)
+{
+  uint32_t depth;
+  size_t i;
+
+  if (self->num_instances == 0)
+    return false;
+
+  glr_batch_upload (self);
+
+  // runs take consecutive ranges of depth values, in order. The opaque pass
+  // goes through them backwards so nearer instances are drawn first, and
+  // writes depth with blending off
+  if (opaque_pass && self->num_opaque_instances > 0)
+    {
+      glr_context_set_blend (self->context, false);
+      glr_context_set_depth_mask (self->context, true);
+
+      depth = first_depth + self->num_instances;
+      for (i = self->num_runs; i > 0; i--)
         {
-          glTexSubImage2D (GL_TEXTURE_2D,
-                           0,
-                           0, 0,
-                           DYN_ATTRS_TEX_WIDTH,
-                           tex_height,
-                           GL_RGBA,
-                           GL_FLOAT,
-                           self->dyn_attrs_buffer);
-          self->dyn_attrs_uploaded_samples = self->dyn_attrs_sample_count;
+          InstanceRun *run = &self->runs[i - 1];
+
+          depth -= run->count;
+          if (run->num_opaque == 0)
+            continue;
+
+          draw_run (self, run, programs, true, depth);
         }
     }
 
-  // draw
-  glDrawArraysInstanced (GL_TRIANGLE_FAN,
-                         0,
-                         4,
-                         self->num_instances);
+  // then everything is blended in order, which fills in the edges of opaque
+  // instances and whatever is not hidden behind them
+  glr_context_set_blend (self->context, true);
+  glr_context_set_depth_mask (self->context, false);
+
+  depth = first_depth;
+  for (i = 0; i < self->num_runs; i++)
+    {
+      InstanceRun *run = &self->runs[i];
+
+      draw_run (self, run, programs, false, depth);
+
+      depth += run->count;
+    }
+
+  // mark the point where the GPU is done reading the regions
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES && self->use_fences; i++)
+    {
+      InstanceStream *stream = &self->streams[i];
+      VboRegion *region = &stream->ring[stream->current_region];
+
+      if (stream->num_instances == 0)
+        continue;
+
+      if (region->fence != NULL)
+        self->gl->DeleteSync (region->fence);
+      region->fence = self->gl->FenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+      // fall back to orphaning if the driver cannot give us fences
+      if (region->fence == NULL)
+        self->use_fences = false;
+    }
 
   return true;
 }
 
+size_t
+glr_batch_get_num_instances (GlrBatch *self)
+{
+  return self->num_instances;
+}
+
+size_t
+glr_batch_get_num_fence_waits (GlrBatch *self)
+{
+  return self->num_fence_waits;
+}
+
+/* the index the next instance of a class will take in its stream */
+size_t
+glr_batch_get_num_class_instances (GlrBatch *self, GlrInstanceClass klass)
+{
+  return self->streams[klass].num_instances;
+}
+
+void
+glr_batch_set_movable (GlrBatch *self, bool movable)
+{
+  self->movable = movable;
+}
+
+/* overwrites the layout and/or color of an instance already uploaded,
+   sending only those bytes. Either may be NULL */
+void
+glr_batch_update_instance (GlrBatch         *self,
+                           GlrInstanceClass  klass,
+                           size_t            index,
+                           const GlrLayout  *layout,
+                           const GlrColor   *color)
+{
+  InstanceStream *stream = &self->streams[klass];
+  size_t base = index * instance_size (self);
+
+  assert (index < stream->num_instances);
+  assert (! self->deferred);
+
+  unmap_fixed_attrs (self, stream);
+  self->gl->BindBuffer (GL_ARRAY_BUFFER,
+                        stream->ring[stream->current_region].vbo);
+
+  if (self->instance_format == GLR_INSTANCE_FORMAT_COMPACT)
+    {
+      CompactInstanceAttr attr;
+
+      if (layout != NULL && glr_batch_layout_fits_compact (layout))
+        {
+          write_compact_instance (&attr, layout, 0, 0);
+          self->gl->BufferSubData (GL_ARRAY_BUFFER,
+                                   base + offsetof (CompactInstanceAttr, lyt),
+                                   sizeof (attr.lyt),
+                                   attr.lyt);
+        }
+      else if (layout != NULL)
+        {
+          g_warning ("Layout does not fit the compact instance format. Ignoring it.");
+        }
+
+      if (color != NULL)
+        self->gl->BufferSubData (GL_ARRAY_BUFFER,
+                                 base + offsetof (CompactInstanceAttr, color),
+                                 sizeof (GlrColor),
+                                 color);
+    }
+  else
+    {
+      if (layout != NULL)
+        self->gl->BufferSubData (GL_ARRAY_BUFFER,
+                                 base + offsetof (InstanceAttr, lyt),
+                                 sizeof (GlrLayout),
+                                 layout);
+
+      if (color != NULL)
+        self->gl->BufferSubData (GL_ARRAY_BUFFER,
+                                 base + offsetof (InstanceAttr, color),
+                                 sizeof (GlrColor),
+                                 color);
+    }
+}
+
 void
 glr_batch_reset (GlrBatch *self)
 {
+  uint32_t ring_size = glr_context_get_frames_in_flight (self->context);
+  int i;
+
   self->num_instances = 0;
+  self->num_runs = 0;
+  self->num_opaque_instances = 0;
+  self->movable = false;
+  self->num_fence_waits = 0;
+
+  // anything written but never drawn is discarded, and the next frame
+  // moves on to the next region of the ring
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    {
+      InstanceStream *stream = &self->streams[i];
 
-  self->fixed_attrs_used_size = 0;
-  self->fixed_attrs_uploaded_size = 0;
+      unmap_fixed_attrs (self, stream);
+      stream->current_region = (stream->current_region + 1) % ring_size;
+      stream->used_size = 0;
+      stream->uploaded_size = 0;
+      stream->num_instances = 0;
+    }
 
   self->dyn_attrs_sample_count = 0;
   self->dyn_attrs_uploaded_samples = 0;
+
+  g_hash_table_remove_all (self->dyn_attrs_intern_table);
 }
 
 size_t
@@ -325,7 +1463,9 @@ glr_batch_add_dyn_attr (GlrBatch *self, const void *attr_data, size_t size)
   if (size % 16 > 0)
     num_samples++;
 
-  if (! check_dyn_attrs_buffer_maybe_grow (self, num_samples))
+  if (! maybe_grow_dyn_attrs_tex (self,
+                                  self->dyn_attrs_sample_count + num_samples)
+      || ! check_dyn_attrs_buffer_maybe_grow (self, num_samples))
     {
       g_warning ("Dynamic attributes buffer is full. Ignoring.");
       return 0;
@@ -337,3 +1477,76 @@ glr_batch_add_dyn_attr (GlrBatch *self, const void *attr_data, size_t size)
 
   return self->dyn_attrs_sample_count - num_samples + 1;
 }
+
+/* like glr_batch_add_dyn_attr(), but returns the offset of an identical block
+   if one was already added since the last reset. 'interned' tells whether
+   that was the case */
+size_t
+glr_batch_add_dyn_attr_interned (GlrBatch   *self,
+                                 const void *attr_data,
+                                 size_t      size,
+                                 bool       *interned)
+{
+  DynAttrKey key;
+  gpointer offset;
+
+  *interned = false;
+
+  if (size > DYN_ATTRS_INTERN_MAXIMUM_SIZE)
+    return glr_batch_add_dyn_attr (self, attr_data, size);
+
+  key.size = size;
+  memcpy (key.data, attr_data, size);
+
+  offset = g_hash_table_lookup (self->dyn_attrs_intern_table, &key);
+  if (offset != NULL)
+    {
+      *interned = true;
+      return GPOINTER_TO_SIZE (offset);
+    }
+
+  offset = GSIZE_TO_POINTER (glr_batch_add_dyn_attr (self, attr_data, size));
+  if (offset != NULL)
+    {
+      g_hash_table_insert (self->dyn_attrs_intern_table,
+                           g_slice_dup (DynAttrKey, &key),
+                           offset);
+    }
+
+  return GPOINTER_TO_SIZE (offset);
+}
+
+void
+glr_batch_set_instance_format (GlrBatch *self, GlrInstanceFormat format)
+{
+  int i;
+
+  assert (self->num_instances == 0);
+
+  if (self->instance_format == format)
+    return;
+
+  self->instance_format = format;
+
+  // the attribute pointers cached on the VAOs describe the other format
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    self->streams[i].vao_vbo = 0;
+}
+
+GlrInstanceFormat
+glr_batch_get_instance_format (GlrBatch *self)
+{
+  return self->instance_format;
+}
+
+/* whether a rect covering 'layout' can be stored in the compact format */
+bool
+glr_batch_layout_fits_compact (const GlrLayout *layout)
+{
+  return fabsf (layout->left) < COMPACT_LAYOUT_MAXIMUM
+    && fabsf (layout->top) < COMPACT_LAYOUT_MAXIMUM
+    && fabsf (layout->left + layout->width) < COMPACT_LAYOUT_MAXIMUM
+    && fabsf (layout->top + layout->height) < COMPACT_LAYOUT_MAXIMUM
+    && fabsf (layout->width) < COMPACT_LAYOUT_MAXIMUM
+    && fabsf (layout->height) < COMPACT_LAYOUT_MAXIMUM;
+}
@@ -7,23 +7,69 @@
 
 typedef struct _GlrBatch GlrBatch;
 
-GlrBatch * glr_batch_new            (void);
+/* each instance drawn between two clears of the depth buffer takes its own
+   depth value. Must match DEPTH_STEP in the vertex shader */
+#define GLR_BATCH_DEPTH_SLOTS (1 << 22)
+
+/* texture unit where the dyn attrs texture is bound. Units 0 to 7 are
+   reserved for the glyph cache */
+#define GLR_BATCH_DYN_ATTRS_TEX_UNIT 8
+
+GlrBatch * glr_batch_new            (GlrContext *context);
+GlrBatch * glr_batch_new_deferred   (GlrContext *context);
 GlrBatch * glr_batch_ref            (GlrBatch *self);
 void       glr_batch_unref          (GlrBatch *self);
 
+void       glr_batch_set_instance_format (GlrBatch          *self,
+                                          GlrInstanceFormat  format);
+GlrInstanceFormat
+           glr_batch_get_instance_format (GlrBatch *self);
+bool       glr_batch_layout_fits_compact (const GlrLayout *layout);
+
 bool       glr_batch_is_full        (GlrBatch *self);
+bool       glr_batch_has_room       (GlrBatch *self,
+                                     size_t    num_instances,
+                                     size_t    num_dyn_attr_samples);
 bool       glr_batch_add_instance   (GlrBatch                *self,
+                                     GlrInstanceClass         klass,
                                      const GlrLayout         *layout,
                                      GlrColor                 color,
                                      const GlrInstanceConfig  config);
+size_t     glr_batch_add_instances  (GlrBatch                *self,
+                                     GlrInstanceClass         klass,
+                                     size_t                   count,
+                                     const GlrLayout         *layouts,
+                                     const GlrColor          *colors,
+                                     const GlrInstanceConfig *configs,
+                                     bool                     shared_config);
+
+size_t     glr_batch_get_num_instances (GlrBatch *self);
+size_t     glr_batch_get_num_fence_waits (GlrBatch *self);
+size_t     glr_batch_get_num_class_instances (GlrBatch         *self,
+                                              GlrInstanceClass  klass);
+
+void       glr_batch_set_movable    (GlrBatch *self,
+                                     bool      movable);
+void       glr_batch_update_instance (GlrBatch         *self,
+                                      GlrInstanceClass  klass,
+                                      size_t            index,
+                                      const GlrLayout  *layout,
+                                      const GlrColor   *color);
 
-bool       glr_batch_draw           (GlrBatch *self,
-                                     GLuint    shader_program);
+void       glr_batch_upload         (GlrBatch *self);
+bool       glr_batch_draw           (GlrBatch   *self,
+                                     GlrProgram *programs,
+                                     uint32_t    first_depth,
+                                     bool        opaque_pass);
 
 void       glr_batch_reset          (GlrBatch *self);
 
 size_t     glr_batch_add_dyn_attr   (GlrBatch   *self,
                                      const void *attr_data,
                                      size_t      size);
+size_t     glr_batch_add_dyn_attr_interned (GlrBatch   *self,
+                                            const void *attr_data,
+                                            size_t      size,
+                                            bool       *interned);
 
 #endif /* _GLR_BATCH_H_ */
@@ -5,7 +5,7 @@
 #include <assert.h>
 #include "glr-batch.h"
 #include "glr-priv.h"
-#include "glr-shaders.h"
+#include "glr-recorder.h"
 #include <math.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -16,10 +16,6 @@
 #define EQUALS(x, y)   (fabs (x - y) <= DBL_EPSILON * fabs (x + y))
 #define UNEQUALS(x, y) (fabs (x - y)  > DBL_EPSILON * fabs (x + y))
 
-#define LAYOUT_ATTR 0
-#define COLOR_ATTR  1
-#define CONFIG_ATTR 2
-
 #define INSTANCE_TYPE_MASK          0xC3FFFFFF
 #define BORDER_NUM_SAMPLES_MASK     0xFF0FFFFF
 #define BACKGROUND_NUM_SAMPLES_MASK 0xFFF0FFFF
@@ -28,12 +24,42 @@
 
 #define DEFAULT_Z_DEPTH 5000.0
 
+/* worst-case batch usage of a single draw call, used to decide whether
+   the current batch has to be sealed before encoding it. Rects take a box,
+   a background, a clip, an animation and a transform, glyphs their area in
+   the texture, a clip, an animation and a transform */
+#define ANIMATION_NUM_SAMPLES     5
+#define RECT_MAX_INSTANCES        9
+#define RECT_MAX_DYN_ATTR_SAMPLES (3 + 3 + 2 + ANIMATION_NUM_SAMPLES + 4)
+#define CHAR_MAX_DYN_ATTR_SAMPLES (1 + 2 + ANIMATION_NUM_SAMPLES + 4)
+
+/* how many instances the bulk draw functions encode at a time */
+#define BULK_CHUNK_SIZE 256
+
+/* a glyph's area is only known once it is rasterized, so culling uses a
+   box this many ems around the pen position instead */
+#define GLYPH_CULL_EXTENT_EMS 2.0
+
+/* glyphs are rasterized at 96 dpi, see glr-tex-cache.c */
+#define GLYPH_PIXELS_PER_POINT (96.0 / 72.0)
+
+/* half the side of a clip level that lets everything through, far from
+   any canvas coordinate yet safe to subtract in the shader */
+#define UNBOUNDED_CLIP_EXTENT 1.0e30
+
 typedef float GlrColor4f[4];
 
 typedef float Mat4[4][4];
 typedef float Vec4[4];
 typedef float Vec3[3];
 
+static const Mat4 IDENTITY_MATRIX = {
+  {1.0, 0.0, 0.0, 0.0},
+  {0.0, 1.0, 0.0, 0.0},
+  {0.0, 0.0, 1.0, 0.0},
+  {0.0, 0.0, 0.0, 1.0}
+};
+
 typedef struct __attribute__((__packed__))
 {
   Vec3 scale;
@@ -42,48 +68,227 @@ typedef struct __attribute__((__packed__))
   Vec3 origin;
 } GlrTransform;
 
+/* what a transform does to the canvas plane, from cheapest to most
+   expensive to encode. Translations are added to the layout of instances,
+   2D affine transforms take 2 dyn attr samples and the rest a full 4x4
+   matrix, see encode_and_store_transform() */
+typedef enum
+{
+  TRANSFORM_IDENTITY,
+  TRANSFORM_TRANSLATE,
+  TRANSFORM_AFFINE_2D,
+  TRANSFORM_3D
+} TransformClass;
+
+/* transforms encoded in the current batch are looked up by value in a
+   direct-mapped cache of this many entries, see encode_and_store_transform() */
+#define TRANSFORM_CACHE_SIZE 64
+
+typedef struct
+{
+  GlrTransform transform;
+  uint32_t base_id;
+  uint32_t clip_id;
+  size_t offset;
+} TransformCacheEntry;
+
+/* a level of the clip stack, already intersected with the levels below.
+   'rect' is left, top, right and bottom in canvas coordinates, and 'radii'
+   round its top-left, top-right, bottom-left and bottom-right corners.
+   'offset' is where it is encoded in the current batch for untransformed
+   draws, if it is */
+typedef struct
+{
+  float rect[4];
+  float radii[4];
+  uint32_t id;
+  size_t offset;
+} ClipState;
+
+/* a level of the state stack, as glr_canvas_restore() brings it back */
+typedef struct
+{
+  GlrTransform transform;
+  Mat4 base_matrix;
+  TransformClass base_class;
+  uint32_t base_id;
+  size_t base_offset;
+  float base_opacity;
+  float opacity;
+  guint num_clips;
+} SavedState;
+
+/* an entry of the chain of sealed batches: either a batch of the canvas,
+   a display list drawn with 'matrix' applied on top of the view, or the
+   batches of a recorder */
+typedef struct
+{
+  GlrBatch *batch;
+  GlrDisplayList *list;
+  Mat4 matrix;
+  GlrRecorder *recorder;
+} SealedBatch;
+
+/* bit 23 of config1 flags a transform given as a 2D affine transform,
+   bits 0 to 19 hold its offset, see also the flags in glr-priv.h.
+   Must match the vertex shader */
+#define TRANSFORM_AFFINE_2D_FLAG (1 << 23)
+
 struct _GlrCanvas
 {
   int ref_count;
 
   GlrContext *context;
+  const GlrSymbols *gl;
   GlrTarget *target;
 
-  GLuint shader_program;
+  /* one program per instance class, see GlrInstanceClass. They belong to
+     the context, and are shared with its other canvases */
+  GlrProgram *programs;
+
+  /* the format new batches are created with. Compact batches fall back
+     to the full format for rects too large or too far away */
+  GlrInstanceFormat instance_format;
+
+  /* whether rects with borders are drawn as a single box instance */
+  bool sdf_boxes;
 
   bool frame_initialized;
 
+  /* opaque instances are drawn first, front to back, when the framebuffer
+     has a depth buffer. 'next_depth' is the first depth value free since
+     the depth buffer was last cleared */
+  bool opaque_pass;
+  uint32_t next_depth;
+
   uint32_t clear_color;
   bool pending_clear;
 
   GlrTransform transform;
+  TransformClass transform_class;
   size_t current_transform_index;
+  float current_transform_origin[2];
+
+  /* the transforms encoded in the current batch, with the origin they were
+     applied from and the saved levels they were composed with, and their
+     offset in it. An offset of zero means empty */
+  TransformCacheEntry transform_cache[TRANSFORM_CACHE_SIZE];
+
+  /* levels pushed by glr_canvas_save(). The transform and opacity set on
+     the canvas are relative to them, while 'base_matrix' and 'base_opacity'
+     hold those of all saved levels composed. 'base_id' identifies the
+     matrix, and 'base_offset' is where it is encoded in the current batch,
+     if it is */
+  GArray *saved_states;
+  Mat4 base_matrix;
+  TransformClass base_class;
+  uint32_t base_id;
+  uint32_t next_base_id;
+  size_t base_offset;
+  float base_opacity;
+
+  /* the saved levels composed with the current one */
+  TransformClass effective_class;
+  float effective_translation[2];
+  float opacity;
+
+  /* levels pushed by glr_canvas_push_clip_rect() and the like, the last
+     one applying to draws. 'clip_id' identifies it, zero meaning none */
+  GArray *clips;
+  uint32_t clip_id;
+  uint32_t next_clip_id;
+
+  /* size of the area draws are culled against, read on the first draw
+     after a clear */
+  bool viewport_valid;
+  float viewport_width;
+  float viewport_height;
+
+  /* the batch currently being filled. When it runs out of space it is
+     sealed into 'sealed_batches' and a new one is picked from 'batch_pool'.
+     The chain is submitted in order on flush and recycled on clear. */
   GlrBatch *batch;
+  GQueue *sealed_batches;
+  GQueue *batch_pool;
+
+  /* while a display list is being recorded, the batch and chain of the
+     frame are set aside here */
+  bool recording;
+  GlrBatch *frame_batch;
+  GQueue *frame_sealed_batches;
+
+  /* set on the canvas of a recorder, whose batches are filled without GL
+     calls and only drawn by the canvas it is drawn with. It has no
+     programs */
+  bool deferred;
+
+  /* handles created while recording, and the one draws currently go to,
+     see glr_canvas_begin_retained() */
+  GPtrArray *retained_handles;
+  GlrRetained *retained;
+
+  /* the animation applied to draws, if 'animated'. 'animation_offset' is
+     where it is encoded in the current batch for untransformed draws, if
+     it is. 'time' is what animations are evaluated at when drawing */
+  bool animated;
+  GlrAnimation animation;
+  size_t animation_offset;
+  float time;
+
+  /* the scroll node draws move with, zero meaning none, and the offset of
+     each node when drawing. The first one stays zero */
+  uint32_t scroll_node;
+  float scroll_offsets[GLR_PROGRAM_NUM_SCROLL_NODES][2];
 
   float aa_offset;
   float z_depth;
+  Mat4 persp_matrix;
 
-  GLuint proj_matrix_loc;
-  GLuint transform_matrix_loc;
-  GLuint persp_matrix_loc;
-  GLuint aa_offset_loc;
+  /* global transform, projection and perspective of the current frame */
+  Mat4 view_matrix;
+
+  GlrCanvasStats stats;
 
   GlrTexCache *tex_cache;
 };
 
 static void
-glr_canvas_free (GlrCanvas *self)
+free_sealed_batch (SealedBatch *sealed)
 {
-  glDeleteProgram (self->shader_program);
+  if (sealed->list != NULL)
+    glr_display_list_unref (sealed->list);
+  else if (sealed->recorder != NULL)
+    glr_recorder_unref (sealed->recorder);
+  else
+    glr_batch_unref (sealed->batch);
+
+  g_slice_free (SealedBatch, sealed);
+}
 
+static void
+glr_canvas_free (GlrCanvas *self)
+{
   glr_context_unref (self->context);
   if (self->target != NULL)
     glr_target_unref (self->target);
 
+  if (self->recording)
+    {
+      glr_batch_unref (self->frame_batch);
+      g_queue_free_full (self->frame_sealed_batches,
+                         (GDestroyNotify) free_sealed_batch);
+      g_ptr_array_unref (self->retained_handles);
+    }
+
   glr_batch_unref (self->batch);
+  g_queue_free_full (self->sealed_batches, (GDestroyNotify) free_sealed_batch);
+  g_queue_free_full (self->batch_pool, (GDestroyNotify) glr_batch_unref);
 
   glr_tex_cache_unref (self->tex_cache);
 
+  g_array_unref (self->saved_states);
+  g_array_unref (self->clips);
+
   g_slice_free (GlrCanvas, self);
   self = NULL;
 
@@ -112,115 +317,74 @@ multiply_mat4 (Mat4 a, Mat4 b, Mat4 r)
   memcpy (r, t, sizeof (Mat4));
 }
 
+/* builds the matrix that applies 'transform' to a point: the origin is
+   moved to zero, then the point is scaled, rotated around the z, y and x
+   axes in that order, and moved back to the origin plus the translation.
+   The product is written out in closed form, rather than multiplying the
+   five matrices */
 static void
-matrix_from_transform (GlrTransform *transform, Mat4 result)
+matrix_from_transform (const GlrTransform *transform, Mat4 result)
 {
-  GlrTransform t = *transform;
-  Mat4 mat;
-
-  Mat4 translate_mat = {
-    {                         1.0,                          0.0,                          0.0, 0.0},
-    {                         0.0,                          1.0,                          0.0, 0.0},
-    {                         0.0,                          0.0,                          1.0, 0.0},
-    {t.origin[0] + t.translate[0], t.origin[1] + t.translate[1], t.origin[2] + t.translate[2], 1.0}
-  };
-
-  Mat4 origin_mat = {
-    {         1.0,          0.0,          0.0, 0.0},
-    {         0.0,          1.0,          0.0, 0.0},
-    {         0.0,          0.0,          1.0, 0.0},
-    {-t.origin[0], -t.origin[1], -t.origin[2], 1.0}
-  };
-
-  float a_x = t.rotate[0];
-  float sin_a = sin (a_x);
-  float cos_a = cos (a_x);
-  Mat4 rot_x_mat = {
-    {1.0,    0.0,   0.0, 0.0},
-    {0.0,  cos_a, sin_a, 0.0},
-    {0.0, -sin_a, cos_a, 0.0},
-    {0.0,    0.0,   0.0, 1.0}
-  };
-
-  float a_y = t.rotate[1];
-  sin_a = sin (a_y);
-  cos_a = cos (a_y);
-  Mat4 rot_y_mat = {
-    { cos_a, 0.0, sin_a, 0.0},
-    {   0.0, 1.0,   0.0, 0.0},
-    {-sin_a, 0.0, cos_a, 0.0},
-    {   0.0, 0.0,   0.0, 1.0}
-  };
-
-  float a_z = t.rotate[2];
-  sin_a = sin (a_z);
-  cos_a = cos (a_z);
-  Mat4 rot_z_mat = {
-    { cos_a, sin_a, 0.0, 0.0},
-    {-sin_a, cos_a, 0.0, 0.0},
-    {   0.0,   0.0, 1.0, 0.0},
-    {   0.0,   0.0, 0.0, 1.0}
-  };
+  const GlrTransform *t = transform;
+  float sx = sin (t->rotate[0]), cx = cos (t->rotate[0]);
+  float sy = sin (t->rotate[1]), cy = cos (t->rotate[1]);
+  float sz = sin (t->rotate[2]), cz = cos (t->rotate[2]);
+  Mat4 m;
+  int i;
 
-  Mat4 scale_mat = {
-    { t.scale[0],        0.0,        0.0, 0.0},
-    {        0.0, t.scale[1],        0.0, 0.0},
-    {        0.0,        0.0, t.scale[2], 0.0},
-    {        0.0,        0.0,        0.0, 1.0}
+  // rotation, by rows, times the scale of each column
+  float r[3][3] = {
+    {                cy * cz,               -cy * sz,      -sy },
+    { cx * sz - sx * sy * cz, cx * cz + sx * sy * sz, -sx * cy },
+    { sx * sz + cx * sy * cz, sx * cz - cx * sy * sz,  cx * cy }
   };
 
-  multiply_mat4 (origin_mat, scale_mat, mat);
-  multiply_mat4 (mat, rot_z_mat, mat);
-  multiply_mat4 (mat, rot_y_mat, mat);
-  multiply_mat4 (mat, rot_x_mat, mat);
-  multiply_mat4 (mat, translate_mat, mat);
-
-  copy_mat4 (mat, result);
-}
-
-static bool
-print_shader_log (GLuint shader)
-{
-  GLint length;
-  char buffer[1024] = {0};
-  GLint success;
-
-  glGetShaderiv (shader, GL_INFO_LOG_LENGTH, &length);
-  if (length == 0)
-    return true;
-
-  glGetShaderInfoLog (shader, 1024, NULL, buffer);
-  if (strlen (buffer) > 0)
-    printf ("Shader compilation log: %s\n", buffer);
+  // matrices are stored by columns, as GL expects them
+  for (i = 0; i < 3; i++)
+    {
+      m[0][i] = r[i][0] * t->scale[0];
+      m[1][i] = r[i][1] * t->scale[1];
+      m[2][i] = r[i][2] * t->scale[2];
+      m[3][i] = t->origin[i] + t->translate[i]
+        - m[0][i] * t->origin[0]
+        - m[1][i] * t->origin[1]
+        - m[2][i] * t->origin[2];
+    }
 
-  glGetShaderiv (shader, GL_COMPILE_STATUS, &success);
+  m[0][3] = m[1][3] = m[2][3] = 0.0;
+  m[3][3] = 1.0;
 
-  return success == GL_TRUE;
+  copy_mat4 (m, result);
 }
 
-static GLuint
-load_shader (const char *shader_source, GLenum type)
+static void
+clear_background (GlrCanvas *self)
 {
-  GLuint shader = glCreateShader (type);
-
-  glShaderSource (shader, 1, &shader_source, NULL);
-  glCompileShader (shader);
-
-  print_shader_log (shader);
+  static const uint32_t MASK_8_BIT = 0x000000FF;
 
-  return shader;
+  self->gl->ClearColor ( (self->clear_color >> 24              ) / 255.0,
+                        ((self->clear_color >> 16) & MASK_8_BIT) / 255.0,
+                        ((self->clear_color >>  8) & MASK_8_BIT) / 255.0,
+                        ( self->clear_color        & MASK_8_BIT) / 255.0);
+  glr_context_set_depth_mask (self->context, true);
+  self->gl->Clear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 static void
-clear_background (GlrCanvas *self)
+set_view_matrix (GlrCanvas *self, Mat4 matrix)
 {
-  static const uint32_t MASK_8_BIT = 0x000000FF;
+  int i;
+
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    {
+      GlrProgram *program = &self->programs[i];
 
-  glClearColor ( (self->clear_color >> 24              ) / 255.0,
-                ((self->clear_color >> 16) & MASK_8_BIT) / 255.0,
-                ((self->clear_color >>  8) & MASK_8_BIT) / 255.0,
-                ( self->clear_color        & MASK_8_BIT) / 255.0);
-  glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      glr_context_use_program (self->context, program->program);
+      self->gl->UniformMatrix4fv (program->view_matrix_loc,
+                                  1,
+                                  GL_FALSE,
+                                  &(matrix[0][0]));
+    }
 }
 
 static void
@@ -233,50 +397,60 @@ initialize_frame_if_needed (GlrCanvas *self)
 
   self->frame_initialized = true;
 
+  // the application may have touched GL state since the previous flush
+  glr_context_invalidate_gl_state (self->context);
+
+  // glyphs looked up since the previous flush, possibly from recorders
+  glr_tex_cache_upload_pending (self->tex_cache);
+
   if (self->target != NULL)
     {
-      glBindFramebuffer (GL_FRAMEBUFFER,
-                         glr_target_get_framebuffer (self->target));
+      glr_context_bind_framebuffer (self->context,
+                                    glr_target_get_framebuffer (self->target));
 
       glr_target_get_size (self->target, &width, &height);
 
-      glViewport (0, 0, width, height);
+      self->gl->Viewport (0, 0, width, height);
     }
   else
     {
       GLint viewport[4];
 
-      glGetIntegerv (GL_VIEWPORT, viewport);
+      self->gl->GetIntegerv (GL_VIEWPORT, viewport);
       width = (uint32_t) viewport[2];
       height = (uint32_t) viewport[3];
     }
 
-  glEnable (GL_BLEND);
-  glBlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glEnable (GL_DEPTH_TEST);
-  glDisable (GL_CULL_FACE);
+  glr_context_set_blend (self->context, true);
+  self->gl->BlendFunc (GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glr_context_set_depth_test (self->context, true);
+  self->gl->DepthFunc (GL_LESS);
+  glr_context_set_depth_mask (self->context, true);
+  self->gl->Disable (GL_CULL_FACE);
 
-  glUseProgram (self->shader_program);
+  if (self->target != NULL)
+    {
+      self->opaque_pass = true;
+    }
+  else
+    {
+      GLint depth_bits;
+
+      self->gl->GetIntegerv (GL_DEPTH_BITS, &depth_bits);
+      self->opaque_pass = depth_bits >= 24;
+    }
 
+  // depth values only order the instances of one flush
   if (self->pending_clear)
     {
       clear_background (self);
       self->pending_clear = false;
     }
-
-  /* @FIXME: get the glyph texture ids from texture cache,
-     instead of hardcoding it here */
-  int i;
-  for (i = 0; i < 8; i++)
+  else
     {
-      GLuint loc;
-      char *st;
-
-      st = g_strdup_printf ("glyph_cache[%d]", i);
-      loc = glGetUniformLocation (self->shader_program, st);
-      glUniform1i (loc, i);
-      g_free (st);
+      self->gl->Clear (GL_DEPTH_BUFFER_BIT);
     }
+  self->next_depth = 0;
 
   // projection matrix
   Mat4 proj_matrix = {
@@ -285,13 +459,6 @@ initialize_frame_if_needed (GlrCanvas *self)
     {        0.0,           0.0, 2.0 / self->z_depth, 0.0},
     {       -1.0,           1.0,                 0.0, 1.0}
   };
-  glUniformMatrix4fv (self->proj_matrix_loc,
-                      1,
-                      GL_FALSE,
-                      &(proj_matrix[0][0]));
-
-  // @FIXME:
-  Mat4 transform_matrix;
   GlrTransform t;
 
   // @FIXME: do this only if perspective is enabled
@@ -299,422 +466,2106 @@ initialize_frame_if_needed (GlrCanvas *self)
   t.translate[2] += -(self->z_depth / 2.0);
 
   // canvas' global transform matrix
-  matrix_from_transform (&t, transform_matrix);
-  glUniformMatrix4fv (self->transform_matrix_loc,
-                      1,
-                      GL_FALSE,
-                      &(transform_matrix[0][0]));
+  matrix_from_transform (&t, self->view_matrix);
+
+  // the global transform, projection and perspective are applied to every
+  // vertex, so they are multiplied into a single matrix once per frame
+  multiply_mat4 (self->view_matrix, proj_matrix, self->view_matrix);
+  multiply_mat4 (self->view_matrix, self->persp_matrix, self->view_matrix);
+
+  set_view_matrix (self, self->view_matrix);
+
+  int i;
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    {
+      GlrProgram *program = &self->programs[i];
+
+      glr_context_use_program (self->context, program->program);
+
+      // the program may have been used last by a canvas configured
+      // differently
+      if (program->aa_offset != self->aa_offset)
+        {
+          self->gl->Uniform1f (program->aa_offset_loc, self->aa_offset);
+          program->aa_offset = self->aa_offset;
+        }
+
+      if (program->time != self->time)
+        {
+          self->gl->Uniform1f (program->time_loc, self->time);
+          program->time = self->time;
+        }
+
+      if (memcmp (program->scroll_offsets,
+                  self->scroll_offsets,
+                  sizeof (self->scroll_offsets)) != 0)
+        {
+          self->gl->Uniform2fv (program->scroll_offsets_loc,
+                                GLR_PROGRAM_NUM_SCROLL_NODES,
+                                &self->scroll_offsets[0][0]);
+          memcpy (program->scroll_offsets,
+                  self->scroll_offsets,
+                  sizeof (self->scroll_offsets));
+        }
+    }
 }
 
 static void
-encode_and_store_transform (GlrCanvas         *self,
-                            float              left,
-                            float              top,
-                            GlrTransform      *transform,
-                            GlrInstanceConfig  config)
+draw_batch (GlrCanvas *self, GlrBatch *batch)
 {
-  GlrTransform t;
+  size_t num_instances = glr_batch_get_num_instances (batch);
 
-  if (self->current_transform_index > 0)
+  // start over when running out of depth values. Everything drawn so far
+  // is behind what comes next anyway
+  if (self->next_depth + num_instances > GLR_BATCH_DEPTH_SLOTS)
     {
-      config[1] = self->current_transform_index;
-      return;
+      glr_context_set_depth_mask (self->context, true);
+      self->gl->Clear (GL_DEPTH_BUFFER_BIT);
+      self->next_depth = 0;
     }
 
-  memcpy (&t, transform, sizeof (GlrTransform));
-  t.origin[0] += left;
-  t.origin[1] += top;
-
-  Mat4 transform_matrix;
-  size_t offset;
+  glr_batch_draw (batch,
+                  self->programs,
+                  self->next_depth,
+                  self->opaque_pass);
 
-  // printf ("new transform encoded\n");
-
-  matrix_from_transform (&t, transform_matrix);
-  offset = glr_batch_add_dyn_attr (self->batch,
-                                   &(transform_matrix[0][0]),
-                                   sizeof (Mat4));
-  config[1] = offset;
-  self->current_transform_index = offset;
+  self->next_depth += num_instances;
 }
 
-static bool
-has_any_transform (const GlrTransform *transform)
+static void
+recycle_batch (GlrBatch *batch, GQueue *pool)
 {
-  return
-    UNEQUALS (transform->rotate[0], 0.0)
-    || UNEQUALS (transform->rotate[1], 0.0)
-    || UNEQUALS (transform->rotate[2], 0.0)
+  glr_batch_reset (batch);
+  g_queue_push_tail (pool, batch);
+}
 
-    || UNEQUALS (transform->scale[0], 1.0)
-    || UNEQUALS (transform->scale[1], 1.0)
-    || UNEQUALS (transform->scale[2], 1.0)
+static void
+seal_batch (GlrCanvas *self, GlrBatch *batch)
+{
+  SealedBatch *sealed = g_slice_new0 (SealedBatch);
 
-    || UNEQUALS (transform->translate[0], 0.0)
-    || UNEQUALS (transform->translate[1], 0.0)
-    || UNEQUALS (transform->translate[2], 0.0);
+  sealed->batch = batch;
+  g_queue_push_tail (self->sealed_batches, sealed);
 }
 
+/* the batches of a recorder are those of its canvas, in the same order
+   as that canvas would draw them */
 static void
-instance_config_set_type (GlrInstanceConfig config, GlrInstanceType type)
+draw_recorder (GlrCanvas *self, GlrRecorder *recorder)
 {
-  /* bits 26 to 29 (4 bits) of config0 encode the instance type */
-  config[0] = (config[0] & INSTANCE_TYPE_MASK) | (type << 26);
+  GlrCanvas *deferred = glr_recorder_get_canvas (recorder);
+  GList *node;
+
+  for (node = deferred->sealed_batches->head; node != NULL; node = node->next)
+    draw_batch (self, ((SealedBatch *) node->data)->batch);
+
+  draw_batch (self, deferred->batch);
 }
 
 static void
-encode_and_store_border (GlrBatch          *batch,
-                         GlrBorder         *border,
-                         GlrInstanceConfig  config)
+draw_sealed_batch (GlrCanvas *self, SealedBatch *sealed)
 {
-  size_t offset;
-  float buf[16] = {0};
-  uint8_t num_samples = 0;
+  GPtrArray *batches;
+  Mat4 view_matrix;
+  guint i;
 
-  bool all_style_equal;
-  bool all_width_equal;
-  bool all_radius_equal;
-  bool all_color_equal;
+  if (sealed->recorder != NULL)
+    {
+      draw_recorder (self, sealed->recorder);
+      return;
+    }
 
-  all_style_equal = border->style[0] == border->style[1]
-    && border->style[0] == border->style[2]
-    && border->style[0] == border->style[3];
+  if (sealed->list == NULL)
+    {
+      draw_batch (self, sealed->batch);
+      return;
+    }
 
-  all_width_equal = EQUALS (border->width[0], border->width[1])
-    && EQUALS (border->width[0], border->width[2])
-    && EQUALS (border->width[0], border->width[3]);
+  multiply_mat4 (sealed->matrix, self->view_matrix, view_matrix);
+  set_view_matrix (self, view_matrix);
 
-  all_radius_equal = EQUALS (border->radius[0], border->radius[1])
-    && EQUALS (border->radius[0], border->radius[2])
-    && EQUALS (border->radius[0], border->radius[3]);
+  batches = glr_display_list_get_batches (sealed->list);
+  for (i = 0; i < batches->len; i++)
+    draw_batch (self, g_ptr_array_index (batches, i));
 
-  all_color_equal = border->color[0] == border->color[1]
-    && border->color[0] == border->color[2]
-    && border->color[0] == border->color[3];
+  set_view_matrix (self, self->view_matrix);
+}
 
-  /* the simplest case: style, width, radius and color of all borders are equal */
-  if (all_style_equal && all_width_equal && all_radius_equal && all_color_equal)
+/* batches go back to the pool, while display lists and recorders are only
+   released */
+static void
+recycle_sealed_batch (SealedBatch *sealed, GQueue *pool)
+{
+  if (sealed->list != NULL)
+    glr_display_list_unref (sealed->list);
+  else if (sealed->recorder != NULL)
+    glr_recorder_unref (sealed->recorder);
+  else
+    recycle_batch (sealed->batch, pool);
+
+  g_slice_free (SealedBatch, sealed);
+}
+
+static GlrBatch *
+pop_batch_with_room (GQueue            *pool,
+                     GlrInstanceFormat  format,
+                     size_t             num_instances,
+                     size_t             num_dyn_attr_samples)
+{
+  GList *node;
+
+  for (node = pool->head; node != NULL; node = node->next)
     {
-      /* this case is encoded in 1 dyn attr sample */
-      buf[0] = border->style[0];
-      buf[1] = border->width[0];
-      buf[2] = border->radius[0];
-      buf[3] = border->color[0];
+      GlrBatch *batch = node->data;
 
-      num_samples = 1;
+      // pooled batches are empty, so their format can change
+      glr_batch_set_instance_format (batch, format);
+
+      if (glr_batch_has_room (batch, num_instances, num_dyn_attr_samples))
+        {
+          g_queue_delete_link (pool, node);
+          return batch;
+        }
     }
 
-  if (num_samples == 0)
-    return;
+  return NULL;
+}
 
-  /* bits 20 to 23 (4 bits) of config0 encode the number of samples
-     that describe the border */
-  config[0] = (config[0] & BORDER_NUM_SAMPLES_MASK) | (num_samples << 20);
+/* the format to store an area in. Anything fits in a full format batch */
+static GlrInstanceFormat
+instance_format_for_area (GlrCanvas *self,
+                          float      left,
+                          float      top,
+                          float      width,
+                          float      height)
+{
+  GlrLayout area;
 
-  offset = glr_batch_add_dyn_attr (batch,
-                                   buf,
-                                   sizeof (float) * 4 * num_samples);
+  if (self->instance_format == GLR_INSTANCE_FORMAT_FULL)
+    return GLR_INSTANCE_FORMAT_FULL;
 
-  /* config2 encodes the offset of the border description */
-  config[2] = offset;
+  area.left = left - self->aa_offset;
+  area.top = top - self->aa_offset;
+  area.width = width + self->aa_offset * 2.0;
+  area.height = height + self->aa_offset * 2.0;
+
+  if (glr_batch_layout_fits_compact (&area))
+    return GLR_INSTANCE_FORMAT_COMPACT;
+  else
+    return GLR_INSTANCE_FORMAT_FULL;
 }
 
-static void
-glr_color_decompose_float (GlrColor color, GlrColor4f color_4f)
+static bool
+batch_accepts (GlrBatch          *batch,
+               GlrInstanceFormat  format,
+               size_t             num_instances,
+               size_t             num_dyn_attr_samples)
 {
-  color_4f[0] = ((color >> 24) & 0xFF) / 255.0;
-  color_4f[1] = ((color >> 16) & 0xFF) / 255.0;
-  color_4f[2] = ((color >>  8) & 0xFF) / 255.0;
-  color_4f[3] = (color         & 0xFF) / 255.0;
+  if (format == GLR_INSTANCE_FORMAT_FULL
+      && glr_batch_get_instance_format (batch) != GLR_INSTANCE_FORMAT_FULL)
+    {
+      return false;
+    }
+
+  return glr_batch_has_room (batch, num_instances, num_dyn_attr_samples);
 }
 
+/* dyn attr offsets are local to a batch, so transforms encoded in a
+   previous one cannot be reused */
 static void
-encode_and_store_background (GlrBatch          *batch,
-                             GlrBackground     *bg,
-                             GlrInstanceConfig  config)
+forget_encoded_transforms (GlrCanvas *self)
 {
-  goffset offset;
-  float buf[16] = {0};
-  uint8_t num_samples = 0;
+  guint i;
 
-  if (bg->type == GLR_BACKGROUND_LINEAR_GRADIENT)
-    {
-      // pre-calculate linear gradient values
-      const float SEMI_DIAG_LENGTH = sqrt ((0.5*0.5)*2.0);
-      float angle = bg->linear_grad_angle;
+  self->current_transform_index = 0;
+  self->base_offset = 0;
+  self->animation_offset = 0;
 
-      if (angle < 0.0)
-        angle = M_PI*2.0 - fmod (fabs (angle), M_PI * 2.0);
-      else
-        angle = fmod (angle, M_PI * 2.0);
+  for (i = 0; i < TRANSFORM_CACHE_SIZE; i++)
+    self->transform_cache[i].offset = 0;
 
-      float gamma = M_PI/2.0;
-      if (angle < M_PI/2.0)
-        gamma -= angle;
-      else if (angle < M_PI)
-        gamma -= angle - M_PI/2.0;
-      else if (angle < M_PI/2.0*3.0)
-        gamma -= angle - M_PI;
-      else
-        gamma -= angle - M_PI/2.0*3.0;
+  for (i = 0; i < self->saved_states->len; i++)
+    g_array_index (self->saved_states, SavedState, i).base_offset = 0;
 
-      float beta = M_PI/4.0 + gamma;
-      float length = SEMI_DIAG_LENGTH * sin (beta) * 2.0;
+  for (i = 0; i < self->clips->len; i++)
+    g_array_index (self->clips, ClipState, i).offset = 0;
+}
 
-      buf[0] = angle;
-      buf[1] = length;
-      buf[2] = gamma;
+static GlrBatch *
+new_batch (GlrCanvas *self, GlrInstanceFormat format)
+{
+  GlrBatch *batch;
 
-      GlrColor4f color0, color1;
-      glr_color_decompose_float (bg->linear_grad_colors[0], color0);
-      glr_color_decompose_float (bg->linear_grad_colors[1], color1);
+  if (self->deferred)
+    batch = glr_batch_new_deferred (self->context);
+  else
+    batch = glr_batch_new (self->context);
 
-      memcpy (&(buf[4]), color0, sizeof (GlrColor4f));
-      memcpy (&(buf[8]), color1, sizeof (GlrColor4f));
+  glr_batch_set_instance_format (batch, format);
 
-      num_samples = 3;
-    }
+  return batch;
+}
 
-  if (num_samples == 0)
+static void
+ensure_batch_room (GlrCanvas         *self,
+                   GlrInstanceFormat  format,
+                   size_t             num_instances,
+                   size_t             num_dyn_attr_samples)
+{
+  GlrBatch *batch;
+
+  if (batch_accepts (self->batch, format, num_instances, num_dyn_attr_samples))
     return;
 
-  // bits 16 to 19 (4 bits) of config0 encode the number of samples to describe
-  // the background
-  config[0] = (config[0] & BACKGROUND_NUM_SAMPLES_MASK) | (num_samples << 16);
+  // a new batch takes the canvas' format, unless the draw needs the full one
+  if (format == GLR_INSTANCE_FORMAT_COMPACT)
+    format = self->instance_format;
 
-  offset = glr_batch_add_dyn_attr (batch,
-                                   buf,
-                                   sizeof (float) * 4 * num_samples);
+  seal_batch (self, self->batch);
 
-  // config3 encodes the offset of the background description
-  config[3] = offset;
+  forget_encoded_transforms (self);
+
+  batch = pop_batch_with_room (self->batch_pool,
+                               format,
+                               num_instances,
+                               num_dyn_attr_samples);
+  if (batch == NULL)
+    {
+      batch = new_batch (self, format);
+      if (glr_batch_has_room (batch, num_instances, num_dyn_attr_samples))
+        {
+          self->batch = batch;
+          return;
+        }
+
+      // the batches of a display list being recorded must all be kept, and
+      // those of a recorder cannot be drawn from here
+      if (self->recording || self->deferred)
+        {
+          g_warning ("Dynamic attributes memory limit reached while recording.");
+          self->batch = batch;
+          return;
+        }
+
+      g_queue_push_tail (self->batch_pool, batch);
+
+      /* the context's dyn attrs memory limit was reached. Submit the chain
+         right away so its batches can be reused for the rest of the frame.
+         Note that later flushes of this frame will not draw them again. */
+      initialize_frame_if_needed (self);
+
+      while (! g_queue_is_empty (self->sealed_batches))
+        {
+          SealedBatch *sealed = g_queue_pop_head (self->sealed_batches);
+
+          draw_sealed_batch (self, sealed);
+          if (sealed->batch != NULL)
+            self->stats.fence_waits +=
+              glr_batch_get_num_fence_waits (sealed->batch);
+          recycle_sealed_batch (sealed, self->batch_pool);
+        }
+
+      self->frame_initialized = false;
+
+      batch = pop_batch_with_room (self->batch_pool,
+                                   format,
+                                   num_instances,
+                                   num_dyn_attr_samples);
+      if (batch == NULL)
+        {
+          g_warning ("Dynamic attributes memory limit is too small for a single draw.");
+          batch = g_queue_pop_head (self->batch_pool);
+        }
+    }
+
+  self->batch = batch;
 }
 
+/* whether an instance takes the color of a background or a glyph, rather
+   than that of a border */
 static bool
-has_any_border (const GlrBorder *border)
+instance_is_fill (const uint32_t *config)
 {
-  return UNEQUALS (border->width[0], 0.0)
-    || UNEQUALS (border->width[1], 0.0)
-    || UNEQUALS (border->width[2], 0.0)
-    || UNEQUALS (border->width[3], 0.0)
+  GlrInstanceType type = (config[0] >> 26) & 0x0F;
 
-    || UNEQUALS (border->radius[0], 0.0)
-    || UNEQUALS (border->radius[1], 0.0)
-    || UNEQUALS (border->radius[2], 0.0)
-    || UNEQUALS (border->radius[3], 0.0);
+  return type == GLR_INSTANCE_RECT_BG
+    || type == GLR_INSTANCE_CHAR_GLYPH
+    || type == GLR_INSTANCE_BOX
+    || type == GLR_INSTANCE_RECT_ALIGNED;
 }
 
-/* internal API */
-
-/* public API */
-
-GlrCanvas *
-glr_canvas_new (GlrContext *context, GlrTarget *target)
+/* whether draws go into the current retained handle. Their transform is
+   encoded along with the origin they were drawn at, so only translated
+   ones can be moved afterwards */
+static bool
+is_retaining (GlrCanvas *self)
 {
-  GlrCanvas *self;
+  return self->retained != NULL
+    && self->effective_class < TRANSFORM_AFFINE_2D;
+}
 
-  GLuint vertex_shader;
-  GLuint fragment_shader;
+/* adds instances to the current batch, and to the current retained
+   handle if any. Translations are expected to be applied to the layouts
+   already, see apply_translation() */
+static void
+add_instances (GlrCanvas               *self,
+               GlrInstanceClass         klass,
+               size_t                   count,
+               const GlrLayout         *layouts,
+               const GlrColor          *colors,
+               const GlrInstanceConfig *configs,
+               bool                     shared_config)
+{
+  float translation[2] = { 0.0, 0.0 };
+  size_t index;
+  size_t i;
 
-  assert (context != NULL);
+  if (! is_retaining (self))
+    {
+      glr_batch_add_instances (self->batch,
+                               klass,
+                               count,
+                               layouts,
+                               colors,
+                               configs,
+                               shared_config);
+      return;
+    }
+
+  if (self->effective_class == TRANSFORM_TRANSLATE)
+    memcpy (translation, self->effective_translation, sizeof (translation));
+
+  glr_batch_set_movable (self->batch, true);
+  index = glr_batch_get_num_class_instances (self->batch, klass);
+
+  count = glr_batch_add_instances (self->batch,
+                                   klass,
+                                   count,
+                                   layouts,
+                                   colors,
+                                   configs,
+                                   shared_config);
+
+  for (i = 0; i < count; i++)
+    {
+      const uint32_t *config = configs[shared_config ? 0 : i];
+
+      glr_retained_add_instance (self->retained,
+                                 self->batch,
+                                 klass,
+                                 index + i,
+                                 &layouts[i],
+                                 translation[0],
+                                 translation[1],
+                                 instance_is_fill (config));
+    }
+}
+
+static void
+add_instance (GlrCanvas               *self,
+              GlrInstanceClass         klass,
+              const GlrLayout         *layout,
+              GlrColor                 color,
+              const GlrInstanceConfig  config)
+{
+  add_instances (self,
+                 klass,
+                 1,
+                 layout,
+                 &color,
+                 (const GlrInstanceConfig *) config,
+                 true);
+}
+
+static void
+retain_area (GlrCanvas *self,
+             float      left,
+             float      top,
+             float      width,
+             float      height)
+{
+  if (self->retained == NULL)
+    return;
+
+  if (! is_retaining (self))
+    {
+      g_warning ("Draws under a rotation, scale or 3D transform can't be "
+                 "retained, drawing as usual.");
+      return;
+    }
+
+  glr_retained_add_area (self->retained, left, top, width, height);
+}
+
+/* makes an empty batch current, for what is drawn after the chain */
+static void
+start_new_batch (GlrCanvas *self)
+{
+  GlrBatch *batch;
+
+  batch = pop_batch_with_room (self->batch_pool, self->instance_format, 0, 0);
+  if (batch == NULL)
+    batch = new_batch (self, self->instance_format);
+
+  self->batch = batch;
+  forget_encoded_transforms (self);
+}
+
+/* stores a dyn attr block in the current batch, reusing an identical one
+   if it was already stored */
+static size_t
+store_dyn_attr (GlrCanvas *self, const void *attr_data, size_t size)
+{
+  size_t offset;
+  bool interned;
+
+  offset = glr_batch_add_dyn_attr_interned (self->batch,
+                                            attr_data,
+                                            size,
+                                            &interned);
+  if (interned)
+    self->stats.dyn_attrs_intern_hits++;
+  else
+    self->stats.dyn_attrs_intern_misses++;
+
+  return offset;
+}
+
+static guint
+transform_hash (const GlrTransform *transform,
+                uint32_t            base_id,
+                uint32_t            clip_id)
+{
+  const uint8_t *data = (const uint8_t *) transform;
+  guint hash = 2166136261u;
+  size_t i;
+
+  for (i = 0; i < sizeof (GlrTransform); i++)
+    hash = (hash ^ data[i]) * 16777619u;
+
+  hash = (hash ^ base_id) * 16777619u;
+
+  return hash ^ clip_id;
+}
+
+static ClipState *
+get_current_clip (GlrCanvas *self)
+{
+  if (self->clips->len == 0)
+    return NULL;
+
+  return &g_array_index (self->clips, ClipState, self->clips->len - 1);
+}
+
+static TransformClass
+classify_transform (const GlrTransform *transform)
+{
+  // the z a point of the canvas plane ends up at, as long as it is not
+  // rotated around the x or y axes
+  float z = transform->origin[2] * (1.0 - transform->scale[2])
+    + transform->translate[2];
+
+  if (UNEQUALS (transform->rotate[0], 0.0)
+      || UNEQUALS (transform->rotate[1], 0.0)
+      || UNEQUALS (z, 0.0))
+    {
+      return TRANSFORM_3D;
+    }
+
+  if (UNEQUALS (transform->rotate[2], 0.0)
+      || UNEQUALS (transform->scale[0], 1.0)
+      || UNEQUALS (transform->scale[1], 1.0))
+    {
+      return TRANSFORM_AFFINE_2D;
+    }
+
+  if (UNEQUALS (transform->translate[0], 0.0)
+      || UNEQUALS (transform->translate[1], 0.0))
+    {
+      return TRANSFORM_TRANSLATE;
+    }
+
+  return TRANSFORM_IDENTITY;
+}
+
+/* same as classify_transform(), for a composed matrix. Points of the
+   canvas plane have a z of zero, so the third column does not matter */
+static TransformClass
+classify_matrix (Mat4 m)
+{
+  if (UNEQUALS (m[0][2], 0.0)
+      || UNEQUALS (m[1][2], 0.0)
+      || UNEQUALS (m[3][2], 0.0)
+      || UNEQUALS (m[0][3], 0.0)
+      || UNEQUALS (m[1][3], 0.0)
+      || UNEQUALS (m[3][3], 1.0))
+    {
+      return TRANSFORM_3D;
+    }
+
+  if (UNEQUALS (m[0][0], 1.0)
+      || UNEQUALS (m[0][1], 0.0)
+      || UNEQUALS (m[1][0], 0.0)
+      || UNEQUALS (m[1][1], 1.0))
+    {
+      return TRANSFORM_AFFINE_2D;
+    }
+
+  if (UNEQUALS (m[3][0], 0.0) || UNEQUALS (m[3][1], 0.0))
+    return TRANSFORM_TRANSLATE;
+
+  return TRANSFORM_IDENTITY;
+}
+
+/* to be called whenever the current transform or the saved levels change */
+static void
+update_transform_class (GlrCanvas *self)
+{
+  self->transform_class = classify_transform (&self->transform);
+  self->current_transform_index = 0;
+
+  // the animation of untransformed draws has the translation in its origin
+  self->animation_offset = 0;
+
+  self->effective_translation[0] = self->transform.translate[0];
+  self->effective_translation[1] = self->transform.translate[1];
+
+  if (self->base_class == TRANSFORM_IDENTITY)
+    {
+      self->effective_class = self->transform_class;
+    }
+  else if (self->base_class <= TRANSFORM_TRANSLATE
+           && self->transform_class <= TRANSFORM_TRANSLATE)
+    {
+      self->effective_class = TRANSFORM_TRANSLATE;
+      self->effective_translation[0] += self->base_matrix[3][0];
+      self->effective_translation[1] += self->base_matrix[3][1];
+    }
+  else
+    {
+      self->effective_class = MAX (self->base_class, self->transform_class);
+    }
+}
+
+/* the matrix of the current transform applied from 'origin_x', 'origin_y',
+   composed with the saved levels */
+static void
+get_effective_matrix (GlrCanvas *self,
+                      float      origin_x,
+                      float      origin_y,
+                      Mat4       result)
+{
+  GlrTransform t;
+
+  memcpy (&t, &self->transform, sizeof (GlrTransform));
+  t.origin[0] += origin_x;
+  t.origin[1] += origin_y;
+  matrix_from_transform (&t, result);
+
+  if (self->base_class != TRANSFORM_IDENTITY)
+    multiply_mat4 (result, self->base_matrix, result);
+}
+
+/* a translation is cheaper to add to the position of what is drawn than
+   to encode, and it does not depend on the origin */
+static void
+apply_translation (GlrCanvas *self, float *left, float *top)
+{
+  if (self->effective_class != TRANSFORM_TRANSLATE)
+    return;
+
+  *left += self->effective_translation[0];
+  *top += self->effective_translation[1];
+}
+
+/* appends the current clip and animation, if any, to the dyn attr block
+   of a draw, and returns the flags of config1 telling about them. The
+   animation is a 5-sample dyn attr: its timing, the rotation and opacity,
+   the scale and the translation it goes from and to, and its origin along
+   with whether a transform follows. Must match the vertex shader */
+static uint32_t
+append_clip_and_animation (GlrCanvas *self,
+                           bool       has_transform,
+                           float     *data,
+                           size_t    *num_floats)
+{
+  ClipState *clip = get_current_clip (self);
+  const GlrAnimation *a = &self->animation;
+  uint32_t flags = 0;
+
+  if (clip != NULL)
+    {
+      memcpy (data, clip->rect, sizeof (clip->rect));
+      memcpy (data + 4, clip->radii, sizeof (clip->radii));
+      *num_floats = 8;
+      flags |= GLR_INSTANCE_CLIP_FLAG;
+    }
+
+  if (self->animated)
+    {
+      float origin[2] = { a->origin[0], a->origin[1] };
+
+      // untransformed draws already have the translation in their layout
+      apply_translation (self, &origin[0], &origin[1]);
+
+      float animation[ANIMATION_NUM_SAMPLES * 4] = {
+        a->start_time, a->duration, a->iterations,
+        (a->alternate ? 1 : 0)
+        | (a->timing == GLR_ANIMATION_EASE_IN_OUT ? 2 : 0),
+        a->from.rotate, a->to.rotate, a->from.opacity, a->to.opacity,
+        a->from.scale[0], a->from.scale[1], a->to.scale[0], a->to.scale[1],
+        a->from.translate[0], a->from.translate[1],
+        a->to.translate[0], a->to.translate[1],
+        origin[0], origin[1], has_transform ? 1.0 : 0.0, 0.0
+      };
+
+      memcpy (data + *num_floats, animation, sizeof (animation));
+      *num_floats += ANIMATION_NUM_SAMPLES * 4;
+      flags |= GLR_INSTANCE_ANIMATION_FLAG;
+    }
+
+  return flags;
+}
+
+/* the current clip and animation, if any, go right before the matrix */
+static size_t
+store_transform_matrix (GlrCanvas *self, Mat4 matrix)
+{
+  float data[8 + ANIMATION_NUM_SAMPLES * 4 + 16];
+  size_t num_floats = 0;
+  uint32_t flags;
+
+  self->stats.transforms_encoded++;
+
+  flags = append_clip_and_animation (self, true, data, &num_floats);
+
+  // a 2D affine transform only needs the 2x2 linear part and the
+  // translation in x and y
+  if (self->effective_class == TRANSFORM_AFFINE_2D)
+    {
+      float affine[8] = {
+        matrix[0][0], matrix[0][1],
+        matrix[1][0], matrix[1][1],
+        matrix[3][0], matrix[3][1],
+        0.0, 0.0
+      };
+
+      memcpy (data + num_floats, affine, sizeof (affine));
+      num_floats += 8;
+      flags |= TRANSFORM_AFFINE_2D_FLAG;
+    }
+  else
+    {
+      memcpy (data + num_floats, &(matrix[0][0]), sizeof (Mat4));
+      num_floats += 16;
+    }
+
+  return store_dyn_attr (self, data, num_floats * sizeof (float)) | flags;
+}
+
+static void
+encode_and_store_transform (GlrCanvas         *self,
+                            float              left,
+                            float              top,
+                            GlrInstanceConfig  config)
+{
+  GlrTransform t;
+  TransformCacheEntry *entry;
+  Mat4 transform_matrix;
+  size_t offset;
+
+  if (self->current_transform_index > 0)
+    {
+      config[1] = self->current_transform_index;
+      self->stats.transforms_reused++;
+      return;
+    }
+
+  if (self->transform_class == TRANSFORM_IDENTITY)
+    {
+      // only the saved levels apply, which do not depend on the origin
+      if (self->base_offset == 0)
+        self->base_offset = store_transform_matrix (self, self->base_matrix);
+      else
+        self->stats.transforms_reused++;
+
+      offset = self->base_offset;
+    }
+  else
+    {
+      memcpy (&t, &self->transform, sizeof (GlrTransform));
+      t.origin[0] += left;
+      t.origin[1] += top;
+
+      // the same transform applied from the same origin, on top of the same
+      // saved levels, was already encoded
+      entry = &self->transform_cache[transform_hash (&t,
+                                                     self->base_id,
+                                                     self->clip_id)
+                                     % TRANSFORM_CACHE_SIZE];
+      if (entry->offset > 0
+          && entry->base_id == self->base_id
+          && entry->clip_id == self->clip_id
+          && memcmp (&entry->transform, &t, sizeof (GlrTransform)) == 0)
+        {
+          offset = entry->offset;
+          self->stats.transforms_reused++;
+        }
+      else
+        {
+          get_effective_matrix (self, left, top, transform_matrix);
+          offset = store_transform_matrix (self, transform_matrix);
+
+          memcpy (&entry->transform, &t, sizeof (GlrTransform));
+          entry->base_id = self->base_id;
+          entry->clip_id = self->clip_id;
+          entry->offset = offset;
+        }
+    }
+
+  config[1] = offset;
+  self->current_transform_index = offset;
+  self->current_transform_origin[0] = left;
+  self->current_transform_origin[1] = top;
+}
+
+static GlrColor
+apply_opacity (GlrCanvas *self, GlrColor color)
+{
+  uint32_t alpha;
+
+  if (self->opacity >= 1.0)
+    return color;
+
+  alpha = lrintf ((color & 0xFF) * self->opacity);
+
+  return (color & 0xFFFFFF00) | alpha;
+}
+
+/* returns 'style', or a copy of it in 'faded' with its colors faded by the
+   canvas' opacity */
+static GlrStyle *
+apply_opacity_to_style (GlrCanvas *self, GlrStyle *style, GlrStyle *faded)
+{
+  int i;
+
+  if (self->opacity >= 1.0)
+    return style;
+
+  memcpy (faded, style, sizeof (GlrStyle));
+
+  faded->background.color = apply_opacity (self, style->background.color);
+  for (i = 0; i < 2; i++)
+    faded->background.linear_grad_colors[i] =
+      apply_opacity (self, style->background.linear_grad_colors[i]);
+
+  for (i = 0; i < 4; i++)
+    faded->border.color[i] = apply_opacity (self, style->border.color[i]);
+
+  return faded;
+}
+
+static void
+update_viewport_if_needed (GlrCanvas *self)
+{
+  if (self->viewport_valid)
+    return;
+
+  if (self->target != NULL)
+    {
+      uint32_t width, height;
+
+      glr_target_get_size (self->target, &width, &height);
+      self->viewport_width = width;
+      self->viewport_height = height;
+    }
+  else
+    {
+      GLint viewport[4];
+
+      self->gl->GetIntegerv (GL_VIEWPORT, viewport);
+      self->viewport_width = viewport[2];
+      self->viewport_height = viewport[3];
+    }
+
+  self->viewport_valid = true;
+}
+
+/* conservative test of whether an area, drawn with the canvas' current
+   transform applied from 'origin_x', 'origin_y', lands completely outside
+   the viewport or the current clip. Areas that may come out of the canvas
+   plane are never culled, since perspective is involved. Translations are
+   expected to be applied to the area already, see apply_translation() */
+static bool
+area_is_culled (GlrCanvas *self,
+                float      left,
+                float      top,
+                float      right,
+                float      bottom,
+                float      origin_x,
+                float      origin_y)
+{
+  ClipState *clip;
+
+  // retained, animated or scrolled draws may end up anywhere
+  if (self->effective_class == TRANSFORM_3D
+      || self->retained != NULL
+      || self->animated
+      || self->scroll_node != 0)
+    {
+      return false;
+    }
+
+  if (self->effective_class == TRANSFORM_AFFINE_2D)
+    {
+      Mat4 m;
+      float x[4] = { left, right, right, left };
+      float y[4] = { top, top, bottom, bottom };
+      int i;
+
+      get_effective_matrix (self, origin_x, origin_y, m);
+
+      left = top = INFINITY;
+      right = bottom = -INFINITY;
+      for (i = 0; i < 4; i++)
+        {
+          float tx = x[i] * m[0][0] + y[i] * m[1][0] + m[3][0];
+          float ty = x[i] * m[0][1] + y[i] * m[1][1] + m[3][1];
+
+          left = MIN (left, tx);
+          top = MIN (top, ty);
+          right = MAX (right, tx);
+          bottom = MAX (bottom, ty);
+        }
+    }
+
+  clip = get_current_clip (self);
+  if (clip != NULL
+      && (right <= clip->rect[0]
+          || bottom <= clip->rect[1]
+          || left >= clip->rect[2]
+          || top >= clip->rect[3]))
+    {
+      return true;
+    }
+
+  // a display list may be drawn anywhere, and the canvas of a recorder has
+  // no viewport of its own
+  if (self->recording || self->deferred)
+    return false;
+
+  update_viewport_if_needed (self);
+
+  return right <= 0.0
+    || bottom <= 0.0
+    || left >= self->viewport_width
+    || top >= self->viewport_height;
+}
+
+/* whether an untransformed area is inside the current clip, away from its
+   rounded corners, so it can be drawn unclipped */
+static bool
+area_is_inside_clip (GlrCanvas *self,
+                     float      left,
+                     float      top,
+                     float      right,
+                     float      bottom)
+{
+  ClipState *clip = get_current_clip (self);
+  const float *r;
+  const float *radii;
+
+  if (clip == NULL)
+    return true;
+
+  r = clip->rect;
+  radii = clip->radii;
+
+  if (left < r[0] || top < r[1] || right > r[2] || bottom > r[3])
+    return false;
+
+  // the square of each rounded corner
+  return ! ((left < r[0] + radii[0] && top < r[1] + radii[0])
+            || (right > r[2] - radii[1] && top < r[1] + radii[1])
+            || (left < r[0] + radii[2] && bottom > r[3] - radii[2])
+            || (right > r[2] - radii[3] && bottom > r[3] - radii[3]));
+}
+
+/* the current clip alone, for untransformed draws. It is encoded once per
+   batch */
+static void
+encode_and_store_clip (GlrCanvas *self, GlrInstanceConfig config)
+{
+  ClipState *clip = get_current_clip (self);
+  float data[8];
+
+  if (clip->offset == 0)
+    {
+      memcpy (data, clip->rect, sizeof (clip->rect));
+      memcpy (data + 4, clip->radii, sizeof (clip->radii));
+      clip->offset = store_dyn_attr (self, data, sizeof (data));
+    }
+
+  config[1] = clip->offset
+    | GLR_INSTANCE_CLIP_FLAG
+    | GLR_INSTANCE_CLIP_ONLY_FLAG;
+}
+
+/* the current animation for untransformed draws, after the clip if any.
+   It is encoded once per batch */
+static void
+encode_and_store_animation (GlrCanvas *self, GlrInstanceConfig config)
+{
+  float data[8 + ANIMATION_NUM_SAMPLES * 4];
+  size_t num_floats = 0;
+  uint32_t flags;
+
+  if (self->animation_offset == 0)
+    {
+      flags = append_clip_and_animation (self, false, data, &num_floats);
+      self->animation_offset =
+        store_dyn_attr (self, data, num_floats * sizeof (float)) | flags;
+    }
+
+  config[1] = self->animation_offset;
+}
+
+/* encodes what a draw takes from the canvas state: the scroll node into
+   config0, and into config1 the transform, along with the clip and the
+   animation, or else the animation along with the clip, or else the clip
+   alone if the area 'left', 'top', 'right', 'bottom' may cross it.
+   Retained and scrolled draws may be moved across it later */
+static void
+encode_and_store_clip_and_transform (GlrCanvas         *self,
+                                     float              left,
+                                     float              top,
+                                     float              right,
+                                     float              bottom,
+                                     GlrInstanceConfig  config)
+{
+  config[0] = (config[0] & ~GLR_INSTANCE_SCROLL_NODE_MASK)
+    | (self->scroll_node << GLR_INSTANCE_SCROLL_NODE_SHIFT);
+
+  if (self->effective_class >= TRANSFORM_AFFINE_2D)
+    encode_and_store_transform (self, left, top, config);
+  else if (self->animated)
+    encode_and_store_animation (self, config);
+  else if (! area_is_inside_clip (self, left, top, right, bottom)
+           || ((self->retained != NULL || self->scroll_node != 0)
+               && self->clips->len > 0))
+    encode_and_store_clip (self, config);
+}
+
+/* to be called whenever the current clip changes. Encoded transforms
+   carry the clip they were encoded with */
+static void
+update_clip (GlrCanvas *self)
+{
+  ClipState *clip = get_current_clip (self);
+
+  self->clip_id = clip != NULL ? clip->id : 0;
+  self->current_transform_index = 0;
+  self->base_offset = 0;
+  self->animation_offset = 0;
+}
+
+/* pushes a clip level, intersected with the current one. The area is
+   given as a rect would be drawn, with the current transform applied. It
+   is exact for translations and scales, 2D transforms clip to the
+   bounding box of the transformed area, without rounded corners. Under
+   a 3D transform the area would be seen through the perspective, which
+   the clip can't follow, so the level adds no clip of its own */
+static void
+push_clip (GlrCanvas   *self,
+           float        left,
+           float        top,
+           float        width,
+           float        height,
+           const float  radii[4])
+{
+  ClipState clip = {0};
+  ClipState *below = get_current_clip (self);
+  float corners[4][2];
+  int i;
+
+  if (self->effective_class == TRANSFORM_3D)
+    {
+      g_warning ("Clips can't be pushed under a 3D transform, the current "
+                 "clip is kept.");
+
+      if (below != NULL)
+        {
+          clip = *below;
+        }
+      else
+        {
+          clip.rect[0] = clip.rect[1] = -UNBOUNDED_CLIP_EXTENT;
+          clip.rect[2] = clip.rect[3] = UNBOUNDED_CLIP_EXTENT;
+          clip.id = ++self->next_clip_id;
+        }
+
+      g_array_append_val (self->clips, clip);
+      update_clip (self);
+      return;
+    }
+
+  if (self->effective_class <= TRANSFORM_TRANSLATE)
+    {
+      float x = left;
+      float y = top;
+
+      apply_translation (self, &x, &y);
+
+      clip.rect[0] = x;
+      clip.rect[1] = y;
+      clip.rect[2] = x + width;
+      clip.rect[3] = y + height;
+      memcpy (clip.radii, radii, sizeof (clip.radii));
+    }
+  else
+    {
+      Mat4 m;
+      float x[4] = { left, left + width, left + width, left };
+      float y[4] = { top, top, top + height, top + height };
+
+      get_effective_matrix (self, left, top, m);
+
+      clip.rect[0] = clip.rect[1] = INFINITY;
+      clip.rect[2] = clip.rect[3] = -INFINITY;
+      for (i = 0; i < 4; i++)
+        {
+          float tx = x[i] * m[0][0] + y[i] * m[1][0] + m[3][0];
+          float ty = x[i] * m[0][1] + y[i] * m[1][1] + m[3][1];
+
+          clip.rect[0] = MIN (clip.rect[0], tx);
+          clip.rect[1] = MIN (clip.rect[1], ty);
+          clip.rect[2] = MAX (clip.rect[2], tx);
+          clip.rect[3] = MAX (clip.rect[3], ty);
+        }
+
+      // a scale keeps the corners where they are
+      if (self->effective_class == TRANSFORM_AFFINE_2D
+          && m[0][1] == 0.0 && m[1][0] == 0.0
+          && m[0][0] > 0.0 && m[1][1] > 0.0)
+        {
+          for (i = 0; i < 4; i++)
+            clip.radii[i] = radii[i] * MIN (m[0][0], m[1][1]);
+        }
+    }
+
+  if (below != NULL)
+    {
+      float *r = clip.rect;
+
+      // corners of the intersection keep the radius of the clips they
+      // come from
+      corners[0][0] = MAX (r[0], below->rect[0]);
+      corners[0][1] = MAX (r[1], below->rect[1]);
+      corners[1][0] = MIN (r[2], below->rect[2]);
+      corners[1][1] = corners[0][1];
+      corners[2][0] = corners[0][0];
+      corners[2][1] = MIN (r[3], below->rect[3]);
+      corners[3][0] = corners[1][0];
+      corners[3][1] = corners[2][1];
+
+      for (i = 0; i < 4; i++)
+        {
+          float radius = 0.0;
+          int x = i % 2 == 0 ? 0 : 2;
+          int y = i < 2 ? 1 : 3;
+
+          if (corners[i][0] == r[x] && corners[i][1] == r[y])
+            radius = clip.radii[i];
+          if (corners[i][0] == below->rect[x]
+              && corners[i][1] == below->rect[y])
+            {
+              radius = MAX (radius, below->radii[i]);
+            }
+
+          clip.radii[i] = radius;
+        }
+
+      r[0] = corners[0][0];
+      r[1] = corners[0][1];
+      r[2] = MAX (corners[3][0], r[0]);
+      r[3] = MAX (corners[3][1], r[1]);
+    }
+
+  clip.id = ++self->next_clip_id;
+  g_array_append_val (self->clips, clip);
+
+  update_clip (self);
+}
+
+static void
+instance_config_set_type (GlrInstanceConfig config, GlrInstanceType type)
+{
+  /* bits 26 to 29 (4 bits) of config0 encode the instance type */
+  config[0] = (config[0] & INSTANCE_TYPE_MASK) | (type << 26);
+}
+
+static void
+encode_and_store_border (GlrCanvas         *self,
+                         GlrBorder         *border,
+                         GlrInstanceConfig  config)
+{
+  size_t offset;
+  float buf[16] = {0};
+  uint8_t num_samples = 0;
+
+  bool all_style_equal;
+  bool all_width_equal;
+  bool all_radius_equal;
+  bool all_color_equal;
+
+  all_style_equal = border->style[0] == border->style[1]
+    && border->style[0] == border->style[2]
+    && border->style[0] == border->style[3];
+
+  all_width_equal = EQUALS (border->width[0], border->width[1])
+    && EQUALS (border->width[0], border->width[2])
+    && EQUALS (border->width[0], border->width[3]);
+
+  all_radius_equal = EQUALS (border->radius[0], border->radius[1])
+    && EQUALS (border->radius[0], border->radius[2])
+    && EQUALS (border->radius[0], border->radius[3]);
+
+  all_color_equal = border->color[0] == border->color[1]
+    && border->color[0] == border->color[2]
+    && border->color[0] == border->color[3];
+
+  /* the simplest case: style, width, radius and color of all borders are equal */
+  if (all_style_equal && all_width_equal && all_radius_equal && all_color_equal)
+    {
+      /* this case is encoded in 1 dyn attr sample */
+      buf[0] = border->style[0];
+      buf[1] = border->width[0];
+      buf[2] = border->radius[0];
+      buf[3] = border->color[0];
+
+      num_samples = 1;
+    }
+
+  if (num_samples == 0)
+    return;
+
+  /* bits 20 to 23 (4 bits) of config0 encode the number of samples
+     that describe the border */
+  config[0] = (config[0] & BORDER_NUM_SAMPLES_MASK) | (num_samples << 20);
+
+  offset = store_dyn_attr (self, buf, sizeof (float) * 4 * num_samples);
+
+  /* config2 encodes the offset of the border description */
+  config[2] = offset;
+}
+
+static void
+glr_color_decompose_float (GlrColor color, GlrColor4f color_4f)
+{
+  color_4f[0] = ((color >> 24) & 0xFF) / 255.0;
+  color_4f[1] = ((color >> 16) & 0xFF) / 255.0;
+  color_4f[2] = ((color >>  8) & 0xFF) / 255.0;
+  color_4f[3] = (color         & 0xFF) / 255.0;
+}
+
+/* a box is described by 3 dyn attr samples: the border widths (left, top,
+   right, bottom), the corner radii (top-left, top-right, bottom-left,
+   bottom-right) and the border color */
+static void
+encode_and_store_box (GlrCanvas         *self,
+                      GlrBorder         *border,
+                      GlrInstanceConfig  config)
+{
+  float buf[12];
+  int i;
+
+  for (i = 0; i < 4; i++)
+    {
+      buf[i] = border->width[i];
+      buf[4 + i] = border->radius[i];
+    }
+
+  glr_color_decompose_float (border->color[0], &(buf[8]));
+
+  /* config2 encodes the offset of the box description */
+  config[2] = store_dyn_attr (self, buf, sizeof (buf));
+}
+
+static void
+encode_and_store_background (GlrCanvas         *self,
+                             GlrBackground     *bg,
+                             GlrInstanceConfig  config)
+{
+  goffset offset;
+  float buf[16] = {0};
+  uint8_t num_samples = 0;
+
+  if (bg->type == GLR_BACKGROUND_LINEAR_GRADIENT)
+    {
+      // pre-calculate linear gradient values
+      const float SEMI_DIAG_LENGTH = sqrt ((0.5*0.5)*2.0);
+      float angle = bg->linear_grad_angle;
+
+      if (angle < 0.0)
+        angle = M_PI*2.0 - fmod (fabs (angle), M_PI * 2.0);
+      else
+        angle = fmod (angle, M_PI * 2.0);
+
+      float gamma = M_PI/2.0;
+      if (angle < M_PI/2.0)
+        gamma -= angle;
+      else if (angle < M_PI)
+        gamma -= angle - M_PI/2.0;
+      else if (angle < M_PI/2.0*3.0)
+        gamma -= angle - M_PI;
+      else
+        gamma -= angle - M_PI/2.0*3.0;
+
+      float beta = M_PI/4.0 + gamma;
+      float length = SEMI_DIAG_LENGTH * sin (beta) * 2.0;
+
+      buf[0] = angle;
+      buf[1] = length;
+      buf[2] = gamma;
+
+      GlrColor4f color0, color1;
+      glr_color_decompose_float (bg->linear_grad_colors[0], color0);
+      glr_color_decompose_float (bg->linear_grad_colors[1], color1);
+
+      memcpy (&(buf[4]), color0, sizeof (GlrColor4f));
+      memcpy (&(buf[8]), color1, sizeof (GlrColor4f));
+
+      num_samples = 3;
+    }
+
+  if (num_samples == 0)
+    return;
+
+  // bits 16 to 19 (4 bits) of config0 encode the number of samples to describe
+  // the background
+  config[0] = (config[0] & BACKGROUND_NUM_SAMPLES_MASK) | (num_samples << 16);
+
+  offset = store_dyn_attr (self, buf, sizeof (float) * 4 * num_samples);
+
+  // config3 encodes the offset of the background description
+  config[3] = offset;
+}
+
+static bool
+has_any_border (const GlrBorder *border)
+{
+  return UNEQUALS (border->width[0], 0.0)
+    || UNEQUALS (border->width[1], 0.0)
+    || UNEQUALS (border->width[2], 0.0)
+    || UNEQUALS (border->width[3], 0.0)
+
+    || UNEQUALS (border->radius[0], 0.0)
+    || UNEQUALS (border->radius[1], 0.0)
+    || UNEQUALS (border->radius[2], 0.0)
+    || UNEQUALS (border->radius[3], 0.0);
+}
+
+/* whether the transform moves everything by the same offset, no matter
+   the origin it is applied from */
+static bool
+is_translation_only (const GlrTransform *transform)
+{
+  return EQUALS (transform->rotate[0], 0.0)
+    && EQUALS (transform->rotate[1], 0.0)
+    && EQUALS (transform->rotate[2], 0.0)
+
+    && EQUALS (transform->scale[0], 1.0)
+    && EQUALS (transform->scale[1], 1.0)
+    && EQUALS (transform->scale[2], 1.0);
+}
+
+/* the glyph's area is unknown until it is rasterized, and so is the origin
+   its transform is applied from. The latter only matters when the current
+   transform rotates or scales, in which case glyphs are not culled */
+static bool
+glyph_is_culled (GlrCanvas *self, float left, float top, const GlrFont *font)
+{
+  float extent = font->size * GLYPH_PIXELS_PER_POINT * GLYPH_CULL_EXTENT_EMS;
+
+  if (! is_translation_only (&self->transform))
+    return false;
+
+  return area_is_culled (self,
+                         left - extent, top - extent,
+                         left + extent, top + extent,
+                         left, top);
+}
+
+/* whether a rect sits exactly on pixel boundaries, in which case it needs
+   no anti-aliased edges */
+static bool
+is_pixel_aligned (float left, float top, float width, float height)
+{
+  return left == floorf (left)
+    && top == floorf (top)
+    && width == floorf (width)
+    && height == floorf (height);
+}
+
+/* whether a rect is drawn as a single box instance, which takes a single
+   color for all the border */
+static bool
+draws_as_box (GlrCanvas *self, const GlrBorder *border)
+{
+  int i;
+
+  if (! self->sdf_boxes || ! has_any_border (border))
+    return false;
+
+  for (i = 1; i < 4; i++)
+    if (border->color[i] != border->color[0]
+        || border->style[i] != border->style[0])
+      {
+        return false;
+      }
+
+  return true;
+}
+
+static size_t
+rect_num_instances (GlrCanvas *self, GlrStyle *style)
+{
+  size_t num_instances = 0;
+  int i;
+
+  if (draws_as_box (self, &style->border))
+    return 1;
+
+  if (style->background.type != GLR_BACKGROUND_NONE)
+    num_instances++;
+
+  if (! has_any_border (&style->border))
+    return num_instances;
+
+  // the four corners are always drawn
+  num_instances += 4;
+  for (i = 0; i < 4; i++)
+    if (style->border.width[i] > 0.0)
+      num_instances++;
+
+  return num_instances;
+}
+
+/* drops everything drawn since the last clear */
+static void
+start_over (GlrCanvas *self)
+{
+  g_queue_foreach (self->sealed_batches,
+                   (GFunc) recycle_sealed_batch,
+                   self->batch_pool);
+  g_queue_clear (self->sealed_batches);
+
+  glr_batch_reset (self->batch);
+  glr_batch_set_instance_format (self->batch, self->instance_format);
+  forget_encoded_transforms (self);
+
+  memset (&self->stats, 0, sizeof (GlrCanvasStats));
+
+  // the target may have been resized since the last frame
+  self->viewport_valid = false;
+
+  self->frame_initialized = false;
+}
+
+static GlrCanvas *
+canvas_new (GlrContext     *context,
+            GlrTarget      *target,
+            GlrCanvasFlags  flags,
+            bool            deferred)
+{
+  GlrCanvas *self;
 
   self = g_slice_new0 (GlrCanvas);
   self->ref_count = 1;
 
-  self->context = glr_context_ref (context);
+  self->context = glr_context_ref (context);
+  self->gl = glr_context_get_symbols (context);
+
+  if (target != NULL)
+    self->target = glr_target_ref (target);
+
+  // shaders are compiled by the first canvas of the context. Those of
+  // recorders never draw, so they don't need them
+  self->deferred = deferred;
+  if (! deferred)
+    self->programs = glr_context_get_programs (self->context);
+
+  // batch
+  if (flags & GLR_CANVAS_COMPACT_INSTANCES)
+    self->instance_format = GLR_INSTANCE_FORMAT_COMPACT;
+  else
+    self->instance_format = GLR_INSTANCE_FORMAT_FULL;
+
+  self->sdf_boxes = (flags & GLR_CANVAS_SDF_BOXES) != 0;
+
+  self->batch = new_batch (self, self->instance_format);
+  self->sealed_batches = g_queue_new ();
+  self->batch_pool = g_queue_new ();
+
+  // edge-aa
+  self->aa_offset = DEFAULT_EDGE_AA_OFFSET;
+
+  // projection
+  self->z_depth = DEFAULT_Z_DEPTH;
+
+  // perspective matrix
+  float fov = 90.0;
+  float n = 0.0;
+  float f = self->z_depth;
+  float S = 1.0 / ( tan (fov * 0.5 * M_PI/180.0) );
+
+  Mat4 persp_matrix = {
+    {S,   0.0,          0.0,  0.0},
+    {0.0,   S,          0.0,  0.0},
+    {0.0, 0.0,   -(f/(f-n)), -1.0},
+    {0.0, 0.0, -(f*n/(f-n)),  0.0}
+  };
+  memcpy (self->persp_matrix, persp_matrix, sizeof (Mat4));
+
+  // transform matrix and state stack
+  self->saved_states = g_array_new (FALSE, FALSE, sizeof (SavedState));
+  memcpy (self->base_matrix, IDENTITY_MATRIX, sizeof (Mat4));
+  self->base_class = TRANSFORM_IDENTITY;
+  self->base_opacity = 1.0;
+  self->opacity = 1.0;
+  glr_canvas_reset_transform (self);
+
+  // clip stack
+  self->clips = g_array_new (FALSE, FALSE, sizeof (ClipState));
+
+  // texture cache
+  self->tex_cache = glr_context_get_texture_cache (self->context);
+  glr_tex_cache_ref (self->tex_cache);
+
+  return self;
+}
+
+/* internal API */
+
+/* a canvas for a recorder, whose draws make no GL calls. See
+   glr-recorder.h for what it cannot do */
+GlrCanvas *
+glr_canvas_new_deferred (GlrContext *context, GlrCanvasFlags flags)
+{
+  return canvas_new (context, NULL, flags, true);
+}
+
+void
+glr_canvas_reset_deferred (GlrCanvas *self)
+{
+  assert (self->deferred);
+
+  start_over (self);
+}
+
+/* public API */
+
+GlrCanvas *
+glr_canvas_new (GlrContext *context, GlrTarget *target)
+{
+  return glr_canvas_new_full (context, target, GLR_CANVAS_FLAGS_NONE);
+}
+
+GlrCanvas *
+glr_canvas_new_full (GlrContext     *context,
+                     GlrTarget      *target,
+                     GlrCanvasFlags  flags)
+{
+  assert (context != NULL);
+
+  return canvas_new (context, target, flags, false);
+}
+
+GlrCanvas *
+glr_canvas_ref (GlrCanvas *self)
+{
+  g_assert (self != NULL);
+  g_assert (self->ref_count > 0);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+glr_canvas_unref (GlrCanvas *self)
+{
+  g_assert (self != NULL);
+  g_assert (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    glr_canvas_free (self);
+}
+
+void
+glr_canvas_clear (GlrCanvas *self, GlrColor color)
+{
+  assert (self != NULL);
+
+  if (self->recording)
+    {
+      g_warning ("Cannot clear a canvas while recording a display list.");
+      return;
+    }
+
+  if (self->deferred)
+    {
+      g_warning ("Cannot clear the canvas of a recorder, reset it instead.");
+      return;
+    }
+
+  self->clear_color = color;
+
+  if (self->frame_initialized)
+    clear_background (self);
+  else
+    self->pending_clear = true;
+
+  start_over (self);
+}
+
+GlrTarget *
+glr_canvas_get_target (GlrCanvas *self)
+{
+  return self->target;
+}
+
+void
+glr_canvas_flush (GlrCanvas *self)
+{
+  assert (self != NULL);
+
+  GList *node;
+
+  if (self->recording)
+    {
+      g_warning ("Cannot flush a canvas while recording a display list.");
+      return;
+    }
+
+  if (self->deferred)
+    {
+      g_warning ("Cannot flush the canvas of a recorder.");
+      return;
+    }
+
+  initialize_frame_if_needed (self);
+
+  for (node = self->sealed_batches->head; node != NULL; node = node->next)
+    draw_sealed_batch (self, node->data);
+
+  draw_batch (self, self->batch);
+
+  // leave the default vertex array bound for the application
+  glr_context_bind_vertex_array (self->context, 0);
+
+  self->frame_initialized = false;
+}
+
+void
+glr_canvas_get_stats (GlrCanvas *self, GlrCanvasStats *stats)
+{
+  assert (self != NULL);
+  assert (stats != NULL);
+
+  GList *node;
+
+  memcpy (stats, &self->stats, sizeof (GlrCanvasStats));
+
+  // batches count their waits until they are reset
+  stats->fence_waits += glr_batch_get_num_fence_waits (self->batch);
+  for (node = self->sealed_batches->head; node != NULL; node = node->next)
+    {
+      SealedBatch *sealed = node->data;
+
+      if (sealed->batch != NULL)
+        stats->fence_waits += glr_batch_get_num_fence_waits (sealed->batch);
+    }
+}
+
+void
+glr_canvas_translate (GlrCanvas *self, float x, float y, float z)
+{
+  assert (self != NULL);
+
+  self->transform.translate[0] = x;
+  self->transform.translate[1] = y;
+  self->transform.translate[2] = z;
+
+  update_transform_class (self);
+}
+
+void
+glr_canvas_rotate (GlrCanvas *self, float angle_x, float angle_y, float angle_z)
+{
+  assert (self != NULL);
+
+  self->transform.rotate[0] = angle_x;
+  self->transform.rotate[1] = angle_y;
+  self->transform.rotate[2] = angle_z;
+
+  update_transform_class (self);
+}
+
+void
+glr_canvas_set_transform_origin (GlrCanvas *self,
+                                 float      origin_x,
+                                 float      origin_y,
+                                 float      origin_z)
+{
+  assert (self != NULL);
+
+  self->transform.origin[0] = origin_x;
+  self->transform.origin[1] = origin_y;
+  self->transform.origin[2] = origin_z;
+
+  update_transform_class (self);
+}
+
+void
+glr_canvas_scale (GlrCanvas *self,
+                  float      scale_x,
+                  float      scale_y,
+                  float      scale_z)
+{
+  assert (self != NULL);
+
+  self->transform.scale[0] = scale_x;
+  self->transform.scale[1] = scale_y;
+  self->transform.scale[2] = scale_z;
+
+  update_transform_class (self);
+}
+
+void
+glr_canvas_reset_transform (GlrCanvas *self)
+{
+  assert (self != NULL);
+
+  memset (&self->transform, 0x00, sizeof (GlrTransform));
+
+  self->transform.scale[0] = 1.0;
+  self->transform.scale[1] = 1.0;
+  self->transform.scale[2] = 1.0;
+
+  update_transform_class (self);
+}
+
+void
+glr_canvas_save (GlrCanvas *self)
+{
+  assert (self != NULL);
+
+  SavedState state;
+  Mat4 matrix;
+
+  memcpy (&state.transform, &self->transform, sizeof (GlrTransform));
+  memcpy (state.base_matrix, self->base_matrix, sizeof (Mat4));
+  state.base_class = self->base_class;
+  state.base_id = self->base_id;
+  state.base_offset = self->base_offset;
+  state.base_opacity = self->base_opacity;
+  state.opacity = self->opacity;
+  state.num_clips = self->clips->len;
+  g_array_append_val (self->saved_states, state);
+
+  // the current transform is composed into the base of the new level once,
+  // with its origin in canvas coordinates
+  if (self->transform_class != TRANSFORM_IDENTITY)
+    {
+      matrix_from_transform (&self->transform, matrix);
+      multiply_mat4 (matrix, self->base_matrix, self->base_matrix);
+
+      self->base_class = classify_matrix (self->base_matrix);
+      self->base_id = ++self->next_base_id;
+      self->base_offset = 0;
+    }
+
+  self->base_opacity = self->opacity;
+
+  glr_canvas_reset_transform (self);
+}
+
+void
+glr_canvas_restore (GlrCanvas *self)
+{
+  assert (self != NULL);
+
+  SavedState state;
+
+  if (self->saved_states->len == 0)
+    {
+      g_warning ("glr_canvas_restore() called without a matching glr_canvas_save()");
+      return;
+    }
+
+  state = g_array_index (self->saved_states,
+                         SavedState,
+                         self->saved_states->len - 1);
+  g_array_set_size (self->saved_states, self->saved_states->len - 1);
+
+  memcpy (&self->transform, &state.transform, sizeof (GlrTransform));
+  memcpy (self->base_matrix, state.base_matrix, sizeof (Mat4));
+  self->base_class = state.base_class;
+  self->base_id = state.base_id;
+  self->base_offset = state.base_offset;
+  self->base_opacity = state.base_opacity;
+  self->opacity = state.opacity;
+
+  // clips pushed since are dropped. The base offset restored above was
+  // encoded with the clip of back then
+  if (self->clips->len > state.num_clips)
+    {
+      g_array_set_size (self->clips, state.num_clips);
+      self->clip_id = state.num_clips > 0 ? get_current_clip (self)->id : 0;
+    }
 
-  if (target != NULL)
-    self->target = glr_target_ref (target);
+  update_transform_class (self);
+}
 
-  // setup the shaders
-  vertex_shader = load_shader (INSTANCED_VERTEX_SHADER_SRC, GL_VERTEX_SHADER);
-  fragment_shader = load_shader (INSTANCED_FRAGMENT_SHADER_SRC, GL_FRAGMENT_SHADER);
+void
+glr_canvas_set_opacity (GlrCanvas *self, float opacity)
+{
+  assert (self != NULL);
 
-  self->shader_program = glCreateProgram ();
-  glAttachShader (self->shader_program, vertex_shader);
-  glAttachShader (self->shader_program, fragment_shader);
+  self->opacity = self->base_opacity * CLAMP (opacity, 0.0, 1.0);
+}
 
-  glBindAttribLocation (self->shader_program, LAYOUT_ATTR, "lyt_attr");
-  glBindAttribLocation (self->shader_program, COLOR_ATTR, "color_attr");
-  glBindAttribLocation (self->shader_program, CONFIG_ATTR, "config_attr");
+void
+glr_animation_init (GlrAnimation *self, float start_time, float duration)
+{
+  const GlrAnimationFrame identity = {
+    .rotate = 0.0,
+    .scale = { 1.0, 1.0 },
+    .translate = { 0.0, 0.0 },
+    .opacity = 1.0
+  };
 
-  glLinkProgram (self->shader_program);
+  assert (self != NULL);
 
-  glDeleteShader (vertex_shader);
-  glDeleteShader (fragment_shader);
+  memset (self, 0, sizeof (GlrAnimation));
+  self->start_time = start_time;
+  self->duration = duration;
+  self->iterations = 1.0;
+  self->timing = GLR_ANIMATION_LINEAR;
+  self->from = identity;
+  self->to = identity;
+}
 
-  glUseProgram (self->shader_program);
+void
+glr_canvas_set_animation (GlrCanvas *self, const GlrAnimation *animation)
+{
+  assert (self != NULL);
 
-  // get uniform locations
-  self->proj_matrix_loc = glGetUniformLocation (self->shader_program,
-                                                "proj_matrix");
-  self->transform_matrix_loc = glGetUniformLocation (self->shader_program,
-                                                     "transform_matrix");
-  self->persp_matrix_loc = glGetUniformLocation (self->shader_program,
-                                                 "persp_matrix");
-  self->aa_offset_loc = glGetUniformLocation (self->shader_program,
-                                              "aa_offset");
+  if (animation != NULL)
+    memcpy (&self->animation, animation, sizeof (GlrAnimation));
 
-  // batch
-  self->batch = glr_batch_new ();
+  self->animated = animation != NULL;
 
-  // edge-aa
-  self->aa_offset = DEFAULT_EDGE_AA_OFFSET;
-  glUniform1f (self->aa_offset_loc, self->aa_offset);
+  // the animation is part of the block of every transform encoded
+  forget_encoded_transforms (self);
+}
 
-  // projection
-  self->z_depth = DEFAULT_Z_DEPTH;
+void
+glr_canvas_set_time (GlrCanvas *self, float time)
+{
+  assert (self != NULL);
 
-  // perspective matrix
-  float fov = 90.0;
-  float n = 0.0;
-  float f = self->z_depth;
-  float S = 1.0 / ( tan (fov * 0.5 * M_PI/180.0) );
+  self->time = time;
+}
 
-  Mat4 persp_matrix = {
-    {S,   0.0,          0.0,  0.0},
-    {0.0,   S,          0.0,  0.0},
-    {0.0, 0.0,   -(f/(f-n)), -1.0},
-    {0.0, 0.0, -(f*n/(f-n)),  0.0}
-  };
+void
+glr_canvas_set_scroll_node (GlrCanvas *self, uint32_t node)
+{
+  assert (self != NULL);
 
-  glUniformMatrix4fv (self->persp_matrix_loc,
-                      1,
-                      GL_FALSE,
-                      &(persp_matrix[0][0]));
+  if (node >= GLR_PROGRAM_NUM_SCROLL_NODES)
+    {
+      g_warning ("Invalid scroll node %u.", node);
+      return;
+    }
 
-  // transform matrix
-  glr_canvas_reset_transform (self);
-  self->current_transform_index = 0;
+  self->scroll_node = node;
+}
 
-  // texture cache
-  self->tex_cache = glr_context_get_texture_cache (self->context);
-  glr_tex_cache_ref (self->tex_cache);
+void
+glr_canvas_set_scroll_offset (GlrCanvas *self,
+                              uint32_t   node,
+                              float      dx,
+                              float      dy)
+{
+  assert (self != NULL);
 
-  return self;
+  if (node == 0 || node >= GLR_PROGRAM_NUM_SCROLL_NODES)
+    {
+      g_warning ("Invalid scroll node %u.", node);
+      return;
+    }
+
+  self->scroll_offsets[node][0] = dx;
+  self->scroll_offsets[node][1] = dy;
 }
 
-GlrCanvas *
-glr_canvas_ref (GlrCanvas *self)
+void
+glr_canvas_push_clip_rect (GlrCanvas *self,
+                           float      left,
+                           float      top,
+                           float      width,
+                           float      height)
 {
-  g_assert (self != NULL);
-  g_assert (self->ref_count > 0);
+  static const float no_radii[4] = {0};
 
-  g_atomic_int_inc (&self->ref_count);
+  assert (self != NULL);
 
-  return self;
+  push_clip (self, left, top, width, height, no_radii);
 }
 
 void
-glr_canvas_unref (GlrCanvas *self)
+glr_canvas_push_rounded_clip_rect (GlrCanvas   *self,
+                                   float        left,
+                                   float        top,
+                                   float        width,
+                                   float        height,
+                                   const float  radii[4])
 {
-  g_assert (self != NULL);
-  g_assert (self->ref_count > 0);
+  assert (self != NULL);
+  assert (radii != NULL);
 
-  if (g_atomic_int_dec_and_test (&self->ref_count))
-    glr_canvas_free (self);
+  push_clip (self, left, top, width, height, radii);
 }
 
 void
-glr_canvas_clear (GlrCanvas *self, GlrColor color)
+glr_canvas_pop_clip (GlrCanvas *self)
 {
   assert (self != NULL);
 
-  self->clear_color = color;
+  guint num_saved_clips = 0;
 
-  if (self->frame_initialized)
-    clear_background (self);
-  else
-    self->pending_clear = true;
+  // clips pushed before the last glr_canvas_save() belong to the saved level
+  if (self->saved_states->len > 0)
+    num_saved_clips = g_array_index (self->saved_states,
+                                     SavedState,
+                                     self->saved_states->len - 1).num_clips;
 
-  glr_batch_reset (self->batch);
-  self->frame_initialized = false;
-}
+  if (self->clips->len <= num_saved_clips)
+    {
+      g_warning ("glr_canvas_pop_clip() called without a matching push");
+      return;
+    }
 
-GlrTarget *
-glr_canvas_get_target (GlrCanvas *self)
-{
-  return self->target;
+  g_array_set_size (self->clips, self->clips->len - 1);
+
+  update_clip (self);
 }
 
 void
-glr_canvas_flush (GlrCanvas *self)
+glr_canvas_begin_display_list (GlrCanvas *self)
 {
   assert (self != NULL);
 
-  initialize_frame_if_needed (self);
+  if (self->recording)
+    {
+      g_warning ("A display list is already being recorded.");
+      return;
+    }
+
+  if (self->deferred)
+    {
+      g_warning ("Cannot record a display list on the canvas of a recorder.");
+      return;
+    }
 
-  glr_batch_draw (self->batch, self->shader_program);
+  self->frame_batch = self->batch;
+  self->frame_sealed_batches = self->sealed_batches;
+  self->sealed_batches = g_queue_new ();
+  self->retained_handles =
+    g_ptr_array_new_with_free_func ((GDestroyNotify) glr_retained_free);
+  self->recording = true;
 
-  self->frame_initialized = false;
+  start_new_batch (self);
 }
 
-void
-glr_canvas_translate (GlrCanvas *self, float x, float y, float z)
+GlrDisplayList *
+glr_canvas_end_display_list (GlrCanvas *self)
 {
   assert (self != NULL);
 
-  self->transform.translate[0] = x;
-  self->transform.translate[1] = y;
-  self->transform.translate[2] = z;
+  GPtrArray *batches;
+  SealedBatch *sealed;
 
-  self->current_transform_index = 0;
+  GlrDisplayList *list;
+
+  if (! self->recording)
+    {
+      g_warning ("No display list is being recorded.");
+      return NULL;
+    }
+
+  if (self->retained != NULL)
+    {
+      g_warning ("Display list ended before its last retained draws.");
+      glr_canvas_end_retained (self);
+    }
+
+  seal_batch (self, self->batch);
+
+  // uploading binds textures outside a flush, where the application may
+  // have changed the bindings since the last one
+  glr_context_invalidate_gl_state (self->context);
+
+  // the list keeps the batches as they are, uploaded once here
+  batches = g_ptr_array_new_with_free_func ((GDestroyNotify) glr_batch_unref);
+  while (! g_queue_is_empty (self->sealed_batches))
+    {
+      sealed = g_queue_pop_head (self->sealed_batches);
+
+      if (glr_batch_get_num_instances (sealed->batch) > 0)
+        {
+          glr_batch_upload (sealed->batch);
+          g_ptr_array_add (batches, sealed->batch);
+          g_slice_free (SealedBatch, sealed);
+        }
+      else
+        {
+          recycle_sealed_batch (sealed, self->batch_pool);
+        }
+    }
+  g_queue_free (self->sealed_batches);
+
+  self->batch = self->frame_batch;
+  self->sealed_batches = self->frame_sealed_batches;
+  self->frame_batch = NULL;
+  self->frame_sealed_batches = NULL;
+  self->recording = false;
+
+  forget_encoded_transforms (self);
+
+  list = glr_display_list_new (self->context,
+                               batches,
+                               self->retained_handles);
+  self->retained_handles = NULL;
+
+  return list;
 }
 
 void
-glr_canvas_rotate (GlrCanvas *self, float angle_x, float angle_y, float angle_z)
+glr_canvas_begin_retained (GlrCanvas *self)
 {
   assert (self != NULL);
 
-  self->transform.rotate[0] = angle_x;
-  self->transform.rotate[1] = angle_y;
-  self->transform.rotate[2] = angle_z;
+  if (! self->recording)
+    {
+      g_warning ("Retained draws need a display list being recorded.");
+      return;
+    }
 
-  self->current_transform_index = 0;
+  if (self->retained != NULL)
+    {
+      g_warning ("Retained draws are already being recorded.");
+      return;
+    }
+
+  self->retained = glr_retained_new (self->opacity);
+  g_ptr_array_add (self->retained_handles, self->retained);
 }
 
-void
-glr_canvas_set_transform_origin (GlrCanvas *self,
-                                 float      origin_x,
-                                 float      origin_y,
-                                 float      origin_z)
+GlrRetained *
+glr_canvas_end_retained (GlrCanvas *self)
 {
   assert (self != NULL);
 
-  self->transform.origin[0] = origin_x;
-  self->transform.origin[1] = origin_y;
-  self->transform.origin[2] = origin_z;
+  GlrRetained *retained = self->retained;
 
-  self->current_transform_index = 0;
+  if (retained == NULL)
+    {
+      g_warning ("No retained draws are being recorded.");
+      return NULL;
+    }
+
+  // what follows does not need to stay in place around them
+  glr_batch_set_movable (self->batch, false);
+  self->retained = NULL;
+
+  return retained;
 }
 
 void
-glr_canvas_scale (GlrCanvas *self,
-                  float      scale_x,
-                  float      scale_y,
-                  float      scale_z)
+glr_canvas_draw_display_list (GlrCanvas *self, GlrDisplayList *list)
 {
   assert (self != NULL);
+  assert (list != NULL);
+  assert (glr_display_list_get_context (list) == self->context);
 
-  self->transform.scale[0] = scale_x;
-  self->transform.scale[1] = scale_y;
-  self->transform.scale[2] = scale_z;
+  SealedBatch *sealed;
 
-  self->current_transform_index = 0;
+  if (self->recording)
+    {
+      g_warning ("Cannot draw a display list while recording another one.");
+      return;
+    }
+
+  if (self->deferred)
+    {
+      g_warning ("Cannot draw a display list on the canvas of a recorder.");
+      return;
+    }
+
+  // what was drawn so far goes before the list
+  if (glr_batch_get_num_instances (self->batch) > 0)
+    {
+      seal_batch (self, self->batch);
+      start_new_batch (self);
+    }
+
+  sealed = g_slice_new0 (SealedBatch);
+  sealed->list = glr_display_list_ref (list);
+
+  // the list was recorded in canvas coordinates, so the transform applies
+  // to it like to a single draw at the origin
+  get_effective_matrix (self, 0.0, 0.0, sealed->matrix);
+
+  g_queue_push_tail (self->sealed_batches, sealed);
 }
 
 void
-glr_canvas_reset_transform (GlrCanvas *self)
+glr_canvas_draw_recorders (GlrCanvas    *self,
+                           size_t        count,
+                           GlrRecorder **recorders)
 {
   assert (self != NULL);
+  assert (count == 0 || recorders != NULL);
 
-  memset (&self->transform, 0x00, sizeof (GlrTransform));
+  SealedBatch *sealed;
+  size_t i;
 
-  self->transform.scale[0] = 1.0;
-  self->transform.scale[1] = 1.0;
-  self->transform.scale[2] = 1.0;
+  if (self->recording || self->deferred)
+    {
+      g_warning ("Recorders can only be drawn to the frame of a canvas.");
+      return;
+    }
 
-  self->current_transform_index = 0;
+  // what was drawn so far goes before them
+  if (glr_batch_get_num_instances (self->batch) > 0)
+    {
+      seal_batch (self, self->batch);
+      start_new_batch (self);
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      assert (glr_recorder_get_canvas (recorders[i])->context
+              == self->context);
+
+      sealed = g_slice_new0 (SealedBatch);
+      sealed->recorder = glr_recorder_ref (recorders[i]);
+
+      g_queue_push_tail (self->sealed_batches, sealed);
+    }
 }
 
 void
@@ -728,49 +2579,148 @@ glr_canvas_draw_rect (GlrCanvas *self,
   assert (self != NULL);
   assert (style != NULL);
 
-  if (glr_batch_is_full (self->batch))
+  GlrInstanceFormat format;
+  GlrStyle faded_style;
+  float origin[2];
+
+  retain_area (self, left, top, width, height);
+
+  apply_translation (self, &left, &top);
+  style = apply_opacity_to_style (self, style, &faded_style);
+
+  format = instance_format_for_area (self, left, top, width, height);
+
+  // a transform already encoded in the batch is reused, along with the
+  // origin of the draw that encoded it
+  if (self->current_transform_index > 0
+      && batch_accepts (self->batch,
+                        format,
+                        RECT_MAX_INSTANCES,
+                        RECT_MAX_DYN_ATTR_SAMPLES))
+    {
+      origin[0] = self->current_transform_origin[0];
+      origin[1] = self->current_transform_origin[1];
+    }
+  else
+    {
+      origin[0] = left - self->aa_offset / 2.0;
+      origin[1] = top - self->aa_offset / 2.0;
+    }
+
+  if (area_is_culled (self,
+                      left - self->aa_offset / 2.0,
+                      top - self->aa_offset / 2.0,
+                      left + width + self->aa_offset / 2.0,
+                      top + height + self->aa_offset / 2.0,
+                      origin[0], origin[1]))
     {
-      // @TODO: flush batch
+      self->stats.culled_instances += rect_num_instances (self, style);
       return;
     }
 
+  ensure_batch_room (self,
+                     format,
+                     RECT_MAX_INSTANCES,
+                     RECT_MAX_DYN_ATTR_SAMPLES);
+
   GlrLayout lyt;
   GlrInstanceConfig config = {0};
   GlrBorder *br = &(style->border);
   GlrBackground *bg = &(style->background);
   GlrColor color;
 
-  bool has_transform = has_any_transform (&self->transform);
+  bool has_transform = self->effective_class >= TRANSFORM_AFFINE_2D;
   bool has_border = has_any_border (br);
   bool has_background = bg->type != GLR_BACKGROUND_NONE;
+  bool has_gradient = bg->type == GLR_BACKGROUND_LINEAR_GRADIENT;
+
+  // rounded corners need the more expensive shader program
+  GlrInstanceClass corner_class = GLR_INSTANCE_CLASS_SOLID;
+  if (has_border
+      && (br->radius[0] > 0.0 || br->radius[1] > 0.0
+          || br->radius[2] > 0.0 || br->radius[3] > 0.0))
+    {
+      corner_class = GLR_INSTANCE_CLASS_ROUNDED;
+    }
+
+  // background, border and corners all in one instance
+  if (draws_as_box (self, br))
+    {
+      lyt.left = left - self->aa_offset / 2.0;
+      lyt.top = top - self->aa_offset / 2.0;
+      lyt.width = width + self->aa_offset;
+      lyt.height = height + self->aa_offset;
+
+      encode_and_store_clip_and_transform (self,
+                                           lyt.left, lyt.top,
+                                           lyt.left + lyt.width,
+                                           lyt.top + lyt.height,
+                                           config);
+
+      instance_config_set_type (config, GLR_INSTANCE_BOX);
+      encode_and_store_box (self, br, config);
+
+      if (has_background)
+        encode_and_store_background (self, bg, config);
+
+      add_instance (self,
+                    has_gradient ? GLR_INSTANCE_CLASS_GRADIENT
+                    : GLR_INSTANCE_CLASS_ROUNDED,
+                    &lyt,
+                    has_background ? bg->color : GLR_COLOR_NONE,
+                    config);
+      return;
+    }
 
   // encode and submit border, which is common to all sub-instances
   if (has_border)
-    encode_and_store_border (self->batch, br, config);
+    encode_and_store_border (self, br, config);
 
   lyt.left = left - self->aa_offset / 2.0;
   lyt.top = top - self->aa_offset / 2.0;
 
-  if (has_transform && (has_border || has_background))
-    encode_and_store_transform (self,
-                                lyt.left, lyt.top,
-                                &self->transform,
-                                config);
+  if (has_border || has_background)
+    encode_and_store_clip_and_transform (self,
+                                         lyt.left, lyt.top,
+                                         left + width + self->aa_offset / 2.0,
+                                         top + height + self->aa_offset / 2.0,
+                                         config);
+
+  // untransformed solid backgrounds on pixel boundaries skip the edge
+  // anti-aliasing, and so the fringe around them. Not retained, animated or
+  // scrolled ones, which may be moved off those boundaries later
+  if (has_background
+      && ! has_border
+      && ! has_transform
+      && ! has_gradient
+      && self->retained == NULL
+      && ! self->animated
+      && self->scroll_node == 0
+      && is_pixel_aligned (left, top, width, height))
+    {
+      GlrLayout aligned_lyt = { left, top, width, height };
+
+      instance_config_set_type (config, GLR_INSTANCE_RECT_ALIGNED);
+      add_instance (self,
+                    GLR_INSTANCE_CLASS_SOLID,
+                    &aligned_lyt, bg->color, config);
+    }
 
   // background
-  if (has_background)
+  else if (has_background)
     {
       instance_config_set_type (config, GLR_INSTANCE_RECT_BG);
 
       color = bg->color;
-      encode_and_store_background (self->batch,
-                                   bg,
-                                   config);
+      encode_and_store_background (self, bg, config);
 
       lyt.width = width + self->aa_offset;
       lyt.height = height + self->aa_offset;
 
-      glr_batch_add_instance (self->batch, &lyt, color, config);
+      add_instance (self,
+                    has_gradient ? GLR_INSTANCE_CLASS_GRADIENT
+                    : corner_class,
+                    &lyt, color, config);
     }
 
   if (! has_border)
@@ -788,7 +2738,9 @@ glr_canvas_draw_rect (GlrCanvas *self,
       lyt.left = left - self->aa_offset / 2.0;
       lyt.top = top + MAX (br->radius[0], br->width[1]);
 
-      glr_batch_add_instance (self->batch, &lyt, br->color[0], config);
+      add_instance (self,
+                    GLR_INSTANCE_CLASS_SOLID,
+                    &lyt, br->color[0], config);
     }
 
   // top border
@@ -803,7 +2755,9 @@ glr_canvas_draw_rect (GlrCanvas *self,
       lyt.left = left + MAX (br->radius[0], br->width[0]);
       lyt.top = top - self->aa_offset / 2.0;
 
-      glr_batch_add_instance (self->batch, &lyt, br->color[1], config);
+      add_instance (self,
+                    GLR_INSTANCE_CLASS_SOLID,
+                    &lyt, br->color[1], config);
     }
 
   // right border
@@ -818,7 +2772,9 @@ glr_canvas_draw_rect (GlrCanvas *self,
       lyt.left = left - self->aa_offset / 2.0 + width - br->width[2];
       lyt.top = top + MAX (br->radius[1], br->width[1]);
 
-      glr_batch_add_instance (self->batch, &lyt, br->color[2], config);
+      add_instance (self,
+                    GLR_INSTANCE_CLASS_SOLID,
+                    &lyt, br->color[2], config);
     }
 
   // bottom border
@@ -833,7 +2789,9 @@ glr_canvas_draw_rect (GlrCanvas *self,
       lyt.left = left + MAX (br->radius[3], br->width[0]);
       lyt.top = top - self->aa_offset / 2.0 + height - br->width[3];
 
-      glr_batch_add_instance (self->batch, &lyt, br->color[3], config);
+      add_instance (self,
+                    GLR_INSTANCE_CLASS_SOLID,
+                    &lyt, br->color[3], config);
     }
 
   // top-left corner
@@ -844,7 +2802,9 @@ glr_canvas_draw_rect (GlrCanvas *self,
   lyt.left = left - self->aa_offset / 2.0;
   lyt.top = top - self->aa_offset / 2.0;
 
-  glr_batch_add_instance (self->batch, &lyt, br->color[0], config);
+  add_instance (self,
+                corner_class,
+                &lyt, br->color[0], config);
 
   // top-right corner
   instance_config_set_type (config, GLR_INSTANCE_BORDER_TOP_RIGHT);
@@ -855,7 +2815,9 @@ glr_canvas_draw_rect (GlrCanvas *self,
     + width - MAX (br->radius[1], br->width[2]) + self->aa_offset / 2.0;
   lyt.top = top - self->aa_offset / 2.0;
 
-  glr_batch_add_instance (self->batch, &lyt, br->color[1], config);
+  add_instance (self,
+                corner_class,
+                &lyt, br->color[1], config);
 
   // bottom-right corner
   instance_config_set_type (config, GLR_INSTANCE_BORDER_BOTTOM_RIGHT);
@@ -867,7 +2829,9 @@ glr_canvas_draw_rect (GlrCanvas *self,
   lyt.top = top - self->aa_offset / 2.0
     + height - MAX (br->radius[2], br->width[3]) + self->aa_offset / 2.0;
 
-  glr_batch_add_instance (self->batch, &lyt, br->color[2], config);
+  add_instance (self,
+                corner_class,
+                &lyt, br->color[2], config);
 
   // bottom-left corner
   instance_config_set_type (config, GLR_INSTANCE_BORDER_BOTTOM_LEFT);
@@ -878,7 +2842,9 @@ glr_canvas_draw_rect (GlrCanvas *self,
   lyt.top = top - self->aa_offset / 2.0
     + height - MAX (br->radius[3], br->width[3]) + self->aa_offset / 2.0;
 
-  glr_batch_add_instance (self->batch, &lyt, br->color[3], config);
+  add_instance (self,
+                corner_class,
+                &lyt, br->color[3], config);
 }
 
 void
@@ -894,9 +2860,14 @@ glr_canvas_draw_char (GlrCanvas *self,
   const GlrTexSurface *surface;
   float tex_area[4] = {0};
 
-  if (glr_batch_is_full (self->batch))
+  retain_area (self, left, top, 0.0, 0.0);
+
+  apply_translation (self, &left, &top);
+  color = apply_opacity (self, color);
+
+  if (glyph_is_culled (self, left, top, font))
     {
-      // @TODO: need flusing
+      self->stats.culled_instances++;
       return;
     }
 
@@ -917,14 +2888,20 @@ glr_canvas_draw_char (GlrCanvas *self,
   lyt.width = surface->pixel_width;
   lyt.height = surface->pixel_height;
 
+  ensure_batch_room (self,
+                     instance_format_for_area (self,
+                                               lyt.left, lyt.top,
+                                               lyt.width, lyt.height),
+                     1,
+                     CHAR_MAX_DYN_ATTR_SAMPLES);
+
   instance_config_set_type (config, GLR_INSTANCE_CHAR_GLYPH);
 
-  if (has_any_transform (&self->transform))
-    encode_and_store_transform (self,
-                                lyt.left,
-                                lyt.top,
-                                &self->transform,
-                                config);
+  encode_and_store_clip_and_transform (self,
+                                       lyt.left, lyt.top,
+                                       lyt.left + lyt.width,
+                                       lyt.top + lyt.height,
+                                       config);
 
   tex_area[0] = surface->left;
   tex_area[1] = surface->top;
@@ -933,14 +2910,16 @@ glr_canvas_draw_char (GlrCanvas *self,
 
   // @FIXME: move this to a more general way of describing background
   size_t offset;
-  offset = glr_batch_add_dyn_attr (self->batch, tex_area, sizeof (float) * 4);
+  offset = store_dyn_attr (self, tex_area, sizeof (float) * 4);
   config[2] = offset;
 
   // bits 12 to 15 (4 bits) of config0 encode the texture unit to use,
   // either for glyphs, background-image or border-image
   config[0] |= surface->tex_id << 12;
 
-  glr_batch_add_instance (self->batch, &lyt, color, config);
+  add_instance (self,
+                GLR_INSTANCE_CLASS_GLYPH,
+                &lyt, color, config);
 }
 
 void
@@ -954,13 +2933,293 @@ glr_canvas_draw_char_unicode (GlrCanvas *self,
   assert (self != NULL);
   assert (font != NULL);
 
-  FT_Face face;
-  face = glr_tex_cache_lookup_face (self->tex_cache,
-                                    font->face,
-                                    font->face_index);
-
-  FT_UInt glyph_index;
-  glyph_index = FT_Get_Char_Index (face, unicode_char);
+  uint32_t glyph_index;
+  glyph_index = glr_tex_cache_lookup_char_index (self->tex_cache,
+                                                 font->face,
+                                                 font->face_index,
+                                                 unicode_char);
 
   glr_canvas_draw_char (self, glyph_index, left, top, font, color);
 }
+
+void
+glr_canvas_draw_rects (GlrCanvas      *self,
+                       size_t          count,
+                       const float    *positions,
+                       const float    *sizes,
+                       const GlrColor *colors,
+                       GlrStyle       *style)
+{
+  assert (self != NULL);
+  assert (positions != NULL);
+  assert (sizes != NULL);
+  assert (style != NULL);
+
+  GlrBackground *bg;
+  GlrStyle faded_style;
+  GlrLayout layouts[BULK_CHUNK_SIZE];
+  GlrColor chunk_colors[BULK_CHUNK_SIZE];
+  GlrInstanceClass klass;
+  size_t i = 0;
+
+  // rects with borders take several instances of different classes, and
+  // transforms other than a translation depend on each rect's origin
+  if (has_any_border (&style->border) || ! is_translation_only (&self->transform))
+    {
+      GlrStyle rect_style = *style;
+
+      for (i = 0; i < count; i++)
+        {
+          if (colors != NULL)
+            rect_style.background.color = colors[i];
+
+          glr_canvas_draw_rect (self,
+                                positions[i * 2], positions[i * 2 + 1],
+                                sizes[i * 2], sizes[i * 2 + 1],
+                                &rect_style);
+        }
+
+      return;
+    }
+
+  style = apply_opacity_to_style (self, style, &faded_style);
+  bg = &(style->background);
+
+  if (bg->type == GLR_BACKGROUND_NONE)
+    return;
+
+  if (bg->type == GLR_BACKGROUND_LINEAR_GRADIENT)
+    klass = GLR_INSTANCE_CLASS_GRADIENT;
+  else
+    klass = GLR_INSTANCE_CLASS_SOLID;
+
+  while (i < count)
+    {
+      GlrInstanceConfig config = {0};
+      float area[4] = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+      size_t n = 0;
+      bool aligned = klass == GLR_INSTANCE_CLASS_SOLID
+        && self->effective_class < TRANSFORM_AFFINE_2D
+        && self->retained == NULL
+        && ! self->animated
+        && self->scroll_node == 0;
+
+      for (; i < count && n < BULK_CHUNK_SIZE; i++)
+        {
+          float pos[2] = { positions[i * 2], positions[i * 2 + 1] };
+          const float *size = &sizes[i * 2];
+          GlrLayout *lyt = &layouts[n];
+
+          retain_area (self, pos[0], pos[1], size[0], size[1]);
+
+          apply_translation (self, &pos[0], &pos[1]);
+
+          if (area_is_culled (self,
+                              pos[0] - self->aa_offset / 2.0,
+                              pos[1] - self->aa_offset / 2.0,
+                              pos[0] + size[0] + self->aa_offset / 2.0,
+                              pos[1] + size[1] + self->aa_offset / 2.0,
+                              0.0, 0.0))
+            {
+              self->stats.culled_instances++;
+              continue;
+            }
+
+          // layouts are kept exact until the chunk is known to need
+          // anti-aliasing
+          lyt->left = pos[0];
+          lyt->top = pos[1];
+          lyt->width = size[0];
+          lyt->height = size[1];
+
+          aligned = aligned
+            && is_pixel_aligned (pos[0], pos[1], size[0], size[1]);
+
+          area[0] = MIN (area[0], pos[0]);
+          area[1] = MIN (area[1], pos[1]);
+          area[2] = MAX (area[2], pos[0] + size[0]);
+          area[3] = MAX (area[3], pos[1] + size[1]);
+
+          if (colors != NULL)
+            chunk_colors[n] = apply_opacity (self, colors[i]);
+          else
+            chunk_colors[n] = bg->color;
+          n++;
+        }
+
+      if (n == 0)
+        continue;
+
+      ensure_batch_room (self,
+                         instance_format_for_area (self,
+                                                   area[0], area[1],
+                                                   area[2] - area[0],
+                                                   area[3] - area[1]),
+                         n,
+                         RECT_MAX_DYN_ATTR_SAMPLES);
+
+      // all rects of the chunk share their config. Chunks of solid rects
+      // all on pixel boundaries go without anti-aliasing
+      if (aligned)
+        {
+          instance_config_set_type (config, GLR_INSTANCE_RECT_ALIGNED);
+        }
+      else
+        {
+          size_t j;
+
+          for (j = 0; j < n; j++)
+            {
+              layouts[j].left -= self->aa_offset / 2.0;
+              layouts[j].top -= self->aa_offset / 2.0;
+              layouts[j].width += self->aa_offset;
+              layouts[j].height += self->aa_offset;
+            }
+
+          instance_config_set_type (config, GLR_INSTANCE_RECT_BG);
+          encode_and_store_background (self, bg, config);
+        }
+
+      // the transform is known to not depend on the origin
+      encode_and_store_clip_and_transform (self,
+                                           area[0] - self->aa_offset / 2.0,
+                                           area[1] - self->aa_offset / 2.0,
+                                           area[2] + self->aa_offset / 2.0,
+                                           area[3] + self->aa_offset / 2.0,
+                                           config);
+
+      add_instances (self,
+                     klass,
+                     n,
+                     layouts,
+                     chunk_colors,
+                     (const GlrInstanceConfig *) config,
+                     true);
+    }
+}
+
+void
+glr_canvas_draw_glyph_run (GlrCanvas      *self,
+                           size_t          count,
+                           const uint32_t *glyph_ids,
+                           const float    *positions,
+                           GlrFont        *font,
+                           GlrColor        color)
+{
+  assert (self != NULL);
+  assert (glyph_ids != NULL);
+  assert (positions != NULL);
+  assert (font != NULL);
+
+  GlrLayout layouts[BULK_CHUNK_SIZE];
+  GlrColor colors[BULK_CHUNK_SIZE];
+  GlrInstanceConfig configs[BULK_CHUNK_SIZE];
+  float tex_areas[BULK_CHUNK_SIZE][4];
+  size_t i = 0;
+  size_t j;
+
+  // transforms other than a translation depend on each glyph's origin
+  if (! is_translation_only (&self->transform))
+    {
+      for (i = 0; i < count; i++)
+        glr_canvas_draw_char (self,
+                              glyph_ids[i],
+                              positions[i * 2], positions[i * 2 + 1],
+                              font,
+                              color);
+      return;
+    }
+
+  color = apply_opacity (self, color);
+  for (j = 0; j < BULK_CHUNK_SIZE; j++)
+    colors[j] = color;
+
+  while (i < count)
+    {
+      GlrInstanceConfig transform_config = {0};
+      float area[4] = { INFINITY, INFINITY, -INFINITY, -INFINITY };
+      size_t n = 0;
+
+      // look up the glyphs first, since their areas decide the batch format
+      for (; i < count && n < BULK_CHUNK_SIZE; i++)
+        {
+          const GlrTexSurface *surface;
+          GlrLayout *lyt = &layouts[n];
+          float pen[2] = { positions[i * 2], positions[i * 2 + 1] };
+
+          retain_area (self, pen[0], pen[1], 0.0, 0.0);
+
+          apply_translation (self, &pen[0], &pen[1]);
+
+          if (glyph_is_culled (self, pen[0], pen[1], font))
+            {
+              self->stats.culled_instances++;
+              continue;
+            }
+
+          surface = glr_tex_cache_lookup_font_glyph (self->tex_cache,
+                                                     font->face,
+                                                     font->face_index,
+                                                     font->size,
+                                                     glyph_ids[i]);
+          if (surface == NULL)
+            continue;
+
+          lyt->left = pen[0] + surface->pixel_left;
+          lyt->top = pen[1] - surface->pixel_top;
+          lyt->width = surface->pixel_width;
+          lyt->height = surface->pixel_height;
+
+          area[0] = MIN (area[0], lyt->left);
+          area[1] = MIN (area[1], lyt->top);
+          area[2] = MAX (area[2], lyt->left + lyt->width);
+          area[3] = MAX (area[3], lyt->top + lyt->height);
+
+          tex_areas[n][0] = surface->left;
+          tex_areas[n][1] = surface->top;
+          tex_areas[n][2] = surface->width;
+          tex_areas[n][3] = surface->height;
+
+          memset (configs[n], 0, sizeof (GlrInstanceConfig));
+          instance_config_set_type (configs[n], GLR_INSTANCE_CHAR_GLYPH);
+          configs[n][0] |= surface->tex_id << 12;
+
+          n++;
+        }
+
+      if (n == 0)
+        continue;
+
+      ensure_batch_room (self,
+                         instance_format_for_area (self,
+                                                   area[0], area[1],
+                                                   area[2] - area[0],
+                                                   area[3] - area[1]),
+                         n,
+                         n + 2 + ANIMATION_NUM_SAMPLES + 4
+                         /* tex areas + clip + animation + transform */);
+
+      // the transform is known to not depend on the origin
+      encode_and_store_clip_and_transform (self,
+                                           area[0], area[1],
+                                           area[2], area[3],
+                                           transform_config);
+
+      for (j = 0; j < n; j++)
+        {
+          configs[j][0] |= transform_config[0];
+          configs[j][1] = transform_config[1];
+          configs[j][2] = store_dyn_attr (self,
+                                          tex_areas[j],
+                                          sizeof (float) * 4);
+        }
+
+      add_instances (self,
+                     GLR_INSTANCE_CLASS_GLYPH,
+                     n,
+                     layouts,
+                     colors,
+                     configs,
+                     false);
+    }
+}
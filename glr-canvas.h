@@ -2,13 +2,95 @@
 #define _GLR_CANVAS_H_
 
 #include "glr-context.h"
+#include "glr-display-list.h"
 #include "glr-target.h"
 #include "glr-style.h"
 
 typedef struct _GlrCanvas GlrCanvas;
 
+/* see glr-recorder.h */
+typedef struct _GlrRecorder GlrRecorder;
+
+typedef enum
+  {
+    GLR_CANVAS_FLAGS_NONE        =      0,
+    /* store instances in a 16-byte format, with the layout quantized to
+       1/8 of a pixel. Rects beyond about 4096 pixels use the full format */
+    GLR_CANVAS_COMPACT_INSTANCES = 1 << 0,
+    /* draw rects with a border or rounded corners as a single instance,
+       whose coverage comes from the distance to its edges, instead of one
+       instance per side and corner. Only for borders whose sides share
+       color and style */
+    GLR_CANVAS_SDF_BOXES         = 1 << 1
+  } GlrCanvasFlags;
+
+/* counters since the last glr_canvas_clear() */
+typedef struct
+{
+  /* border, background, transform and glyph descriptions that resolved to an
+     identical one already stored in the batch, versus newly stored ones */
+  size_t dyn_attrs_intern_hits;
+  size_t dyn_attrs_intern_misses;
+
+  /* instances skipped because they would land outside the target */
+  size_t culled_instances;
+
+  /* transforms encoded into a batch, versus draws that reused one already
+     encoded in it with the same value and origin */
+  size_t transforms_encoded;
+  size_t transforms_reused;
+
+  /* times the CPU had to wait for the GPU to be done with the instances of
+     an earlier frame before reusing their buffers, see
+     glr_context_set_frames_in_flight() */
+  size_t fence_waits;
+} GlrCanvasStats;
+
+typedef enum
+  {
+    GLR_ANIMATION_LINEAR = 0,
+    GLR_ANIMATION_EASE_IN_OUT
+  } GlrAnimationTiming;
+
+/* the state an animation goes from or to. The rotation is around the z
+   axis, in radians */
+typedef struct
+{
+  float rotate;
+  float scale[2];
+  float translate[2];
+  float opacity;
+} GlrAnimationFrame;
+
+/* a transition evaluated on the GPU for each frame, against the time given
+   to glr_canvas_set_time(). It goes from 'from' to 'to' in 'duration'
+   seconds, starting at 'start_time', 'iterations' times or forever if
+   zero, reversing every other iteration if 'alternate' is set. It holds
+   'from' before starting and the last value reached after ending.
+   Rotation and scale happen around 'origin', and all of it before the
+   transform of the canvas */
+typedef struct
+{
+  float start_time;
+  float duration;
+  float iterations;
+  bool alternate;
+  GlrAnimationTiming timing;
+
+  float origin[2];
+  GlrAnimationFrame from;
+  GlrAnimationFrame to;
+} GlrAnimation;
+
+void                glr_animation_init              (GlrAnimation *self,
+                                                     float         start_time,
+                                                     float         duration);
+
 GlrCanvas *         glr_canvas_new                  (GlrContext *context,
                                                      GlrTarget  *target);
+GlrCanvas *         glr_canvas_new_full             (GlrContext     *context,
+                                                     GlrTarget      *target,
+                                                     GlrCanvasFlags  flags);
 GlrCanvas *         glr_canvas_ref                  (GlrCanvas *self);
 void                glr_canvas_unref                (GlrCanvas *self);
 
@@ -19,6 +101,9 @@ void                glr_canvas_flush                (GlrCanvas *self);
 void                glr_canvas_clear                (GlrCanvas *self,
                                                      GlrColor   color);
 
+void                glr_canvas_get_stats            (GlrCanvas      *self,
+                                                     GlrCanvasStats *stats);
+
 void                glr_canvas_translate            (GlrCanvas *self,
                                                      float      x,
                                                      float      y,
@@ -37,6 +122,94 @@ void                glr_canvas_scale                (GlrCanvas *self,
                                                      float      scale_z);
 void                glr_canvas_reset_transform      (GlrCanvas *self);
 
+/* pushes the current transform and opacity, which glr_canvas_restore()
+   brings back. Transforms and opacity set in between apply on top of the
+   saved ones. Note that a draw rotates and scales around the transform
+   origin taken from its own top-left corner, while a saved transform
+   takes it from the top-left corner of the canvas, once for all the draws
+   that follow. So saving a rotation or scale changes where it happens,
+   unless the origin is set to the position of the draws in canvas
+   coordinates before saving */
+void                glr_canvas_save                 (GlrCanvas *self);
+void                glr_canvas_restore              (GlrCanvas *self);
+
+/* from 0.0, transparent, to 1.0, the default */
+void                glr_canvas_set_opacity          (GlrCanvas *self,
+                                                     float      opacity);
+
+/* animates the draws that follow, until set to NULL. The animation is
+   copied. It is not part of the state saved by glr_canvas_save(), and the
+   draws it applies to are never culled */
+void                glr_canvas_set_animation        (GlrCanvas          *self,
+                                                     const GlrAnimation *animation);
+/* the time animations are evaluated at on the next flush, in seconds */
+void                glr_canvas_set_time             (GlrCanvas *self,
+                                                     float      time);
+
+/* the scroll node the draws that follow move with, from 1 to 15, or 0 for
+   none, the default. It is not part of the state saved by glr_canvas_save(),
+   and the draws it applies to are never culled */
+void                glr_canvas_set_scroll_node      (GlrCanvas *self,
+                                                     uint32_t   node);
+/* moves everything drawn with 'node' by 'dx', 'dy' on the next flush,
+   after its transform, without encoding it again. Display lists recorded
+   with it move too. Clips stay in place, so scrolled content can be
+   clipped to the area it scrolls in */
+void                glr_canvas_set_scroll_offset    (GlrCanvas *self,
+                                                     uint32_t   node,
+                                                     float      dx,
+                                                     float      dy);
+
+/* restricts draws to an area, intersected with the clips already pushed,
+   until glr_canvas_pop_clip(). The area takes the current transform like
+   a rect drawn there would. Other than translations and scales, that
+   clips to the bounding box of the transformed area, without rounded
+   corners. Under a 3D transform nothing more is clipped, with a warning,
+   and the matching glr_canvas_pop_clip() is still needed. 'radii' round the top-left, top-right, bottom-left and
+   bottom-right corners. glr_canvas_restore() pops the clips pushed since
+   the matching glr_canvas_save() */
+void                glr_canvas_push_clip_rect       (GlrCanvas *self,
+                                                     float      left,
+                                                     float      top,
+                                                     float      width,
+                                                     float      height);
+void                glr_canvas_push_rounded_clip_rect (GlrCanvas   *self,
+                                                       float        left,
+                                                       float        top,
+                                                       float        width,
+                                                       float        height,
+                                                       const float  radii[4]);
+void                glr_canvas_pop_clip             (GlrCanvas *self);
+
+/* draws between these two are recorded into a display list instead of the
+   frame, and are not culled against the viewport. They take the state of
+   the canvas as it is while recording, and the canvas must not be cleared
+   or flushed in between */
+void                glr_canvas_begin_display_list   (GlrCanvas *self);
+GlrDisplayList *    glr_canvas_end_display_list     (GlrCanvas *self);
+
+/* while recording a display list, the draws between these two can be
+   changed in place later through the returned handle, which the list
+   owns. They are drawn with anti-aliased edges and with the current clip,
+   wherever they end up. Draws under a rotation, scale or 3D transform
+   can't be moved that way, so they are left out with a warning */
+void                glr_canvas_begin_retained       (GlrCanvas *self);
+GlrRetained *       glr_canvas_end_retained         (GlrCanvas *self);
+
+/* draws the instances of 'list' with the current transform applied, as
+   for a single draw at the origin of the canvas. Opacity and clips set on
+   the canvas do not apply */
+void                glr_canvas_draw_display_list    (GlrCanvas      *self,
+                                                     GlrDisplayList *list);
+
+/* draws what was recorded into 'count' recorders, one after the other in
+   the given order, as if drawn on the canvas with its transform reset.
+   Their instances are uploaded when the canvas is flushed, and they must
+   not be drawn to or reset until then */
+void                glr_canvas_draw_recorders       (GlrCanvas    *self,
+                                                     size_t        count,
+                                                     GlrRecorder **recorders);
+
 void                glr_canvas_draw_rect            (GlrCanvas *self,
                                                      float      left,
                                                      float      top,
@@ -56,4 +229,21 @@ void                glr_canvas_draw_char_unicode    (GlrCanvas *self,
                                                      GlrFont   *font,
                                                      GlrColor   color);
 
+/* bulk versions of the above. 'positions' and 'sizes' hold 'count' pairs of
+   left, top and width, height respectively. 'colors' overrides the style's
+   background color of each rect, and may be NULL. 'glyph_ids' are glyph
+   indices, as passed to glr_canvas_draw_char() */
+void                glr_canvas_draw_rects           (GlrCanvas      *self,
+                                                     size_t          count,
+                                                     const float    *positions,
+                                                     const float    *sizes,
+                                                     const GlrColor *colors,
+                                                     GlrStyle       *style);
+void                glr_canvas_draw_glyph_run       (GlrCanvas      *self,
+                                                     size_t          count,
+                                                     const uint32_t *glyph_ids,
+                                                     const float    *positions,
+                                                     GlrFont        *font,
+                                                     GlrColor        color);
+
 #endif /* _GLR_CANVAS_H_ */
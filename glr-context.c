@@ -2,26 +2,346 @@
 
 #include <assert.h>
 #include <glib.h>
+#include <stdio.h>
+#include <string.h>
 #include "glr-priv.h"
+#include "glr-shaders.h"
+
+/* texture units whose bindings are tracked: the glyph cache's and the
+   batches' dyn attrs texture */
+#define TRACKED_TEXTURE_UNITS 9
+
+/* value of a piece of tracked GL state after it is invalidated, which
+   never matches anything being set */
+#define UNKNOWN_STATE 0xFFFFFFFF
+
+/* the GL state glr last set during a flush, so redundant calls can be
+   skipped. Other code may change it between flushes, so it is invalidated
+   at the start of each one, and GL calls made outside a flush don't go
+   through it */
+typedef struct
+{
+  GLuint program;
+  GLuint framebuffer;
+  GLuint vertex_array;
+  GLuint active_texture;
+  GLuint textures[TRACKED_TEXTURE_UNITS];
+  GLuint blend;
+  GLuint depth_test;
+  GLuint depth_mask;
+} GlState;
 
 struct _GlrContext
 {
   int ref_count;
 
   GlrTexCache *tex_cache;
+
+  /* GL entry points, resolved once */
+  GlrSymbols gl;
+
+  GlrContextCaps caps;
+  char *extensions;
+
+  /* one program per instance class, shared by all canvases. Built on
+     first use, going through the binary cache in 'program_cache_dir'
+     when set */
+  GlrProgram programs[GLR_INSTANCE_NUM_CLASSES];
+  bool programs_built;
+  char *program_cache_dir;
+
+  GlState state;
+
+  /* GPU memory used by the dyn attrs textures of all batches, and the
+     maximum allowed (0 means no limit). Batches of recorders reserve it
+     from their own threads, so it is only touched with the mutex held */
+  GMutex dyn_attrs_mutex;
+  size_t dyn_attrs_memory_usage;
+  size_t dyn_attrs_memory_limit;
+
+  /* how many frames batches keep the instances of before reusing their
+     buffers, see glr_context_set_frames_in_flight() */
+  uint32_t frames_in_flight;
 };
 
 static void
 glr_context_free (GlrContext *self)
 {
+  int i;
+
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    glr_program_destroy (&self->programs[i], &self->gl);
+  g_free (self->program_cache_dir);
+
   glr_tex_cache_unref (self->tex_cache);
 
+  g_free (self->extensions);
+
+  g_mutex_clear (&self->dyn_attrs_mutex);
+
   free (self);
   self = NULL;
 
   printf ("GlrContext freed\n");
 }
 
+static void
+detect_caps (GlrContext *self)
+{
+  GlrContextCaps *caps = &self->caps;
+  const char *version;
+  const char *extensions;
+  const char *backend;
+
+  // e.g "OpenGL ES 3.1 Mesa 20.0.8", or "3.3.0 NVIDIA 440.100" on desktop
+  version = (const char *) self->gl.GetString (GL_VERSION);
+  if (version != NULL && g_str_has_prefix (version, "OpenGL ES "))
+    {
+      caps->is_gles = true;
+      version += strlen ("OpenGL ES ");
+    }
+
+  if (version == NULL
+      || sscanf (version, "%d.%d",
+                 &caps->version_major,
+                 &caps->version_minor) != 2)
+    {
+      g_warning ("Failed to parse the OpenGL version, assuming ES 3.0");
+      caps->is_gles = true;
+      caps->version_major = 3;
+      caps->version_minor = 0;
+    }
+
+  extensions = (const char *) self->gl.GetString (GL_EXTENSIONS);
+  self->extensions = g_strdup (extensions != NULL ? extensions : "");
+
+  self->gl.GetIntegerv (GL_MAX_TEXTURE_SIZE, &caps->max_texture_size);
+
+  // both ES 3.0 and desktop GL 3.0 have integer vertex attributes and sync
+  // objects
+  caps->integer_vertex_attribs = caps->version_major >= 3;
+  caps->fence_sync = caps->version_major >= 3;
+
+  // the Mali fbdev driver reads integer attributes wrongly, but gets the
+  // raw words when they are declared as unsigned ints
+  backend = getenv ("GLR_BACKEND");
+  if (backend != NULL && strcmp (backend, "fbdev") == 0)
+    {
+      caps->integer_vertex_attribs = false;
+      caps->legacy_config_attr_type = GL_UNSIGNED_INT;
+    }
+  else
+    {
+      caps->legacy_config_attr_type = GL_FLOAT;
+    }
+}
+
+/* internal API */
+
+const GlrSymbols *
+glr_context_get_symbols (GlrContext *self)
+{
+  return &self->gl;
+}
+
+const GlrContextCaps *
+glr_context_get_caps (GlrContext *self)
+{
+  return &self->caps;
+}
+
+GlrProgram *
+glr_context_get_programs (GlrContext *self)
+{
+  // variants of the fragment shader, generated by the Makefile
+  const char *fragment_shader_sources[GLR_INSTANCE_NUM_CLASSES] = {
+    INSTANCED_FRAGMENT_SHADER_SOLID_SRC,
+    INSTANCED_FRAGMENT_SHADER_ROUNDED_SRC,
+    INSTANCED_FRAGMENT_SHADER_GRADIENT_SRC,
+    INSTANCED_FRAGMENT_SHADER_GLYPH_SRC
+  };
+  int i;
+
+  if (self->programs_built)
+    return self->programs;
+
+  for (i = 0; i < GLR_INSTANCE_NUM_CLASSES; i++)
+    {
+      if (! glr_program_build (&self->programs[i],
+                               &self->gl,
+                               INSTANCED_VERTEX_SHADER_SRC,
+                               fragment_shader_sources[i],
+                               self->program_cache_dir))
+        {
+          g_warning ("Failed to build shader program %d", i);
+        }
+    }
+
+  self->programs_built = true;
+
+  return self->programs;
+}
+
+bool
+glr_context_has_extension (GlrContext *self, const char *name)
+{
+  size_t len = strlen (name);
+  const char *ext = self->extensions;
+
+  // names in the list are separated by spaces, and some are prefixes of
+  // others
+  while ((ext = strstr (ext, name)) != NULL)
+    {
+      if ((ext == self->extensions || ext[-1] == ' ')
+          && (ext[len] == ' ' || ext[len] == '\0'))
+        {
+          return true;
+        }
+
+      ext += len;
+    }
+
+  return false;
+}
+
+void
+glr_context_invalidate_gl_state (GlrContext *self)
+{
+  memset (&self->state, 0xFF, sizeof (GlState));
+}
+
+void
+glr_context_use_program (GlrContext *self, GLuint program)
+{
+  if (self->state.program == program)
+    return;
+
+  self->gl.UseProgram (program);
+  self->state.program = program;
+}
+
+void
+glr_context_bind_framebuffer (GlrContext *self, GLuint framebuffer)
+{
+  if (self->state.framebuffer == framebuffer)
+    return;
+
+  self->gl.BindFramebuffer (GL_FRAMEBUFFER, framebuffer);
+  self->state.framebuffer = framebuffer;
+}
+
+void
+glr_context_bind_vertex_array (GlrContext *self, GLuint vertex_array)
+{
+  if (self->state.vertex_array == vertex_array)
+    return;
+
+  self->gl.BindVertexArray (vertex_array);
+  self->state.vertex_array = vertex_array;
+}
+
+/* binds 'texture' to the GL_TEXTURE_2D target of 'unit', and leaves that
+   unit active */
+void
+glr_context_bind_texture (GlrContext *self, GLuint unit, GLuint texture)
+{
+  assert (unit < TRACKED_TEXTURE_UNITS);
+
+  if (self->state.active_texture != unit)
+    {
+      self->gl.ActiveTexture (GL_TEXTURE0 + unit);
+      self->state.active_texture = unit;
+    }
+
+  if (self->state.textures[unit] == texture)
+    return;
+
+  self->gl.BindTexture (GL_TEXTURE_2D, texture);
+  self->state.textures[unit] = texture;
+}
+
+void
+glr_context_set_blend (GlrContext *self, bool enabled)
+{
+  if (self->state.blend == enabled)
+    return;
+
+  if (enabled)
+    self->gl.Enable (GL_BLEND);
+  else
+    self->gl.Disable (GL_BLEND);
+  self->state.blend = enabled;
+}
+
+void
+glr_context_set_depth_test (GlrContext *self, bool enabled)
+{
+  if (self->state.depth_test == enabled)
+    return;
+
+  if (enabled)
+    self->gl.Enable (GL_DEPTH_TEST);
+  else
+    self->gl.Disable (GL_DEPTH_TEST);
+  self->state.depth_test = enabled;
+}
+
+void
+glr_context_set_depth_mask (GlrContext *self, bool enabled)
+{
+  if (self->state.depth_mask == enabled)
+    return;
+
+  self->gl.DepthMask (enabled ? GL_TRUE : GL_FALSE);
+  self->state.depth_mask = enabled;
+}
+
+static bool
+has_dyn_attrs_memory (GlrContext *self, size_t size)
+{
+  return self->dyn_attrs_memory_limit == 0
+    || self->dyn_attrs_memory_usage + size <= self->dyn_attrs_memory_limit;
+}
+
+bool
+glr_context_has_dyn_attrs_memory (GlrContext *self, size_t size)
+{
+  bool result;
+
+  g_mutex_lock (&self->dyn_attrs_mutex);
+  result = has_dyn_attrs_memory (self, size);
+  g_mutex_unlock (&self->dyn_attrs_mutex);
+
+  return result;
+}
+
+bool
+glr_context_reserve_dyn_attrs_memory (GlrContext *self, size_t size)
+{
+  bool result;
+
+  g_mutex_lock (&self->dyn_attrs_mutex);
+
+  result = has_dyn_attrs_memory (self, size);
+  if (result)
+    self->dyn_attrs_memory_usage += size;
+
+  g_mutex_unlock (&self->dyn_attrs_mutex);
+
+  return result;
+}
+
+void
+glr_context_release_dyn_attrs_memory (GlrContext *self, size_t size)
+{
+  g_mutex_lock (&self->dyn_attrs_mutex);
+
+  assert (self->dyn_attrs_memory_usage >= size);
+  self->dyn_attrs_memory_usage -= size;
+
+  g_mutex_unlock (&self->dyn_attrs_mutex);
+}
+
 /* public API */
 
 GlrContext *
@@ -32,18 +352,18 @@ glr_context_new (void)
   self = calloc (1, sizeof (GlrContext));
   self->ref_count = 1;
 
-  /* @TODO: detect OpenGL ES version */
-  const char *ver_st;
-  ver_st = (const char *) glGetString (GL_VERSION);
-  printf ("%s\n", ver_st);
+  if (! glr_symbols_resolve (&self->gl))
+    g_error ("Failed to resolve the GL entry points");
+
+  detect_caps (self);
+  printf ("%s\n%s\n",
+          (const char *) self->gl.GetString (GL_VERSION),
+          (const char *) self->gl.GetString (GL_VENDOR));
+  glr_context_invalidate_gl_state (self);
 
-  const char *ext_st;
-  ext_st = (const char *) glGetString (GL_EXTENSIONS);
-  printf ("%s\n", ext_st);
+  self->frames_in_flight = GLR_CONTEXT_MAX_FRAMES_IN_FLIGHT;
 
-  const char *vendor_st;
-  vendor_st = (const char *) glGetString (GL_VENDOR);
-  printf ("%s\n", vendor_st);
+  g_mutex_init (&self->dyn_attrs_mutex);
 
   self->tex_cache = glr_tex_cache_new (self);
 
@@ -76,3 +396,82 @@ glr_context_get_texture_cache (GlrContext *self)
 {
   return self->tex_cache;
 }
+
+size_t
+glr_context_get_dyn_attrs_memory_usage (GlrContext *self)
+{
+  assert (self != NULL);
+
+  size_t usage;
+
+  g_mutex_lock (&self->dyn_attrs_mutex);
+  usage = self->dyn_attrs_memory_usage;
+  g_mutex_unlock (&self->dyn_attrs_mutex);
+
+  return usage;
+}
+
+size_t
+glr_context_get_dyn_attrs_memory_limit (GlrContext *self)
+{
+  assert (self != NULL);
+
+  return self->dyn_attrs_memory_limit;
+}
+
+void
+glr_context_set_dyn_attrs_memory_limit (GlrContext *self, size_t limit)
+{
+  assert (self != NULL);
+
+  g_mutex_lock (&self->dyn_attrs_mutex);
+  self->dyn_attrs_memory_limit = limit;
+  g_mutex_unlock (&self->dyn_attrs_mutex);
+}
+
+/* sets the directory where linked shader programs are stored, so later
+   runs load them instead of compiling them again. NULL disables it, which
+   is the default. Only has effect before the first canvas is created */
+void
+glr_context_set_program_cache_dir (GlrContext *self, const char *path)
+{
+  assert (self != NULL);
+
+  g_free (self->program_cache_dir);
+  self->program_cache_dir = g_strdup (path);
+}
+
+const char *
+glr_context_get_program_cache_dir (GlrContext *self)
+{
+  assert (self != NULL);
+
+  return self->program_cache_dir;
+}
+
+uint32_t
+glr_context_get_frames_in_flight (GlrContext *self)
+{
+  assert (self != NULL);
+
+  return self->frames_in_flight;
+}
+
+/* sets how many frames the CPU may record while the GPU is still drawing
+   earlier ones, from 1 to GLR_CONTEXT_MAX_FRAMES_IN_FLIGHT. The instances
+   of a frame are only overwritten once a fence says the GPU is done with
+   them, waiting for it if needed, see GlrCanvasStats */
+void
+glr_context_set_frames_in_flight (GlrContext *self, uint32_t frames)
+{
+  assert (self != NULL);
+
+  if (frames < 1 || frames > GLR_CONTEXT_MAX_FRAMES_IN_FLIGHT)
+    {
+      g_warning ("Frames in flight must be between 1 and %d.",
+                 GLR_CONTEXT_MAX_FRAMES_IN_FLIGHT);
+      return;
+    }
+
+  self->frames_in_flight = frames;
+}
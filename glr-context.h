@@ -2,9 +2,14 @@
 #define _GLR_CONTEXT_H_
 
 #include "glr-tex-cache.h"
+#include <stddef.h>
+#include <stdint.h>
 
 typedef struct _GlrContext GlrContext;
 
+/* maximum of glr_context_set_frames_in_flight(), and its default */
+#define GLR_CONTEXT_MAX_FRAMES_IN_FLIGHT 3
+
 GlrContext *        glr_context_new                  (void);
 GlrContext *        glr_context_ref                  (GlrContext *self);
 void                glr_context_unref                (GlrContext *self);
@@ -14,4 +19,17 @@ void                glr_context_unlock_gl            (GlrContext *self);
 
 GlrTexCache *       glr_context_get_texture_cache    (GlrContext *self);
 
+size_t              glr_context_get_dyn_attrs_memory_usage (GlrContext *self);
+size_t              glr_context_get_dyn_attrs_memory_limit (GlrContext *self);
+void                glr_context_set_dyn_attrs_memory_limit (GlrContext *self,
+                                                            size_t      limit);
+
+void                glr_context_set_program_cache_dir (GlrContext *self,
+                                                       const char *path);
+const char *        glr_context_get_program_cache_dir (GlrContext *self);
+
+uint32_t            glr_context_get_frames_in_flight  (GlrContext *self);
+void                glr_context_set_frames_in_flight  (GlrContext *self,
+                                                       uint32_t    frames);
+
 #endif /* _GLR_CONTEXT_H_ */
@@ -0,0 +1,324 @@
+#include "glr-display-list.h"
+
+#include "glr-batch.h"
+#include "glr-priv.h"
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+typedef struct
+{
+  GlrBatch *batch;
+  GlrInstanceClass klass;
+  size_t index;
+  GlrLayout layout;
+  float translation[2];
+  bool fill;
+} RetainedInstance;
+
+struct _GlrRetained
+{
+  /* the instances as recorded, and the union of the areas of their draws
+     (left, top, right, bottom) */
+  GArray *instances;
+  float recorded_area[4];
+
+  float area[4];
+  float opacity;
+  bool visible;
+};
+
+struct _GlrDisplayList
+{
+  gint ref_count;
+
+  GlrContext *context;
+
+  /* the batches filled while recording, in drawing order. They are never
+     reset, so their instances and dyn attrs stay uploaded */
+  GPtrArray *batches;
+
+  GPtrArray *retained;
+};
+
+static void
+glr_display_list_free (GlrDisplayList *self)
+{
+  g_ptr_array_unref (self->retained);
+  g_ptr_array_unref (self->batches);
+
+  glr_context_unref (self->context);
+
+  g_slice_free (GlrDisplayList, self);
+  self = NULL;
+}
+
+/* internal API */
+
+/* takes ownership of 'batches', which must hold a reference to each
+   batch, and of the 'retained' handles into them */
+GlrDisplayList *
+glr_display_list_new (GlrContext *context,
+                      GPtrArray  *batches,
+                      GPtrArray  *retained)
+{
+  GlrDisplayList *self;
+
+  self = g_slice_new0 (GlrDisplayList);
+  self->ref_count = 1;
+
+  self->context = glr_context_ref (context);
+  self->batches = batches;
+  self->retained = retained;
+
+  return self;
+}
+
+GPtrArray *
+glr_display_list_get_batches (GlrDisplayList *self)
+{
+  return self->batches;
+}
+
+/* an edge keeps its distance to the nearest edge of the area, along one
+   axis. 'from' and 'to' hold the start and end of the area on that axis */
+static float
+remap_edge (float x, const float *from, const float *to)
+{
+  if (x - from[0] <= from[1] - x)
+    return to[0] + (x - from[0]);
+  else
+    return to[1] - (from[1] - x);
+}
+
+/* the offset of the area edge nearest to the span [start, end], which
+   moves a span that must keep its size */
+static float
+anchor_offset (float start, float end, const float *from, const float *to)
+{
+  if (start - from[0] <= from[1] - end)
+    return to[0] - from[0];
+  else
+    return to[1] - from[1];
+}
+
+static void
+update_instances (GlrRetained *self)
+{
+  float from_x[2] = { self->recorded_area[0], self->recorded_area[2] };
+  float from_y[2] = { self->recorded_area[1], self->recorded_area[3] };
+  float to_x[2] = { self->area[0], self->area[2] };
+  float to_y[2] = { self->area[1], self->area[3] };
+  guint i;
+
+  for (i = 0; i < self->instances->len; i++)
+    {
+      RetainedInstance *inst =
+        &g_array_index (self->instances, RetainedInstance, i);
+      const GlrLayout *l = &inst->layout;
+      GlrLayout lyt;
+      float right, bottom;
+
+      // glyphs only move, stretching them would distort the text
+      if (inst->klass == GLR_INSTANCE_CLASS_GLYPH)
+        {
+          lyt.left = l->left + anchor_offset (l->left, l->left + l->width,
+                                              from_x, to_x);
+          lyt.top = l->top + anchor_offset (l->top, l->top + l->height,
+                                            from_y, to_y);
+          right = lyt.left + l->width;
+          bottom = lyt.top + l->height;
+        }
+      else
+        {
+          lyt.left = remap_edge (l->left, from_x, to_x);
+          lyt.top = remap_edge (l->top, from_y, to_y);
+          right = remap_edge (l->left + l->width, from_x, to_x);
+          bottom = remap_edge (l->top + l->height, from_y, to_y);
+        }
+
+      // a hidden instance is collapsed, which the GPU skips right away
+      if (self->visible)
+        {
+          // edges anchored to opposite sides cross when the area shrinks
+          lyt.width = MAX (right - lyt.left, 0.0);
+          lyt.height = MAX (bottom - lyt.top, 0.0);
+        }
+      else
+        {
+          lyt.width = 0.0;
+          lyt.height = 0.0;
+        }
+
+      lyt.left += inst->translation[0];
+      lyt.top += inst->translation[1];
+
+      glr_batch_update_instance (inst->batch, inst->klass, inst->index,
+                                 &lyt, NULL);
+    }
+}
+
+GlrRetained *
+glr_retained_new (float opacity)
+{
+  GlrRetained *self;
+
+  self = g_slice_new0 (GlrRetained);
+  self->instances = g_array_new (FALSE, FALSE, sizeof (RetainedInstance));
+  self->recorded_area[0] = self->recorded_area[1] = INFINITY;
+  self->recorded_area[2] = self->recorded_area[3] = -INFINITY;
+  self->opacity = opacity;
+  self->visible = true;
+
+  return self;
+}
+
+void
+glr_retained_free (GlrRetained *self)
+{
+  g_array_unref (self->instances);
+
+  g_slice_free (GlrRetained, self);
+}
+
+void
+glr_retained_add_area (GlrRetained *self,
+                       float        left,
+                       float        top,
+                       float        width,
+                       float        height)
+{
+  float *area = self->recorded_area;
+
+  area[0] = MIN (area[0], left);
+  area[1] = MIN (area[1], top);
+  area[2] = MAX (area[2], left + width);
+  area[3] = MAX (area[3], top + height);
+
+  memcpy (self->area, area, sizeof (self->area));
+}
+
+/* 'layout' was moved by 'translate_x', 'translate_y' when drawn, unlike
+   the areas given to glr_retained_add_area(). 'fill' tells an instance
+   taking the color of a background or a glyph from one taking that of a
+   border */
+void
+glr_retained_add_instance (GlrRetained      *self,
+                           struct _GlrBatch *batch,
+                           GlrInstanceClass  klass,
+                           size_t            index,
+                           const GlrLayout  *layout,
+                           float             translate_x,
+                           float             translate_y,
+                           bool              fill)
+{
+  RetainedInstance inst;
+
+  inst.batch = batch;
+  inst.klass = klass;
+  inst.index = index;
+  inst.layout = *layout;
+  inst.layout.left -= translate_x;
+  inst.layout.top -= translate_y;
+  inst.translation[0] = translate_x;
+  inst.translation[1] = translate_y;
+  inst.fill = fill;
+
+  g_array_append_vals (self->instances, &inst, 1);
+}
+
+/* public API */
+
+GlrDisplayList *
+glr_display_list_ref (GlrDisplayList *self)
+{
+  g_assert (self != NULL);
+  g_assert (self->ref_count > 0);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+glr_display_list_unref (GlrDisplayList *self)
+{
+  g_assert (self != NULL);
+  g_assert (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    glr_display_list_free (self);
+}
+
+GlrContext *
+glr_display_list_get_context (GlrDisplayList *self)
+{
+  return self->context;
+}
+
+size_t
+glr_display_list_get_num_instances (GlrDisplayList *self)
+{
+  size_t num_instances = 0;
+  guint i;
+
+  for (i = 0; i < self->batches->len; i++)
+    num_instances +=
+      glr_batch_get_num_instances (g_ptr_array_index (self->batches, i));
+
+  return num_instances;
+}
+
+void
+glr_retained_set_layout (GlrRetained *self,
+                         float        left,
+                         float        top,
+                         float        width,
+                         float        height)
+{
+  assert (self != NULL);
+
+  if (self->instances->len == 0)
+    return;
+
+  self->area[0] = left;
+  self->area[1] = top;
+  self->area[2] = left + width;
+  self->area[3] = top + height;
+
+  update_instances (self);
+}
+
+void
+glr_retained_set_color (GlrRetained *self, GlrColor color)
+{
+  assert (self != NULL);
+
+  guint i;
+
+  if (self->opacity < 1.0)
+    color = (color & 0xFFFFFF00) | lrintf ((color & 0xFF) * self->opacity);
+
+  for (i = 0; i < self->instances->len; i++)
+    {
+      RetainedInstance *inst =
+        &g_array_index (self->instances, RetainedInstance, i);
+
+      if (inst->fill)
+        glr_batch_update_instance (inst->batch, inst->klass, inst->index,
+                                   NULL, &color);
+    }
+}
+
+void
+glr_retained_set_visible (GlrRetained *self, bool visible)
+{
+  assert (self != NULL);
+
+  if (self->visible == visible || self->instances->len == 0)
+    return;
+
+  self->visible = visible;
+
+  update_instances (self);
+}
@@ -0,0 +1,44 @@
+#ifndef _GLR_DISPLAY_LIST_H_
+#define _GLR_DISPLAY_LIST_H_
+
+#include <glib.h>
+#include <stdbool.h>
+
+#include "glr-context.h"
+#include "glr-style.h"
+
+/* instances recorded with glr_canvas_begin_display_list(), kept on the GPU
+   so they can be drawn again with glr_canvas_draw_display_list() without
+   encoding them each frame */
+typedef struct _GlrDisplayList GlrDisplayList;
+
+/* the instances of the draws made between glr_canvas_begin_retained() and
+   glr_canvas_end_retained(), which can be changed in place afterwards. It
+   belongs to the display list they were recorded into. Only draws under
+   no transform or a translation are retained, others are drawn as usual
+   but left out of it */
+typedef struct _GlrRetained GlrRetained;
+
+GlrDisplayList *    glr_display_list_ref               (GlrDisplayList *self);
+void                glr_display_list_unref             (GlrDisplayList *self);
+
+GlrContext *        glr_display_list_get_context       (GlrDisplayList *self);
+size_t              glr_display_list_get_num_instances (GlrDisplayList *self);
+
+/* moves and resizes what was drawn to a new area, given like the areas of
+   the draws were. The edges of each instance keep their distance to the
+   nearest edge of the area, so borders and corners keep their size.
+   Glyphs only take the position */
+void                glr_retained_set_layout            (GlrRetained *self,
+                                                        float        left,
+                                                        float        top,
+                                                        float        width,
+                                                        float        height);
+/* sets the color of backgrounds and glyphs. Borders keep theirs, and the
+   opacity of the canvas when the draws were recorded still applies */
+void                glr_retained_set_color             (GlrRetained *self,
+                                                        GlrColor     color);
+void                glr_retained_set_visible           (GlrRetained *self,
+                                                        bool         visible);
+
+#endif /* _GLR_DISPLAY_LIST_H_ */
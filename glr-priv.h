@@ -1,7 +1,14 @@
 #ifndef _GLR_PRIV_H_
 #define _GLR_PRIV_H_
 
+#include "glr-canvas.h"
 #include "glr-context.h"
+#include "glr-display-list.h"
+#include "glr-program.h"
+#include "glr-symbols.h"
+#include <GLES3/gl3.h>
+#include <stdbool.h>
+#include <stddef.h>
 
 typedef enum
   {
@@ -15,10 +22,49 @@ typedef enum
     GLR_INSTANCE_BORDER_BOTTOM_LEFT,
     GLR_INSTANCE_BORDER_BOTTOM_RIGHT,
     GLR_INSTANCE_CHAR_GLYPH,
+
+    /* background and border of a rect in a single instance, see
+       GLR_CANVAS_SDF_BOXES */
+    GLR_INSTANCE_BOX,
+
+    /* solid rect sitting exactly on pixel boundaries, drawn without
+       anti-aliasing */
+    GLR_INSTANCE_RECT_ALIGNED
   } GlrInstanceType;
 
 typedef uint32_t GlrInstanceConfig[4];
 
+/* flags of config1 of an instance, whose lower bits hold the offset of its
+   transform. A clipped instance has a 2-sample clip at that offset instead,
+   followed by the transform unless it is clipped only. An animated one has
+   its animation after the clip, if any, and before the transform. Must
+   match the vertex shader */
+#define GLR_INSTANCE_CLIP_FLAG      (1 << 22)
+#define GLR_INSTANCE_CLIP_ONLY_FLAG (1 << 21)
+#define GLR_INSTANCE_ANIMATION_FLAG (1 << 20)
+
+/* bits 8 to 11 of config0 of an instance hold the scroll node it moves
+   with, zero meaning none. Must match the vertex shader */
+#define GLR_INSTANCE_SCROLL_NODE_SHIFT 8
+#define GLR_INSTANCE_SCROLL_NODE_MASK  (0x0F << GLR_INSTANCE_SCROLL_NODE_SHIFT)
+
+/* instances are drawn with a shader program specialized for their class */
+typedef enum
+  {
+    GLR_INSTANCE_CLASS_SOLID = 0,
+    GLR_INSTANCE_CLASS_ROUNDED,
+    GLR_INSTANCE_CLASS_GRADIENT,
+    GLR_INSTANCE_CLASS_GLYPH,
+
+    GLR_INSTANCE_NUM_CLASSES
+  } GlrInstanceClass;
+
+typedef enum
+  {
+    GLR_INSTANCE_FORMAT_FULL = 0,
+    GLR_INSTANCE_FORMAT_COMPACT
+  } GlrInstanceFormat;
+
 typedef struct __attribute__((__packed__))
 {
   float left;
@@ -27,6 +73,84 @@ typedef struct __attribute__((__packed__))
   float height;
 } GlrLayout;
 
+/* what the GL implementation behind a context can do, detected once when
+   the context is created */
+typedef struct
+{
+  bool is_gles;
+  int version_major;
+  int version_minor;
+
+  GLint max_texture_size;
+
+  /* whether integer vertex attributes work (glVertexAttribIPointer). When
+     they don't, the config words of the full instance format are passed
+     as 'legacy_config_attr_type' instead */
+  bool integer_vertex_attribs;
+  GLenum legacy_config_attr_type;
+
+  bool fence_sync;
+} GlrContextCaps;
+
+/* see glr-batch.h, which includes this header */
+struct _GlrBatch;
+
 GlrTexCache *          glr_tex_cache_new                 (GlrContext *context);
+void                   glr_tex_cache_upload_pending      (GlrTexCache *self);
+
+GlrCanvas *            glr_canvas_new_deferred              (GlrContext     *context,
+                                                             GlrCanvasFlags  flags);
+void                   glr_canvas_reset_deferred            (GlrCanvas *self);
+
+GlrDisplayList *       glr_display_list_new                 (GlrContext *context,
+                                                             GPtrArray  *batches,
+                                                             GPtrArray  *retained);
+GPtrArray *            glr_display_list_get_batches         (GlrDisplayList *self);
+
+GlrRetained *          glr_retained_new                     (float opacity);
+void                   glr_retained_free                    (GlrRetained *self);
+void                   glr_retained_add_area                (GlrRetained *self,
+                                                             float        left,
+                                                             float        top,
+                                                             float        width,
+                                                             float        height);
+void                   glr_retained_add_instance            (GlrRetained      *self,
+                                                             struct _GlrBatch *batch,
+                                                             GlrInstanceClass  klass,
+                                                             size_t            index,
+                                                             const GlrLayout  *layout,
+                                                             float             translate_x,
+                                                             float             translate_y,
+                                                             bool              fill);
+
+bool                   glr_context_has_dyn_attrs_memory     (GlrContext *self,
+                                                             size_t      size);
+bool                   glr_context_reserve_dyn_attrs_memory (GlrContext *self,
+                                                             size_t      size);
+void                   glr_context_release_dyn_attrs_memory (GlrContext *self,
+                                                             size_t      size);
+
+const GlrSymbols *     glr_context_get_symbols              (GlrContext *self);
+const GlrContextCaps * glr_context_get_caps                 (GlrContext *self);
+GlrProgram *           glr_context_get_programs             (GlrContext *self);
+bool                   glr_context_has_extension            (GlrContext *self,
+                                                             const char *name);
+
+void                   glr_context_invalidate_gl_state      (GlrContext *self);
+void                   glr_context_use_program              (GlrContext *self,
+                                                             GLuint      program);
+void                   glr_context_bind_framebuffer         (GlrContext *self,
+                                                             GLuint      framebuffer);
+void                   glr_context_bind_vertex_array        (GlrContext *self,
+                                                             GLuint      vertex_array);
+void                   glr_context_bind_texture             (GlrContext *self,
+                                                             GLuint      unit,
+                                                             GLuint      texture);
+void                   glr_context_set_blend                (GlrContext *self,
+                                                             bool        enabled);
+void                   glr_context_set_depth_test           (GlrContext *self,
+                                                             bool        enabled);
+void                   glr_context_set_depth_mask           (GlrContext *self,
+                                                             bool        enabled);
 
 #endif /* _GLR_PRIV_H_ */
@@ -0,0 +1,350 @@
+#include "glr-program.h"
+
+#include <glib.h>
+#include "glr-batch.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LAYOUT_ATTR 0
+#define COLOR_ATTR  1
+#define CONFIG_ATTR 2
+
+/* files in the program binary cache start with this header, followed by
+   the binary as returned by glGetProgramBinary() */
+#define BINARY_CACHE_MAGIC 0x50524c47 /* "GLRP" */
+
+typedef struct
+{
+  uint32_t magic;
+  uint32_t format;
+} BinaryCacheHeader;
+
+static bool
+print_shader_log (const GlrSymbols *gl, GLuint shader)
+{
+  GLint length;
+  char buffer[1024] = {0};
+  GLint success;
+
+  gl->GetShaderiv (shader, GL_INFO_LOG_LENGTH, &length);
+  if (length == 0)
+    return true;
+
+  gl->GetShaderInfoLog (shader, 1024, NULL, buffer);
+  if (strlen (buffer) > 0)
+    printf ("Shader compilation log: %s\n", buffer);
+
+  gl->GetShaderiv (shader, GL_COMPILE_STATUS, &success);
+
+  return success == GL_TRUE;
+}
+
+static bool
+check_link_status (const GlrSymbols *gl, GLuint program)
+{
+  char buffer[1024] = {0};
+  GLint success;
+
+  gl->GetProgramiv (program, GL_LINK_STATUS, &success);
+  if (success == GL_TRUE)
+    return true;
+
+  gl->GetProgramInfoLog (program, 1024, NULL, buffer);
+  printf ("Program link log: %s\n", buffer);
+
+  return false;
+}
+
+static GLuint
+load_shader (const GlrSymbols *gl, const char *shader_source, GLenum type)
+{
+  GLuint shader = gl->CreateShader (type);
+
+  gl->ShaderSource (shader, 1, &shader_source, NULL);
+  gl->CompileShader (shader);
+
+  print_shader_log (gl, shader);
+
+  return shader;
+}
+
+/* binaries are only valid for the exact same sources and driver, so both
+   go into the name of the file */
+static char *
+get_cache_filename (const GlrSymbols *gl,
+                    const char       *vertex_shader_source,
+                    const char       *fragment_shader_source,
+                    const char       *cache_dir)
+{
+  const char *strings[4];
+  GChecksum *checksum;
+  char *basename;
+  char *filename;
+  int i;
+
+  strings[0] = (const char *) gl->GetString (GL_RENDERER);
+  strings[1] = (const char *) gl->GetString (GL_VERSION);
+  strings[2] = vertex_shader_source;
+  strings[3] = fragment_shader_source;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA1);
+  for (i = 0; i < 4; i++)
+    {
+      // the terminating zero separates the strings
+      if (strings[i] != NULL)
+        g_checksum_update (checksum,
+                           (const guchar *) strings[i],
+                           strlen (strings[i]) + 1);
+    }
+
+  basename = g_strdup_printf ("%s.bin", g_checksum_get_string (checksum));
+  filename = g_build_filename (cache_dir, basename, NULL);
+
+  g_free (basename);
+  g_checksum_free (checksum);
+
+  return filename;
+}
+
+static bool
+binary_format_supported (const GlrSymbols *gl,
+                         GLint             num_formats,
+                         GLenum            format)
+{
+  GLint *formats;
+  bool result = false;
+  GLint i;
+
+  formats = malloc (sizeof (GLint) * num_formats);
+  gl->GetIntegerv (GL_PROGRAM_BINARY_FORMATS, formats);
+
+  for (i = 0; i < num_formats && ! result; i++)
+    result = (GLenum) formats[i] == format;
+
+  free (formats);
+
+  return result;
+}
+
+static bool
+load_binary (const GlrSymbols *gl,
+             GLuint            program,
+             GLint             num_formats,
+             const char       *filename)
+{
+  char *contents;
+  gsize length;
+  BinaryCacheHeader header;
+  GLint status = GL_FALSE;
+
+  if (! g_file_get_contents (filename, &contents, &length, NULL))
+    return false;
+
+  if (length > sizeof (BinaryCacheHeader))
+    {
+      memcpy (&header, contents, sizeof (BinaryCacheHeader));
+
+      if (header.magic == BINARY_CACHE_MAGIC
+          && binary_format_supported (gl, num_formats, header.format))
+        {
+          gl->ProgramBinary (program,
+                             header.format,
+                             contents + sizeof (BinaryCacheHeader),
+                             length - sizeof (BinaryCacheHeader));
+
+          // the driver rejects binaries it cannot use anymore, e.g after
+          // an update
+          gl->GetProgramiv (program, GL_LINK_STATUS, &status);
+        }
+    }
+
+  g_free (contents);
+
+  return status == GL_TRUE;
+}
+
+static void
+save_binary (const GlrSymbols *gl,
+             GLuint            program,
+             const char       *filename,
+             const char       *cache_dir)
+{
+  GLint length = 0;
+  GLsizei written = 0;
+  GLenum format;
+  BinaryCacheHeader *header;
+  char *contents;
+
+  gl->GetProgramiv (program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+
+  contents = malloc (sizeof (BinaryCacheHeader) + length);
+
+  gl->GetProgramBinary (program,
+                        length,
+                        &written,
+                        &format,
+                        contents + sizeof (BinaryCacheHeader));
+
+  if (written > 0)
+    {
+      header = (BinaryCacheHeader *) contents;
+      header->magic = BINARY_CACHE_MAGIC;
+      header->format = format;
+
+      g_mkdir_with_parents (cache_dir, 0700);
+      if (! g_file_set_contents (filename,
+                                 contents,
+                                 sizeof (BinaryCacheHeader) + written,
+                                 NULL))
+        {
+          g_warning ("Failed to write program binary to '%s'", filename);
+        }
+    }
+
+  free (contents);
+}
+
+static GLuint
+compile_and_link (const GlrSymbols *gl,
+                  const char       *vertex_shader_source,
+                  const char       *fragment_shader_source,
+                  bool              retrievable)
+{
+  GLuint program;
+  GLuint vertex_shader;
+  GLuint fragment_shader;
+
+  vertex_shader = load_shader (gl, vertex_shader_source, GL_VERTEX_SHADER);
+  fragment_shader = load_shader (gl,
+                                 fragment_shader_source,
+                                 GL_FRAGMENT_SHADER);
+
+  program = gl->CreateProgram ();
+  gl->AttachShader (program, vertex_shader);
+  gl->AttachShader (program, fragment_shader);
+
+  gl->BindAttribLocation (program, LAYOUT_ATTR, "lyt_attr");
+  gl->BindAttribLocation (program, COLOR_ATTR, "color_attr");
+  gl->BindAttribLocation (program, CONFIG_ATTR, "config_attr");
+
+  if (retrievable)
+    gl->ProgramParameteri (program,
+                           GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                           GL_TRUE);
+
+  gl->LinkProgram (program);
+
+  gl->DeleteShader (vertex_shader);
+  gl->DeleteShader (fragment_shader);
+
+  return program;
+}
+
+/* looks up the uniforms of a linked program, and sets those that never
+   change */
+static void
+init_uniforms (GlrProgram *self, const GlrSymbols *gl)
+{
+  GLuint id = self->program;
+  int i;
+
+  self->view_matrix_loc = gl->GetUniformLocation (id, "view_matrix");
+  self->aa_offset_loc = gl->GetUniformLocation (id, "aa_offset");
+  self->compact_instances_loc =
+    gl->GetUniformLocation (id, "compact_instances");
+  self->opaque_pass_loc = gl->GetUniformLocation (id, "opaque_pass");
+  self->depth_base_loc = gl->GetUniformLocation (id, "depth_base");
+  self->time_loc = gl->GetUniformLocation (id, "time");
+  self->scroll_offsets_loc = gl->GetUniformLocation (id, "scroll_offsets");
+
+  self->compact_instances = -1;
+  self->opaque_pass = -1;
+  self->depth_base = -1;
+  self->aa_offset = -1.0;
+  self->time = NAN;
+  for (i = 0; i < GLR_PROGRAM_NUM_SCROLL_NODES; i++)
+    self->scroll_offsets[i][0] = self->scroll_offsets[i][1] = NAN;
+
+  gl->UseProgram (id);
+
+  gl->Uniform1i (gl->GetUniformLocation (id, "dyn_attrs_tex"),
+                 GLR_BATCH_DYN_ATTRS_TEX_UNIT);
+
+  /* @FIXME: get the glyph texture ids from texture cache,
+     instead of hardcoding it here */
+  for (i = 0; i < 8; i++)
+    {
+      char name[] = "glyph_cache[0]";
+
+      name[12] = '0' + i;
+      gl->Uniform1i (gl->GetUniformLocation (id, name), i);
+    }
+}
+
+/* internal API */
+
+/* builds the program from its sources. If 'cache_dir' is not NULL, a
+   binary of the program is looked up there first, and stored there after
+   compiling it otherwise */
+bool
+glr_program_build (GlrProgram       *self,
+                   const GlrSymbols *gl,
+                   const char       *vertex_shader_source,
+                   const char       *fragment_shader_source,
+                   const char       *cache_dir)
+{
+  GLint num_binary_formats = 0;
+  char *filename = NULL;
+
+  if (cache_dir != NULL)
+    gl->GetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &num_binary_formats);
+
+  if (num_binary_formats > 0)
+    {
+      filename = get_cache_filename (gl,
+                                     vertex_shader_source,
+                                     fragment_shader_source,
+                                     cache_dir);
+
+      self->program = gl->CreateProgram ();
+      if (load_binary (gl, self->program, num_binary_formats, filename))
+        goto out;
+
+      gl->DeleteProgram (self->program);
+    }
+
+  self->program = compile_and_link (gl,
+                                    vertex_shader_source,
+                                    fragment_shader_source,
+                                    filename != NULL);
+  if (! check_link_status (gl, self->program))
+    {
+      gl->DeleteProgram (self->program);
+      self->program = 0;
+      g_free (filename);
+
+      return false;
+    }
+
+  if (filename != NULL)
+    save_binary (gl, self->program, filename, cache_dir);
+
+ out:
+  init_uniforms (self, gl);
+  g_free (filename);
+
+  return true;
+}
+
+void
+glr_program_destroy (GlrProgram *self, const GlrSymbols *gl)
+{
+  if (self->program != 0)
+    gl->DeleteProgram (self->program);
+
+  self->program = 0;
+}
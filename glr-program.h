@@ -0,0 +1,45 @@
+#ifndef _GLR_PROGRAM_H_
+#define _GLR_PROGRAM_H_
+
+#include "glr-symbols.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* size of the table of scroll offsets, whose first entry is always zero.
+   Must match the vertex shader */
+#define GLR_PROGRAM_NUM_SCROLL_NODES 16
+
+/* a linked shader program and the locations of its uniforms. The values
+   of the uniforms set per draw are cached, -1 meaning unknown. Programs
+   are shared by all canvases of a context, see glr_context_get_programs() */
+typedef struct
+{
+  GLuint program;
+
+  GLint view_matrix_loc;
+  GLint aa_offset_loc;
+  GLint compact_instances_loc;
+  GLint opaque_pass_loc;
+  GLint depth_base_loc;
+  GLint time_loc;
+  GLint scroll_offsets_loc;
+
+  int compact_instances;
+  int opaque_pass;
+  int64_t depth_base;
+
+  /* what the per-canvas constant uniforms were last set from */
+  float aa_offset;
+  float time;
+  float scroll_offsets[GLR_PROGRAM_NUM_SCROLL_NODES][2];
+} GlrProgram;
+
+bool glr_program_build   (GlrProgram       *self,
+                          const GlrSymbols *gl,
+                          const char       *vertex_shader_source,
+                          const char       *fragment_shader_source,
+                          const char       *cache_dir);
+void glr_program_destroy (GlrProgram       *self,
+                          const GlrSymbols *gl);
+
+#endif /* _GLR_PROGRAM_H_ */
@@ -0,0 +1,77 @@
+#include "glr-recorder.h"
+
+#include <assert.h>
+#include <glib.h>
+#include "glr-priv.h"
+
+struct _GlrRecorder
+{
+  int ref_count;
+
+  /* a canvas whose batches are filled in client memory, see
+     glr_canvas_new_deferred() */
+  GlrCanvas *canvas;
+};
+
+static void
+glr_recorder_free (GlrRecorder *self)
+{
+  glr_canvas_unref (self->canvas);
+
+  g_slice_free (GlrRecorder, self);
+  self = NULL;
+}
+
+/* public API */
+
+GlrRecorder *
+glr_recorder_new (GlrContext *context, GlrCanvasFlags flags)
+{
+  GlrRecorder *self;
+
+  assert (context != NULL);
+
+  self = g_slice_new0 (GlrRecorder);
+  self->ref_count = 1;
+
+  self->canvas = glr_canvas_new_deferred (context, flags);
+
+  return self;
+}
+
+GlrRecorder *
+glr_recorder_ref (GlrRecorder *self)
+{
+  assert (self != NULL);
+  assert (self->ref_count > 0);
+
+  g_atomic_int_inc (&self->ref_count);
+
+  return self;
+}
+
+void
+glr_recorder_unref (GlrRecorder *self)
+{
+  assert (self != NULL);
+  assert (self->ref_count > 0);
+
+  if (g_atomic_int_dec_and_test (&self->ref_count))
+    glr_recorder_free (self);
+}
+
+GlrCanvas *
+glr_recorder_get_canvas (GlrRecorder *self)
+{
+  assert (self != NULL);
+
+  return self->canvas;
+}
+
+void
+glr_recorder_reset (GlrRecorder *self)
+{
+  assert (self != NULL);
+
+  glr_canvas_reset_deferred (self->canvas);
+}
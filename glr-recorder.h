@@ -0,0 +1,30 @@
+#ifndef _GLR_RECORDER_H_
+#define _GLR_RECORDER_H_
+
+#include "glr-canvas.h"
+#include "glr-context.h"
+
+/* draws encoded without making any GL call, so that worker threads can
+   each fill their own recorder at the same time. Draws go through the
+   canvas of the recorder with the usual functions, from one thread at a
+   time, and are drawn later by the GL thread with
+   glr_canvas_draw_recorders().
+
+   The canvas of a recorder cannot be cleared or flushed, nor record
+   display lists or retained draws. Its draws are never culled against the
+   viewport, and animations and scroll nodes follow the time and offsets of
+   the canvas they are drawn with. Once drawn, a recorder holds GPU
+   buffers, so its last reference must be dropped on the GL thread */
+
+GlrRecorder *       glr_recorder_new        (GlrContext     *context,
+                                             GlrCanvasFlags  flags);
+GlrRecorder *       glr_recorder_ref        (GlrRecorder *self);
+void                glr_recorder_unref      (GlrRecorder *self);
+
+GlrCanvas *         glr_recorder_get_canvas (GlrRecorder *self);
+
+/* drops what was recorded so far, keeping the state of the canvas. Only
+   once the canvas the recorder was drawn with was flushed */
+void                glr_recorder_reset      (GlrRecorder *self);
+
+#endif /* _GLR_RECORDER_H_ */
@@ -2,90 +2,185 @@
 #define _GLR_SYMBOLS_H_
 
 #include <GLES3/gl3.h>
+#include <stdbool.h>
 
-void   glGenFramebuffers                (GLsizei n, GLuint* ids);
-void   glDeleteFramebuffers             (GLsizei n, const GLuint *framebuffers);
-void   glBindFramebuffer                (GLenum target, GLuint framebuffer);
-void   glFramebufferTexture2D           (GLenum target,
-                                         GLenum attachment,
-                                         GLenum textarget,
-                                         GLuint texture,
-                                         GLint  level);
-GLenum glCheckFramebufferStatus         (GLenum target);
-void   glBlitFramebuffer                (GLint      srcX0,
-                                         GLint      srcY0,
-                                         GLint      srcX1,
-                                         GLint      srcY1,
-                                         GLint      dstX0,
-                                         GLint      dstY0,
-                                         GLint      dstX1,
-                                         GLint      dstY1,
-                                         GLbitfield mask,
-                                         GLenum     filter);
+/* every GL entry point glr uses, as X (return type, name, arguments) with
+   the name stripped of its 'gl' prefix. Each GlrContext resolves them once
+   into its own GlrSymbols table, and all GL calls go through it.
 
-GLuint glCreateProgram                  (void);
-void   glDeleteProgram                  (GLuint program);
-void   glLinkProgram                    (GLuint program);
-void   glUseProgram                     (GLuint program);
-GLint  glGetUniformLocation             (GLuint        program,
-                                         const GLchar *name);
+   By default the table points to the symbols exported by libGLESv2.
+   Building with GLR_RESOLVE_GL_SYMBOLS defined looks them up with
+   eglGetProcAddress() instead, for platforms whose GLES library does not
+   export the ES 3 entry points */
+#define GLR_GL_SYMBOLS(X)                                               \
+  X (void,      ActiveTexture,        (GLenum texture))                 \
+  X (void,      AttachShader,         (GLuint program, GLuint shader))  \
+  X (void,      BindAttribLocation,   (GLuint        program,           \
+                                       GLuint        index,             \
+                                       const GLchar *name))             \
+  X (void,      BindBuffer,           (GLenum target, GLuint buffer))   \
+  X (void,      BindFramebuffer,      (GLenum target, GLuint framebuffer)) \
+  X (void,      BindRenderbuffer,     (GLenum target, GLuint renderbuffer)) \
+  X (void,      BindTexture,          (GLenum target, GLuint texture))  \
+  X (void,      BindVertexArray,      (GLuint array))                   \
+  X (void,      BlendFunc,            (GLenum sfactor, GLenum dfactor)) \
+  X (void,      BufferData,           (GLenum      target,              \
+                                       GLsizeiptr  size,                \
+                                       const void *data,                \
+                                       GLenum      usage))              \
+  X (void,      BufferSubData,        (GLenum      target,              \
+                                       GLintptr    offset,              \
+                                       GLsizeiptr  size,                \
+                                       const void *data))               \
+  X (GLenum,    CheckFramebufferStatus, (GLenum target))                \
+  X (void,      Clear,                (GLbitfield mask))                \
+  X (void,      ClearColor,           (GLfloat red,                     \
+                                       GLfloat green,                   \
+                                       GLfloat blue,                    \
+                                       GLfloat alpha))                  \
+  X (GLenum,    ClientWaitSync,       (GLsync     sync,                 \
+                                       GLbitfield flags,                \
+                                       GLuint64   timeout))             \
+  X (void,      CompileShader,        (GLuint shader))                  \
+  X (void,      CopyBufferSubData,    (GLenum     readTarget,           \
+                                       GLenum     writeTarget,          \
+                                       GLintptr   readOffset,           \
+                                       GLintptr   writeOffset,          \
+                                       GLsizeiptr size))                \
+  X (GLuint,    CreateProgram,        (void))                           \
+  X (GLuint,    CreateShader,         (GLenum type))                    \
+  X (void,      DeleteBuffers,        (GLsizei n, const GLuint *buffers)) \
+  X (void,      DeleteFramebuffers,   (GLsizei       n,                 \
+                                       const GLuint *framebuffers))     \
+  X (void,      DeleteProgram,        (GLuint program))                 \
+  X (void,      DeleteRenderbuffers,  (GLsizei       n,                 \
+                                       const GLuint *renderbuffers))    \
+  X (void,      DeleteShader,         (GLuint shader))                  \
+  X (void,      DeleteSync,           (GLsync sync))                    \
+  X (void,      DeleteTextures,       (GLsizei n, const GLuint *textures)) \
+  X (void,      DeleteVertexArrays,   (GLsizei n, const GLuint *arrays)) \
+  X (void,      DepthFunc,            (GLenum func))                    \
+  X (void,      DepthMask,            (GLboolean flag))                 \
+  X (void,      Disable,              (GLenum cap))                     \
+  X (void,      DrawArraysInstanced,  (GLenum  mode,                    \
+                                       GLint   first,                   \
+                                       GLsizei count,                   \
+                                       GLsizei instancecount))          \
+  X (void,      Enable,               (GLenum cap))                     \
+  X (void,      EnableVertexAttribArray, (GLuint index))                \
+  X (GLsync,    FenceSync,            (GLenum condition, GLbitfield flags)) \
+  X (void,      FlushMappedBufferRange, (GLenum     target,             \
+                                         GLintptr   offset,             \
+                                         GLsizeiptr length))            \
+  X (void,      FramebufferRenderbuffer, (GLenum target,                \
+                                          GLenum attachment,            \
+                                          GLenum renderbuffertarget,    \
+                                          GLuint renderbuffer))         \
+  X (void,      GenBuffers,           (GLsizei n, GLuint *buffers))     \
+  X (void,      GenFramebuffers,      (GLsizei n, GLuint *framebuffers)) \
+  X (void,      GenRenderbuffers,     (GLsizei n, GLuint *renderbuffers)) \
+  X (void,      GenTextures,          (GLsizei n, GLuint *textures))    \
+  X (void,      GenVertexArrays,      (GLsizei n, GLuint *arrays))      \
+  X (void,      GetIntegerv,          (GLenum pname, GLint *data))      \
+  X (void,      GetProgramBinary,     (GLuint   program,                \
+                                       GLsizei  bufSize,                \
+                                       GLsizei *length,                 \
+                                       GLenum  *binaryFormat,           \
+                                       void    *binary))                \
+  X (void,      GetProgramInfoLog,    (GLuint   program,                \
+                                       GLsizei  bufSize,                \
+                                       GLsizei *length,                 \
+                                       GLchar  *infoLog))               \
+  X (void,      GetProgramiv,         (GLuint  program,                 \
+                                       GLenum  pname,                   \
+                                       GLint  *params))                 \
+  X (void,      GetShaderInfoLog,     (GLuint   shader,                 \
+                                       GLsizei  bufSize,                \
+                                       GLsizei *length,                 \
+                                       GLchar  *infoLog))               \
+  X (void,      GetShaderiv,          (GLuint  shader,                  \
+                                       GLenum  pname,                   \
+                                       GLint  *params))                 \
+  X (const GLubyte *, GetString,      (GLenum name))                    \
+  X (GLint,     GetUniformLocation,   (GLuint program, const GLchar *name)) \
+  X (void,      LinkProgram,          (GLuint program))                 \
+  X (void *,    MapBufferRange,       (GLenum     target,               \
+                                       GLintptr   offset,               \
+                                       GLsizeiptr length,               \
+                                       GLbitfield access))              \
+  X (void,      ProgramBinary,        (GLuint      program,             \
+                                       GLenum      binaryFormat,        \
+                                       const void *binary,              \
+                                       GLsizei     length))             \
+  X (void,      ProgramParameteri,    (GLuint program,                  \
+                                       GLenum pname,                    \
+                                       GLint  value))                   \
+  X (void,      RenderbufferStorageMultisample, (GLenum  target,        \
+                                                 GLsizei samples,       \
+                                                 GLenum  internalformat, \
+                                                 GLsizei width,         \
+                                                 GLsizei height))       \
+  X (void,      ShaderSource,         (GLuint                shader,    \
+                                       GLsizei               count,     \
+                                       const GLchar * const *string,    \
+                                       const GLint          *length))   \
+  X (void,      TexImage2D,           (GLenum      target,              \
+                                       GLint       level,               \
+                                       GLint       internalformat,      \
+                                       GLsizei     width,               \
+                                       GLsizei     height,              \
+                                       GLint       border,              \
+                                       GLenum      format,              \
+                                       GLenum      type,                \
+                                       const void *pixels))             \
+  X (void,      TexParameteri,        (GLenum target, GLenum pname, GLint param)) \
+  X (void,      TexSubImage2D,        (GLenum      target,              \
+                                       GLint       level,               \
+                                       GLint       xoffset,             \
+                                       GLint       yoffset,             \
+                                       GLsizei     width,               \
+                                       GLsizei     height,              \
+                                       GLenum      format,              \
+                                       GLenum      type,                \
+                                       const void *pixels))             \
+  X (void,      Uniform1f,            (GLint location, GLfloat v0))     \
+  X (void,      Uniform1i,            (GLint location, GLint v0))       \
+  X (void,      Uniform1ui,           (GLint location, GLuint v0))      \
+  X (void,      Uniform2fv,           (GLint          location,         \
+                                       GLsizei        count,            \
+                                       const GLfloat *value))           \
+  X (void,      UniformMatrix4fv,     (GLint          location,         \
+                                       GLsizei        count,            \
+                                       GLboolean      transpose,        \
+                                       const GLfloat *value))           \
+  X (GLboolean, UnmapBuffer,          (GLenum target))                  \
+  X (void,      UseProgram,           (GLuint program))                 \
+  X (void,      VertexAttribDivisor,  (GLuint index, GLuint divisor))   \
+  X (void,      VertexAttribIPointer, (GLuint      index,               \
+                                       GLint       size,                \
+                                       GLenum      type,                \
+                                       GLsizei     stride,              \
+                                       const void *pointer))            \
+  X (void,      VertexAttribPointer,  (GLuint      index,               \
+                                       GLint       size,                \
+                                       GLenum      type,                \
+                                       GLboolean   normalized,          \
+                                       GLsizei     stride,              \
+                                       const void *pointer))            \
+  X (void,      Viewport,             (GLint   x,                       \
+                                       GLint   y,                       \
+                                       GLsizei width,                   \
+                                       GLsizei height))
 
-GLuint glCreateShader                   (GLenum shaderType);
-void   glDeleteShader                   (GLuint shader);
-void   glCompileShader                  (GLuint shader);
-void   glAttachShader                   (GLuint program, GLuint shader);
-void   glShaderSource                   (GLuint                shader,
-                                         GLsizei               count,
-                                         const GLchar * const *string,
-                                         const GLint          *length);
-void   glGetShaderiv                    (GLuint  shader,
-                                         GLenum  pname,
-                                         GLint  *params);
-void   glGetShaderInfoLog               (GLuint   shader,
-                                         GLsizei  maxLength,
-                                         GLsizei *length,
-                                         GLchar  *infoLog);
+#define GLR_GL_SYMBOL_MEMBER(ret, name, args) ret (GL_APIENTRY *name) args;
 
-void   glUniform1ui                     (GLint location, GLuint v0);
-void   glUniform1i                      (GLint location, GLint v0);
+typedef struct
+{
+  GLR_GL_SYMBOLS (GLR_GL_SYMBOL_MEMBER)
+} GlrSymbols;
 
-void   glBindAttribLocation             (GLuint        program,
-                                         GLuint        index,
-                                         const GLchar *name);
-void   glVertexAttribPointer            (GLuint        index,
-                                         GLint         size,
-                                         GLenum        type,
-                                         GLboolean     normalized,
-                                         GLsizei       stride,
-                                         const GLvoid *pointer);
-void   glVertexAttribDivisor            (GLuint index, GLuint divisor);
-void   glEnableVertexAttribArray        (GLuint index);
-void   glDrawArraysInstanced            (GLenum  mode,
-                                         GLint   first,
-                                         GLsizei count,
-                                         GLsizei primcount);
+#undef GLR_GL_SYMBOL_MEMBER
 
-void   glTexImage2DMultisample          (GLenum    target,
-                                         GLsizei   samples,
-                                         GLint     internalformat,
-                                         GLsizei   width,
-                                         GLsizei   height,
-                                         GLboolean fixedsamplelocations);
-
-void   glGenRenderbuffers               (GLsizei  n,
-                                         GLuint  *renderbuffers);
-void   glRenderbufferStorageMultisample (GLenum  target,
-                                         GLsizei samples,
-                                         GLenum  internalformat,
-                                         GLsizei width,
-                                         GLsizei height);
-void   glFramebufferRenderbuffer        (GLenum target,
-                                         GLenum attachment,
-                                         GLenum renderbuffertarget,
-                                         GLuint renderbuffer);
-void   glBindRenderbuffer               (GLenum target,
-                                         GLuint renderbuffer);
-void   glDeleteRenderbuffers            (GLsizei       n,
-                                         const GLuint *renderbuffers);
+bool glr_symbols_resolve (GlrSymbols *self);
 
 #endif /* _GLR_SYMBOLS_H_ */
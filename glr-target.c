@@ -1,15 +1,18 @@
 #include "glr-target.h"
 
 #include <GLES3/gl3.h>
+#include "glr-priv.h"
 
 struct _GlrTarget
 {
   gint ref_count;
 
   GlrContext *context;
+  const GlrSymbols *gl;
 
   GLuint fbo;
   GLuint fbo_render_buf;
+  GLuint fbo_depth_buf;
   guint8 msaa_samples;
 
   guint32 width;
@@ -20,8 +23,9 @@ struct _GlrTarget
 static void
 glr_target_free (GlrTarget *self)
 {
-  glDeleteRenderbuffers (1, &self->fbo_render_buf);
-  glDeleteFramebuffers (1, &self->fbo);
+  self->gl->DeleteRenderbuffers (1, &self->fbo_depth_buf);
+  self->gl->DeleteRenderbuffers (1, &self->fbo_render_buf);
+  self->gl->DeleteFramebuffers (1, &self->fbo);
 
   g_mutex_clear (&self->mutex);
 
@@ -45,35 +49,51 @@ glr_target_new (GlrContext *context,
   self->ref_count = 1;
 
   self->context = glr_context_ref (context);
+  self->gl = glr_context_get_symbols (context);
   self->msaa_samples = msaa_samples;
 
   self->width = width;
   self->height = height;
   g_mutex_init (&self->mutex);
 
-  glGenRenderbuffers (1, &self->fbo_render_buf);
-  glBindRenderbuffer (GL_RENDERBUFFER, self->fbo_render_buf);
-  glRenderbufferStorageMultisample (GL_RENDERBUFFER,
-                                    self->msaa_samples,
-                                    GL_RGBA8,
-                                    self->width,
-                                    self->height);
-
-  glGenFramebuffers (1, &self->fbo);
-  glBindFramebuffer (GL_FRAMEBUFFER, self->fbo);
-
-  glFramebufferRenderbuffer (GL_FRAMEBUFFER,
-                             GL_COLOR_ATTACHMENT0,
-                             GL_RENDERBUFFER,
-                             self->fbo_render_buf);
-
-  if (glCheckFramebufferStatus (GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+  self->gl->GenRenderbuffers (1, &self->fbo_render_buf);
+  self->gl->BindRenderbuffer (GL_RENDERBUFFER, self->fbo_render_buf);
+  self->gl->RenderbufferStorageMultisample (GL_RENDERBUFFER,
+                                            self->msaa_samples,
+                                            GL_RGBA8,
+                                            self->width,
+                                            self->height);
+
+  // depth buffer, used by the canvas to reject fragments hidden by
+  // opaque instances drawn later
+  self->gl->GenRenderbuffers (1, &self->fbo_depth_buf);
+  self->gl->BindRenderbuffer (GL_RENDERBUFFER, self->fbo_depth_buf);
+  self->gl->RenderbufferStorageMultisample (GL_RENDERBUFFER,
+                                            self->msaa_samples,
+                                            GL_DEPTH_COMPONENT24,
+                                            self->width,
+                                            self->height);
+
+  self->gl->GenFramebuffers (1, &self->fbo);
+  self->gl->BindFramebuffer (GL_FRAMEBUFFER, self->fbo);
+
+  self->gl->FramebufferRenderbuffer (GL_FRAMEBUFFER,
+                                     GL_COLOR_ATTACHMENT0,
+                                     GL_RENDERBUFFER,
+                                     self->fbo_render_buf);
+  self->gl->FramebufferRenderbuffer (GL_FRAMEBUFFER,
+                                     GL_DEPTH_ATTACHMENT,
+                                     GL_RENDERBUFFER,
+                                     self->fbo_depth_buf);
+
+  if (self->gl->CheckFramebufferStatus (GL_FRAMEBUFFER)
+      != GL_FRAMEBUFFER_COMPLETE)
     {
       g_printerr ("Failed to create a working framebuffer\n");
       return NULL;
     }
 
-  glBindFramebuffer (GL_FRAMEBUFFER, 0);
+  self->gl->BindFramebuffer (GL_FRAMEBUFFER, 0);
 
   return self;
 }
@@ -127,13 +147,21 @@ glr_target_resize (GlrTarget *self, guint width, guint height)
   self->width = width;
   self->height = height;
 
-  glBindRenderbuffer (GL_RENDERBUFFER, self->fbo_render_buf);
+  self->gl->BindRenderbuffer (GL_RENDERBUFFER, self->fbo_render_buf);
+
+  self->gl->RenderbufferStorageMultisample (GL_RENDERBUFFER,
+                                            self->msaa_samples,
+                                            GL_RGBA8,
+                                            self->width,
+                                            self->height);
+
+  self->gl->BindRenderbuffer (GL_RENDERBUFFER, self->fbo_depth_buf);
 
-  glRenderbufferStorageMultisample (GL_RENDERBUFFER,
-                                    self->msaa_samples,
-                                    GL_RGBA8,
-                                    self->width,
-                                    self->height);
+  self->gl->RenderbufferStorageMultisample (GL_RENDERBUFFER,
+                                            self->msaa_samples,
+                                            GL_DEPTH_COMPONENT24,
+                                            self->width,
+                                            self->height);
 
   g_mutex_unlock (&self->mutex);
 }
@@ -29,11 +29,30 @@ typedef struct
   TexColumn *right_most_column;
 } Texture;
 
+/* a glyph bitmap waiting to be copied into its texture, see
+   glr_tex_cache_upload_pending() */
+typedef struct
+{
+  GLuint tex_id;
+  uint32_t x;
+  uint32_t y;
+  uint32_t width;
+  uint32_t height;
+  uint8_t *pixels;
+} PendingUpload;
+
 struct _GlrTexCache
 {
   int ref_count;
 
   GlrContext *context;
+  const GlrSymbols *gl;
+
+  /* glyphs are looked up from the threads filling recorders too, so
+     everything below is only touched with the mutex held. Lookups make no
+     GL calls: textures are created and glyphs copied into them by the GL
+     thread, before drawing */
+  GMutex mutex;
 
   FT_Library ft_lib;
   GHashTable *font_entries;
@@ -43,7 +62,10 @@ struct _GlrTexCache
   uint32_t num_glyph_texs;
   uint32_t current_glyph_tex;
 
+  /* the GL texture of each glyph texture, zero until created */
   GLuint tex_table[64];
+
+  GArray *pending_uploads;
 };
 
 static void
@@ -51,6 +73,10 @@ glr_tex_cache_free (GlrTexCache *self)
 {
   int i;
 
+  for (i = 0; i < self->pending_uploads->len; i++)
+    g_free (g_array_index (self->pending_uploads, PendingUpload, i).pixels);
+  g_array_unref (self->pending_uploads);
+
   g_hash_table_unref (self->font_faces);
   g_hash_table_unref (self->font_entries);
 
@@ -60,10 +86,13 @@ glr_tex_cache_free (GlrTexCache *self)
     {
       Texture *tex = &self->glyph_texs[i];
 
-      glDeleteTextures (1, &tex->id);
+      if (self->tex_table[tex->id] != 0)
+        self->gl->DeleteTextures (1, &self->tex_table[tex->id]);
       g_list_free_full (tex->columns, g_free);
     }
 
+  g_mutex_clear (&self->mutex);
+
   g_slice_free (GlrTexCache, self);
   self = NULL;
 
@@ -146,27 +175,37 @@ allocate_new_glyph_texture (GlrTexCache *self)
 
   tex->id = self->num_glyph_texs - 1;
 
-  GLuint _tex;
-  glGenTextures (1, &_tex);
-  self->tex_table[tex->id] = _tex;
-  glActiveTexture (GL_TEXTURE0 + tex->id);
-  glBindTexture (GL_TEXTURE_2D, _tex);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glTexImage2D (GL_TEXTURE_2D,
-                0,
-                GL_R8,
-                GLYPH_TEX_WIDTH, GLYPH_TEX_HEIGHT,
-                0,
-                GL_RED,
-                GL_UNSIGNED_BYTE,
-                NULL);
+  // the GL texture is created along with the first upload into it
+  self->tex_table[tex->id] = 0;
 
   return tex;
 }
 
+/* creates the GL texture of a glyph texture, leaving it bound to the
+   texture unit of the same number */
+static void
+create_glyph_texture (GlrTexCache *self, GLuint tex_id)
+{
+  GLuint tex;
+
+  self->gl->GenTextures (1, &tex);
+  self->tex_table[tex_id] = tex;
+
+  glr_context_bind_texture (self->context, tex_id, tex);
+  self->gl->TexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  self->gl->TexParameteri (GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  self->gl->TexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  self->gl->TexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  self->gl->TexImage2D (GL_TEXTURE_2D,
+                        0,
+                        GL_R8,
+                        GLYPH_TEX_WIDTH, GLYPH_TEX_HEIGHT,
+                        0,
+                        GL_RED,
+                        GL_UNSIGNED_BYTE,
+                        NULL);
+}
+
 static TexColumn *
 find_surface_for_glyph (GlrTexCache *self,
                         uint32_t     width,
@@ -252,6 +291,32 @@ find_surface_for_glyph (GlrTexCache *self,
   return column;
 }
 
+static FT_Face
+lookup_face (GlrTexCache *self,
+             const char  *face_filename,
+             uint8_t      face_index)
+{
+  FT_Face face;
+  char *face_id;
+
+  face_id = g_strdup_printf ("%s:%u", face_filename, face_index);
+  face = g_hash_table_lookup (self->font_faces, face_id);
+  if (face == NULL)
+    {
+      face = load_font_face (self, face_filename, face_index);
+      if (face == NULL)
+        {
+          g_free (face_id);
+          return NULL;
+        }
+
+      g_hash_table_insert (self->font_faces, g_strdup (face_id), face);
+    }
+  g_free (face_id);
+
+  return face;
+}
+
 static const GlrTexSurface *
 lookup_font_glyph (GlrTexCache *self,
                    const char  *surface_id,
@@ -294,7 +359,7 @@ lookup_font_glyph (GlrTexCache *self,
         }
     }
 
-  /* upload glyph bitmap to texture */
+  /* queue the glyph bitmap for upload to its texture */
   FT_Bitmap bmp = face->glyph->bitmap;
   TexColumn *column = find_surface_for_glyph (self, bmp.width + 1, bmp.rows + 1);
   if (column == NULL)
@@ -305,16 +370,16 @@ lookup_font_glyph (GlrTexCache *self,
       goto out;
     }
 
-  glActiveTexture (GL_TEXTURE0 + column->tex_id);
-  glBindTexture (GL_TEXTURE_2D, self->tex_table[column->tex_id]);
-  glTexSubImage2D (GL_TEXTURE_2D,
-                   0,
-                   column->x + 1, column->first_y + 1,
-                   bmp.width, bmp.rows,
-                   GL_RED,
-                   GL_UNSIGNED_BYTE,
-                   bmp.buffer);
+  PendingUpload upload;
 
+  upload.tex_id = column->tex_id;
+  upload.x = column->x + 1;
+  upload.y = column->first_y + 1;
+  upload.width = bmp.width;
+  upload.height = bmp.rows;
+  upload.pixels = g_malloc (bmp.pitch * bmp.rows);
+  memcpy (upload.pixels, bmp.buffer, bmp.pitch * bmp.rows);
+  g_array_append_val (self->pending_uploads, upload);
 
   surface = g_slice_new (GlrTexSurface);
   surface->tex_id = column->tex_id;
@@ -348,6 +413,7 @@ glr_tex_cache_new (GlrContext *context)
   self->ref_count = 1;
 
   self->context = context;
+  self->gl = glr_context_get_symbols (context);
 
   self->font_entries =
     g_hash_table_new_full (g_str_hash,
@@ -359,17 +425,54 @@ glr_tex_cache_new (GlrContext *context)
                                             g_free,
                                             (GDestroyNotify) FT_Done_Face);
 
-  /* @FIXME: calculate maximum texture sizes instead of hardcoding */
-  GLint max_texture_size;
-  glGetIntegerv (GL_MAX_TEXTURE_SIZE, &max_texture_size);
-  // g_print ("%d\n", max_texture_size);
+  /* @FIXME: calculate texture sizes from the context's max_texture_size
+     instead of hardcoding them */
 
   /* texture id table */
-  memset (self->tex_table, 0x00, 64);
+  memset (self->tex_table, 0x00, sizeof (self->tex_table));
+
+  self->pending_uploads = g_array_new (FALSE, FALSE, sizeof (PendingUpload));
+
+  g_mutex_init (&self->mutex);
 
   return self;
 }
 
+/* copies the glyphs looked up since the last call into their textures,
+   creating those as needed. Called by the GL thread before drawing */
+void
+glr_tex_cache_upload_pending (GlrTexCache *self)
+{
+  guint i;
+
+  g_mutex_lock (&self->mutex);
+
+  for (i = 0; i < self->pending_uploads->len; i++)
+    {
+      PendingUpload *upload =
+        &g_array_index (self->pending_uploads, PendingUpload, i);
+
+      if (self->tex_table[upload->tex_id] == 0)
+        create_glyph_texture (self, upload->tex_id);
+
+      glr_context_bind_texture (self->context,
+                                upload->tex_id,
+                                self->tex_table[upload->tex_id]);
+      self->gl->TexSubImage2D (GL_TEXTURE_2D,
+                               0,
+                               upload->x, upload->y,
+                               upload->width, upload->height,
+                               GL_RED,
+                               GL_UNSIGNED_BYTE,
+                               upload->pixels);
+
+      g_free (upload->pixels);
+    }
+  g_array_set_size (self->pending_uploads, 0);
+
+  g_mutex_unlock (&self->mutex);
+}
+
 /* public API */
 
 GlrTexCache *
@@ -399,26 +502,37 @@ glr_tex_cache_lookup_face (GlrTexCache *self,
                            uint8_t      face_index)
 {
   FT_Face face;
-  char *face_id;
 
-  face_id = g_strdup_printf ("%s:%u", face_filename, face_index);
-  face = g_hash_table_lookup (self->font_faces, face_id);
-  if (face == NULL)
-    {
-      face = load_font_face (self, face_filename, face_index);
-      if (face == NULL)
-        {
-          g_free (face_id);
-          return NULL;
-        }
-
-      g_hash_table_insert (self->font_faces, g_strdup (face_id), face);
-    }
-  g_free (face_id);
+  g_mutex_lock (&self->mutex);
+  face = lookup_face (self, face_filename, face_index);
+  g_mutex_unlock (&self->mutex);
 
   return face;
 }
 
+/* the glyph index of a character in a face, or zero if the face does not
+   have it or cannot be loaded. Faces are not safe to use from several
+   threads at once, so this goes through the cache's lock */
+uint32_t
+glr_tex_cache_lookup_char_index (GlrTexCache *self,
+                                 const char  *face_filename,
+                                 uint8_t      face_index,
+                                 uint32_t     unicode_char)
+{
+  FT_Face face;
+  uint32_t glyph_index = 0;
+
+  g_mutex_lock (&self->mutex);
+
+  face = lookup_face (self, face_filename, face_index);
+  if (face != NULL)
+    glyph_index = FT_Get_Char_Index (face, unicode_char);
+
+  g_mutex_unlock (&self->mutex);
+
+  return glyph_index;
+}
+
 const GlrTexSurface *
 glr_tex_cache_lookup_font_glyph (GlrTexCache *self,
                                  const char  *face_filename,
@@ -435,11 +549,16 @@ glr_tex_cache_lookup_font_glyph (GlrTexCache *self,
                                 face_index,
                                 font_size,
                                 code_point);
+
+  g_mutex_lock (&self->mutex);
+
+  // surfaces are never freed before the cache, so they can be read after
+  // unlocking
   surface = g_hash_table_lookup (self->font_entries, surface_id);
   if (surface != NULL)
     goto out;
 
-  face = glr_tex_cache_lookup_face (self, face_filename, face_index);
+  face = lookup_face (self, face_filename, face_index);
   if (face == NULL)
     {
       /* @TODO: font face could not be loaded, throw error */
@@ -454,6 +573,7 @@ glr_tex_cache_lookup_font_glyph (GlrTexCache *self,
                                code_point);
 
  out:
+  g_mutex_unlock (&self->mutex);
   g_free (surface_id);
 
   return surface;
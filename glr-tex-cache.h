@@ -34,5 +34,9 @@ const GlrTexSurface * glr_tex_cache_lookup_font_glyph (GlrTexCache *self,
 FT_Face               glr_tex_cache_lookup_face       (GlrTexCache *self,
                                                        const char  *face_filename,
                                                        uint8_t      face_index);
+uint32_t              glr_tex_cache_lookup_char_index (GlrTexCache *self,
+                                                       const char  *face_filename,
+                                                       uint8_t      face_index,
+                                                       uint32_t     unicode_char);
 
 #endif /* _GLR_TEX_CACHE_H_ */
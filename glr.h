@@ -4,6 +4,8 @@
 #include "glr-context.h"
 #include "glr-target.h"
 #include "glr-canvas.h"
+#include "glr-display-list.h"
+#include "glr-recorder.h"
 #include "glr-style.h"
 
 #define M_PI 3.14159265358979323846
@@ -13,7 +13,18 @@ const vec2 RECT_VERTICES[4] = vec2[4] (
   vec2 (0.0, 1.0)
 );
 
-const uint INSTANCE_CHAR_GLYPH = uint (9);
+const uint INSTANCE_CHAR_GLYPH   = uint (9);
+const uint INSTANCE_BOX          = uint (10);
+const uint INSTANCE_RECT_ALIGNED = uint (11);
+
+const uint TRANSFORM_OFFSET_MASK = uint (0x000FFFFF);
+const uint TRANSFORM_AFFINE_2D   = uint (0x00800000);
+const uint CLIP                  = uint (0x00400000);
+const uint CLIP_ONLY             = uint (0x00200000);
+const uint ANIMATION             = uint (0x00100000);
+
+const uint ANIMATION_ALTERNATE   = uint (1);
+const uint ANIMATION_EASE_IN_OUT = uint (2);
 
 const int BACKGROUND_TYPE_NONE         = 0;
 const int BACKGROUND_TYPE_SOLID_COLOR  = 1;
@@ -44,22 +55,55 @@ flat out uvec4 border_color;
 
 flat out int   background_type;
 
+     out vec2  box_pos;
+flat out vec2  box_half_size;
+flat out vec4  box_border_width;
+flat out vec4  box_radii;
+flat out vec4  box_border_color;
+
+     out vec2  clip_pos;
+flat out vec2  clip_half_size;
+flat out vec4  clip_radii;
+
+flat out float instance_opacity;
+
 flat out vec4  linear_grad_colors[2];
 flat out float linear_grad_steps[4];
 flat out float linear_grad_angle;
 flat out float linear_grad_gamma;
 flat out float linear_grad_length;
 
-uniform mat4  proj_matrix;
-uniform mat4  transform_matrix;
-uniform mat4  persp_matrix;
+// the canvas' global transform, projection and perspective, multiplied
+uniform mat4  view_matrix;
 uniform float aa_offset;
 
+// the opaque pass draws only the inner area of opaque instances, and
+// culls everything else
+uniform bool opaque_pass;
+
+// instances take consecutive depth values starting at 'depth_base', nearer
+// as they are drawn later. Must match GLR_BATCH_DEPTH_SLOTS in glr-batch.h
+uniform uint depth_base;
+const float DEPTH_STEP = 1.0 / 4194304.0;
+
+// a position outside the clip volume, to skip an instance
+const vec4 CULLED_POSITION = vec4 (2.0, 2.0, 2.0, 1.0);
+
+// what animations are evaluated at, in seconds
+uniform float time;
+
+// the offset of each scroll node, the first one being zero. Must match
+// GLR_PROGRAM_NUM_SCROLL_NODES in glr-program.h
+uniform vec2 scroll_offsets[16];
+
+// whether instances come in the compact format
+uniform bool compact_instances;
+const float COMPACT_LAYOUT_SUBPIXELS = 8.0;
+
+// the dyn attrs texture has a fixed width, but its height grows with
+// the amount of data stored in it
 const uint DYN_ATTRS_TEX_WIDTH  = uint (1024);
-const uint DYN_ATTRS_TEX_HEIGHT = uint (1024);
-const float DYN_ATTRS_TEX_STEP_X = 1.0 / float (DYN_ATTRS_TEX_WIDTH);
-const float DYN_ATTRS_TEX_STEP_Y = 1.0 / float (DYN_ATTRS_TEX_HEIGHT);
-uniform sampler2D dyn_attrs_tex;
+uniform highp sampler2D dyn_attrs_tex;
 
 vec4
 get_dyn_attrs_sample (uint offset)
@@ -68,13 +112,35 @@ get_dyn_attrs_sample (uint offset)
   offset = offset - uint (1);
 
   uint column = offset % DYN_ATTRS_TEX_WIDTH;
-  uint row = offset / DYN_ATTRS_TEX_HEIGHT;
+  uint row = offset / DYN_ATTRS_TEX_WIDTH;
+
+  return texelFetch (dyn_attrs_tex, ivec2 (column, row), 0);
+}
+
+// how far an animation is at 'time', from 0.0 to 1.0. 'timing' holds its
+// start time, duration, iterations and flags
+float
+animation_progress (vec4 timing)
+{
+  float iterations = timing.z;
+  float p = max (time - timing.x, 0.0) / max (timing.y, 0.0001);
+  uint flags = uint (timing.w);
+
+  // it holds the last value reached once done
+  float cycle = floor (p);
+  float f = p - cycle;
+  if (iterations > 0.0 && p >= iterations) {
+    cycle = ceil (iterations) - 1.0;
+    f = iterations - cycle;
+  }
 
-  vec2 pos = vec2 (float (column) * DYN_ATTRS_TEX_STEP_X,
-                   float (row) * DYN_ATTRS_TEX_STEP_Y);
-  vec4 result = texture (dyn_attrs_tex, pos);
+  if ((flags & ANIMATION_ALTERNATE) != uint (0) && mod (cycle, 2.0) == 1.0)
+    f = 1.0 - f;
 
-  return result;
+  if ((flags & ANIMATION_EASE_IN_OUT) != uint (0))
+    f = smoothstep (0.0, 1.0, f);
+
+  return f;
 }
 
 vec4
@@ -94,49 +160,165 @@ main ()
   float scale_x = 1.0;
   float scale_y = 1.0;
 
+  // unpack the instance, if it comes in the compact format
+  // ---------------------------------------------------------------------------
+  vec4 lyt;
+  uvec4 config;
+
+  if (compact_instances) {
+    // the layout is given in 1/8 of a pixel, and the config is packed in a
+    // single word: bits 28 to 31 encode the instance type, and bits 0 to 27
+    // the offset of a style entry holding the rest of config0 and config1
+    // to config3, if any
+    lyt = lyt_attr / COMPACT_LAYOUT_SUBPIXELS;
+
+    uint style_offset = config_attr[0] & uint (0x0FFFFFFF);
+    if (style_offset > uint (0))
+      config = uvec4 (get_dyn_attrs_sample (style_offset));
+    else
+      config = uvec4 (0);
+
+    config[0] |= (config_attr[0] >> 28) << 26;
+  }
+  else {
+    lyt = lyt_attr;
+    config = config_attr;
+  }
+
   // load config, which is encoded in 4 uint32 words (config[0] to config[3])
   // ---------------------------------------------------------------------------
 
   // bits 30 to 31 (2 bits) of config0 are reserved, and must be zero
 
   // bits 26 to 29 (4 bits) of config0 encode the instance type
-  instance_type = (config_attr[0] >> 26) & uint (0x0F);
+  instance_type = (config[0] >> 26) & uint (0x0F);
 
   // bits 20 to 23 (4 bits) of config0 encode the number of samples to describe
   // the border
-  uint border_num_samples = (config_attr[0] >> 20) & uint (0x0F);
+  uint border_num_samples = (config[0] >> 20) & uint (0x0F);
 
   // bits 16 to 19 (4 bits) of config0 encode the number of samples to describe
   // the background
-  uint background_num_samples = (config_attr[0] >> 16) & uint (0x0F);
+  uint background_num_samples = (config[0] >> 16) & uint (0x0F);
+
+  // in the opaque pass, leave the anti-aliased edges out, the translucent
+  // pass blends them in later. Pixel-aligned rects have none
+  if (opaque_pass && instance_type != INSTANCE_RECT_ALIGNED) {
+    vec2 inset = vec2 (aa_offset) / abs (lyt.zw);
+
+    if (inset.x >= 0.5 || inset.y >= 0.5) {
+      gl_Position = CULLED_POSITION;
+      return;
+    }
+
+    tex_coords = mix (inset, vec2 (1.0) - inset, tex_coords);
+  }
 
   // load instance's layout
   // ---------------------------------------------------------------------------
-  pos = vec4 (lyt_attr.x + lyt_attr.z * tex_coords.x,
-              lyt_attr.y + lyt_attr.w * tex_coords.y,
+  pos = vec4 (lyt.x + lyt.z * tex_coords.x,
+              lyt.y + lyt.w * tex_coords.y,
               0.0, 1.0);
 
+  // load clip, if any
+  // ---------------------------------------------------------------------------
+  // if bit 22 of config1 is set, the offset in it points to a 2-sample clip:
+  // its left, top, right and bottom, and its corner radii. The transform
+  // follows, unless bit 21 is set too
+  uint transform_offset = config[1] & TRANSFORM_OFFSET_MASK;
+  vec2 clip_center = vec2 (0.0);
+
+  clip_half_size = vec2 (-1.0);
+  clip_radii = vec4 (0.0);
+  if ((config[1] & CLIP) != uint (0)) {
+    vec4 clip = get_dyn_attrs_sample (transform_offset);
+
+    clip_radii = get_dyn_attrs_sample (transform_offset + uint (1));
+    clip_center = (clip.xy + clip.zw) / 2.0;
+    clip_half_size = (clip.zw - clip.xy) / 2.0;
+
+    // its edges are anti-aliased, so nothing clipped is opaque
+    if (opaque_pass) {
+      gl_Position = CULLED_POSITION;
+      return;
+    }
+
+    if ((config[1] & CLIP_ONLY) != uint (0))
+      transform_offset = uint (0);
+    else
+      transform_offset += uint (2);
+  }
+
+  // load and apply animation, if any
+  // ---------------------------------------------------------------------------
+  // if bit 20 of config1 is set, a 5-sample animation comes next: its
+  // timing, the rotation and opacity, the scale and the translation it goes
+  // from and to, and its origin. The transform follows if its third
+  // component is set. It applies before the transform
+  instance_opacity = 1.0;
+  if ((config[1] & ANIMATION) != uint (0)) {
+    float f = animation_progress (get_dyn_attrs_sample (transform_offset));
+    vec4 rotate_opacity = get_dyn_attrs_sample (transform_offset + uint (1));
+    vec4 scale = get_dyn_attrs_sample (transform_offset + uint (2));
+    vec4 translate = get_dyn_attrs_sample (transform_offset + uint (3));
+    vec4 origin = get_dyn_attrs_sample (transform_offset + uint (4));
+
+    float angle = mix (rotate_opacity.x, rotate_opacity.y, f);
+    mat2 rotation = mat2 (cos (angle), sin (angle), -sin (angle), cos (angle));
+
+    pos.xy = origin.xy
+      + rotation * (mix (scale.xy, scale.zw, f) * (pos.xy - origin.xy))
+      + mix (translate.xy, translate.zw, f);
+    instance_opacity = mix (rotate_opacity.z, rotate_opacity.w, f);
+
+    if (opaque_pass && instance_opacity < 1.0) {
+      gl_Position = CULLED_POSITION;
+      return;
+    }
+
+    if (origin.z > 0.0)
+      transform_offset += uint (5);
+    else
+      transform_offset = uint (0);
+  }
+
   // load and apply linear transformation, if any
   // ---------------------------------------------------------------------------
-  // the transformation matrix is a 4-sample dynamic attribute
-  // whose offset is encoded in config1.
-  if (config_attr[1] > uint (0)) {
-    mat4 transform_matrix = mat4 (
-      get_dyn_attrs_sample (config_attr[1]),
-      get_dyn_attrs_sample (config_attr[1] + uint (1)),
-      get_dyn_attrs_sample (config_attr[1] + uint (2)),
-      get_dyn_attrs_sample (config_attr[1] + uint (3))
-    );
-    pos = transform_matrix * pos;
+  // bits 0 to 19 of config1 encode the offset of the transformation. If bit
+  // 23 is set, it is a 2D affine transform given as a 2-sample dynamic
+  // attribute: the 2x2 linear part and the translation. Otherwise it is a
+  // 4-sample matrix. Translations alone are already applied to the layout
+  if (transform_offset > uint (0)) {
+    if ((config[1] & TRANSFORM_AFFINE_2D) != uint (0)) {
+      vec4 linear = get_dyn_attrs_sample (transform_offset);
+      vec4 translation = get_dyn_attrs_sample (transform_offset + uint (1));
+
+      pos.xy = mat2 (linear.xy, linear.zw) * pos.xy + translation.xy;
+    }
+    else {
+      mat4 transform_matrix = mat4 (
+        get_dyn_attrs_sample (transform_offset),
+        get_dyn_attrs_sample (transform_offset + uint (1)),
+        get_dyn_attrs_sample (transform_offset + uint (2)),
+        get_dyn_attrs_sample (transform_offset + uint (3))
+      );
+      pos = transform_matrix * pos;
+    }
   }
 
-  // apply projection and perspective transformations
+  // move with the scroll node, if any
   // ---------------------------------------------------------------------------
-  pos = persp_matrix * proj_matrix * transform_matrix * pos;
+  // bits 8 to 11 of config0 encode the scroll node of the instance. It
+  // moves in canvas coordinates, while its clip stays in place
+  uint scroll_node = (config[0] >> 8) & uint (0x0F);
+  pos.xy += scroll_offsets[scroll_node] * pos.w;
 
-  // @FIXME: the Z-coordinate must be inverted to the positive plane to use the
-  // depth test
-  // pos.z = -pos.z; // @FIXME: this gives some artifacts in Arndate
+  // the clip is in canvas coordinates, as the position is at this point
+  clip_pos = pos.xy - clip_center;
+
+  // apply global transformation, projection and perspective
+  // ---------------------------------------------------------------------------
+  pos = view_matrix * pos;
 
   gl_Position = pos;
 
@@ -145,17 +327,44 @@ main ()
   color = vec4 (color_attr.a, color_attr.b, color_attr.g, color_attr.r);
   color = mix (vec4 (color.rgb, 0.0), color, 2.00 - gl_Position.z);
 
+  if (opaque_pass && color.a < 1.0) {
+    gl_Position = CULLED_POSITION;
+    return;
+  }
+
+  // depth from the drawing order, so later instances hide earlier ones
+  // ---------------------------------------------------------------------------
+  float depth_slot = float (depth_base + uint (gl_InstanceID)) + 1.0;
+  gl_Position.z = (1.0 - 2.0 * DEPTH_STEP * depth_slot) * gl_Position.w;
+
   // character glyph
   if (instance_type == uint (INSTANCE_CHAR_GLYPH)) {
-    uint tex_area_offset = config_attr[2];
+    uint tex_area_offset = config[2];
     area_in_tex = vec4 (get_dyn_attrs_sample (tex_area_offset));
 
     // bits 12 to 15 (4 bits) of config0 encode the texture unit to use,
     // either for glyphs, background-image or border-image
-    tex_id = int (config_attr[0] >> 12) & 0x0F;
+    tex_id = int (config[0] >> 12) & 0x0F;
   }
 
   else {
+    // load box
+    // ---------------------------------------------------------------------------
+
+    // a box is a 3-sample dynamic attribute whose offset is encoded in
+    // config2: the border widths, the corner radii and the border color.
+    // Its fragments are positioned relative to its center, in pixels
+    if (instance_type == INSTANCE_BOX) {
+      uint box_offset = config[2];
+
+      box_border_width = get_dyn_attrs_sample (box_offset);
+      box_radii = get_dyn_attrs_sample (box_offset + uint (1));
+      box_border_color = get_dyn_attrs_sample (box_offset + uint (2));
+
+      box_half_size = (abs (lyt.zw) - vec2 (aa_offset)) / 2.0;
+      box_pos = (tex_coords - vec2 (0.5)) * abs (lyt.zw);
+    }
+
     // load border
     // ---------------------------------------------------------------------------
 
@@ -166,7 +375,7 @@ main ()
     }
     // simplest case: width, radius and color of all borders are equal
     else if (border_num_samples == uint (1)) {
-      uint border_offset = config_attr[2];
+      uint border_offset = config[2];
       vec4 border = get_dyn_attrs_sample (border_offset);
 
       border_style = ivec4 (int (border[0]),
@@ -196,7 +405,7 @@ main ()
     if (background_num_samples == uint (3))
       {
         // linear gradient
-        uint bg_offset = config_attr[3];
+        uint bg_offset = config[3];
         vec4 bg = get_dyn_attrs_sample (bg_offset);
 
         background_type = BACKGROUND_TYPE_LINEAR_GRAD;
@@ -214,8 +423,8 @@ main ()
       }
 
     // @FIXME: we need actual values for scale_x and scale_y
-    norm.x = 1.0 / abs (lyt_attr.z * scale_x);
-    norm.y = 1.0 / abs (lyt_attr.w * scale_y);
+    norm.x = 1.0 / abs (lyt.z * scale_x);
+    norm.y = 1.0 / abs (lyt.w * scale_y);
     aa_size = vec2 (aa_offset * norm.x, aa_offset * norm.y);
   }
 }